@@ -7,6 +7,13 @@
 #include "carma_auto.h"
 #include "carma_type_of.h"
 
+#if defined(__SSE2__)
+#define CARMA_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define CARMA_HAS_SSE2 0
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 // UTILITIES
 
@@ -25,6 +32,8 @@
 
 #define ITEM_SIZE(range) sizeof(*(range).data)
 
+#define CARMA_IDENTITY(x) (x)
+
 #define SWAP(a, b) do { \
     CARMA_AUTO carma_swap_temp_ = (a); \
     (a) = (b); \
@@ -38,31 +47,94 @@
 #define VALUE_TYPE(range) CARMA_TYPE_OF(*(range).data)
 #define INDEX_TYPE(range) CARMA_TYPE_OF((range).count)
 
+////////////////////////////////////////////////////////////////////////////////
+// ALLOCATOR
+
+// An allocator lets all memory handling of carma be routed to user defined functions.
+// The byte count of the old buffer is passed to reallocate and free,
+// so that pool allocators can grow buffers in place and free them without headers.
+typedef struct CarmaAllocator {
+    void* (*allocate)(void* context, size_t byte_count);
+    void* (*reallocate)(void* context, void* buffer, size_t old_byte_count, size_t new_byte_count);
+    void (*free)(void* context, void* buffer, size_t byte_count);
+    void* context;
+} CarmaAllocator;
+
+// Define CARMA_ALLOCATOR before including carma to pick the allocator.
+// It is an expression of type CarmaAllocator* that is evaluated at each allocation.
+// It can be the address of a static allocator, for an allocator picked at compile time,
+// or a variable that is changed at runtime, like a global or thread local pointer.
+// If it is NULL then malloc, calloc, realloc and free are called directly.
+#ifndef CARMA_ALLOCATOR
+#define CARMA_ALLOCATOR NULL
+#endif
+
+static inline void* carma_allocate(const CarmaAllocator* allocator, size_t byte_count) {
+    if (allocator) {
+        return allocator->allocate(allocator->context, byte_count);
+    }
+    return malloc(byte_count);
+}
+
+static inline void* carma_allocate_zeroed(const CarmaAllocator* allocator, size_t count, size_t item_size) {
+    if (allocator) {
+        CHECK_INTERNAL(item_size == 0 || count <= SIZE_MAX / item_size, "Too many bytes to allocate");
+        void* buffer = allocator->allocate(allocator->context, count * item_size);
+        return buffer ? memset(buffer, 0, count * item_size) : NULL;
+    }
+    return calloc(count, item_size);
+}
+
+static inline void* carma_reallocate(
+    const CarmaAllocator* allocator, void* buffer, size_t old_byte_count, size_t new_byte_count
+) {
+    if (allocator) {
+        return allocator->reallocate(allocator->context, buffer, old_byte_count, new_byte_count);
+    }
+    return realloc(buffer, new_byte_count);
+}
+
+static inline void carma_free(const CarmaAllocator* allocator, void* buffer, size_t byte_count) {
+    if (allocator) {
+        allocator->free(allocator->context, buffer, byte_count);
+        return;
+    }
+    free(buffer);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // ALLOCATE MEMORY
 
 static inline void* carma_byte_malloc(size_t byte_count) {
-    void* buffer = malloc(byte_count);
+    void* buffer = carma_allocate(CARMA_ALLOCATOR, byte_count);
     CHECK_INTERNAL(buffer, "malloc failed");
     return buffer;
 }
 
-#define CARMA_REALLOC(buffer, new_capacity) do { \
-    CARMA_TYPE_OF(buffer) carma_realloc_temp_ = (CARMA_TYPE_OF(buffer))realloc((buffer), (new_capacity) * sizeof(CARMA_TYPE_OF(*(buffer)))); \
+#define CARMA_REALLOC(buffer, old_capacity, new_capacity) do { \
+    CARMA_TYPE_OF(buffer) carma_realloc_temp_ = (CARMA_TYPE_OF(buffer))carma_reallocate( \
+        CARMA_ALLOCATOR, \
+        (buffer), \
+        (old_capacity) * sizeof(CARMA_TYPE_OF(*(buffer))), \
+        (new_capacity) * sizeof(CARMA_TYPE_OF(*(buffer))) \
+    ); \
     CHECK_INTERNAL(carma_realloc_temp_, "realloc failed"); \
     buffer = carma_realloc_temp_; \
 } while (0)
 
 #define CARMA_MALLOC(buffer, capacity) do { \
-    buffer = (CARMA_TYPE_OF(buffer))malloc((capacity) * sizeof(CARMA_TYPE_OF(*(buffer)))); \
+    buffer = (CARMA_TYPE_OF(buffer))carma_allocate(CARMA_ALLOCATOR, (capacity) * sizeof(CARMA_TYPE_OF(*(buffer)))); \
     CHECK_INTERNAL(buffer, "malloc failed"); \
 } while (0)
 
 #define CARMA_CALLOC(buffer, capacity) do { \
-    buffer = (CARMA_TYPE_OF(buffer))calloc((capacity), sizeof(CARMA_TYPE_OF(*(buffer)))); \
+    buffer = (CARMA_TYPE_OF(buffer))carma_allocate_zeroed(CARMA_ALLOCATOR, (capacity), sizeof(CARMA_TYPE_OF(*(buffer)))); \
     CHECK_INTERNAL(buffer, "calloc failed"); \
 } while (0)
 
+#define CARMA_FREE(buffer, capacity) \
+    carma_free(CARMA_ALLOCATOR, (buffer), (capacity) * sizeof(CARMA_TYPE_OF(*(buffer))))
+
 #define INIT_RANGE(range, mycount) do { \
     CARMA_CALLOC((range).data, (mycount)); \
     (range).count = (mycount); \
@@ -99,8 +171,7 @@ static inline void* carma_byte_malloc(size_t byte_count) {
         CARMA_AUTO item_size = sizeof(carray[0]); \
         CARMA_AUTO byte_count = sizeof(carray); \
         CARMA_AUTO count = byte_count / item_size; \
-        CARMA_AUTO data = (T*)malloc(byte_count); \
-        CHECK_INTERNAL(data, "malloc failed"); \
+        CARMA_AUTO data = (T*)carma_byte_malloc(byte_count); \
         memcpy(data, carray, byte_count); \
         return MAKE(range_type, .data=data, .count=count); \
     }())
@@ -111,8 +182,7 @@ static inline void* carma_byte_malloc(size_t byte_count) {
         CARMA_AUTO item_size = sizeof(carray[0]); \
         CARMA_AUTO byte_count = sizeof(carray); \
         CARMA_AUTO count = byte_count / item_size; \
-        CARMA_AUTO data = (T*)malloc(byte_count); \
-        CHECK_INTERNAL(data, "malloc failed"); \
+        CARMA_AUTO data = (T*)carma_byte_malloc(byte_count); \
         memcpy(data, carray, byte_count); \
         return MAKE(darray_type, .data=data, .count=count, .capacity=count); \
     }())
@@ -144,20 +214,20 @@ static inline void* carma_byte_malloc(size_t byte_count) {
 // FREE MEMORY
 
 #define FREE_RANGE(range) do { \
-    free((range).data); \
+    CARMA_FREE((range).data, (range).count); \
     (range).data = NULL; \
     (range).count = 0; \
 } while (0)
 
 #define FREE_DARRAY(darray) do { \
-    free((darray).data); \
+    CARMA_FREE((darray).data, (darray).capacity); \
     (darray).data = NULL; \
     (darray).count = 0; \
     (darray).capacity = 0; \
 } while (0)
 
 #define FREE_2D_ARRAY(array) do { \
-    free((array).data); \
+    CARMA_FREE((array).data, (array).count); \
     (array).data = NULL; \
     (array).width = 0; \
     (array).height = 0; \
@@ -165,7 +235,7 @@ static inline void* carma_byte_malloc(size_t byte_count) {
 } while (0)
 
 #define FREE_3D_ARRAY(array) do { \
-    free((array).data); \
+    CARMA_FREE((array).data, (array).count); \
     (array).data = NULL; \
     (array).width = 0; \
     (array).height = 0; \
@@ -217,19 +287,151 @@ static inline void* carma_byte_malloc(size_t byte_count) {
     } \
     if (it != END_POINTER(range))
 
+#define CARMA_ADD(a, b) ((a) + (b))
+#define CARMA_MIN(a, b) ((b) < (a) ? (b) : (a))
+#define CARMA_MAX(a, b) ((a) < (b) ? (b) : (a))
+
+// Allocates result in the surrounding scope, with the type of init,
+// and sets it to op(...op(op(init, item0), item1)..., itemN) in the order of the items.
+#define REDUCE(result, range, init, op) \
+    CARMA_AUTO result = (init); \
+    FOR_EACH(_reduce_it, (range)) \
+        result = op(result, *_reduce_it)
+
+#define CARMA_REDUCE_LANE_COUNT 8
+
+// Like REDUCE but item i is reduced into lane i % CARMA_REDUCE_LANE_COUNT,
+// and then the lanes are combined pairwise.
+// The lanes do not depend on each other, so the compiler can use SIMD instructions for them.
+// The init is used for each lane, so it should not change the result, like 0 for CARMA_ADD.
+// The order only depends on the count, so a floating point result is the same each run,
+// but it can differ from REDUCE in the last bits.
+#define REDUCE_LANES(result, range, init, op) \
+    CARMA_AUTO result = (init); \
+    do { \
+        CARMA_TYPE_OF(result) _lanes[CARMA_REDUCE_LANE_COUNT]; \
+        for (size_t _lane = 0; _lane < CARMA_REDUCE_LANE_COUNT; ++_lane) { \
+            _lanes[_lane] = result; \
+        } \
+        size_t _lanes_count = (size_t)(range).count; \
+        size_t _lanes_i = 0; \
+        for (; _lanes_i + CARMA_REDUCE_LANE_COUNT <= _lanes_count; _lanes_i += CARMA_REDUCE_LANE_COUNT) { \
+            for (size_t _lane = 0; _lane < CARMA_REDUCE_LANE_COUNT; ++_lane) { \
+                _lanes[_lane] = op(_lanes[_lane], (range).data[_lanes_i + _lane]); \
+            } \
+        } \
+        for (size_t _lane = 0; _lanes_i < _lanes_count; ++_lanes_i, ++_lane) { \
+            _lanes[_lane] = op(_lanes[_lane], (range).data[_lanes_i]); \
+        } \
+        for (size_t _width = CARMA_REDUCE_LANE_COUNT / 2; _width > 0; _width /= 2) { \
+            for (size_t _lane = 0; _lane < _width; ++_lane) { \
+                _lanes[_lane] = op(_lanes[_lane], _lanes[_lane + _width]); \
+            } \
+        } \
+        result = _lanes[0]; \
+    } while (0)
+
 #define SUB_RANGE(range, start_index, new_count) \
     MAKE(CARMA_TYPE_OF(range), .data=(range).data + (start_index), .count=(new_count))
 
-#define FILL(range, value) FOR_EACH(it, (range)) *it = (value)
+// Fills bigger than this many bytes use non-temporal stores that bypass the cache,
+// since the start of the range would be evicted from the cache before the fill is done anyway.
+#ifndef CARMA_NON_TEMPORAL_THRESHOLD
+#define CARMA_NON_TEMPORAL_THRESHOLD (32 * 1024 * 1024)
+#endif
+
+// Fills the items with non-temporal stores of 16 bytes, when the item size divides 16.
+// Returns false without filling when that is not possible.
+static inline bool carma_stream_fill(void* data, size_t count, const void* value, size_t item_size) {
+#if CARMA_HAS_SSE2
+    if (16 % item_size != 0 || (uintptr_t)data % item_size != 0) {
+        return false;
+    }
+    unsigned char pattern[16];
+    for (size_t i = 0; i < 16; i += item_size) {
+        memcpy(pattern + i, value, item_size);
+    }
+    // The loops count the remaining bytes instead of comparing advanced pointers,
+    // which are multiples of the item size since the item size divides 16:
+    unsigned char* it = (unsigned char*)data;
+    size_t remaining = count * item_size;
+    for (; (uintptr_t)it % 16 != 0 && remaining > 0; it += item_size, remaining -= item_size) {
+        memcpy(it, value, item_size);
+    }
+    __m128i block = _mm_loadu_si128((const __m128i*)pattern);
+    for (; remaining >= 64; it += 64, remaining -= 64) {
+        _mm_stream_si128((__m128i*)it, block);
+        _mm_stream_si128((__m128i*)(it + 16), block);
+        _mm_stream_si128((__m128i*)(it + 32), block);
+        _mm_stream_si128((__m128i*)(it + 48), block);
+    }
+    for (; remaining >= 16; it += 16, remaining -= 16) {
+        _mm_stream_si128((__m128i*)it, block);
+    }
+    _mm_sfence();
+    for (; remaining > 0; it += item_size, remaining -= item_size) {
+        memcpy(it, value, item_size);
+    }
+    return true;
+#else
+    (void)data;
+    (void)count;
+    (void)value;
+    (void)item_size;
+    return false;
+#endif
+}
 
+// The value is evaluated once.
+#define FILL(range, value) do { \
+    VALUE_TYPE(range) _fill_value = (value); \
+    size_t _fill_byte_count = (size_t)(range).count * sizeof(_fill_value); \
+    if (_fill_byte_count < CARMA_NON_TEMPORAL_THRESHOLD || \
+        !carma_stream_fill((range).data, (size_t)(range).count, &_fill_value, sizeof(_fill_value))) { \
+        FOR_EACH(_fill_it, (range)) { \
+            *_fill_it = _fill_value; \
+        } \
+    } \
+} while (0)
+
+static inline size_t carma_min_count(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+// memmove is undefined for NULL pointers, also when nothing is moved.
+static inline void carma_move_bytes(void* target, const void* source, size_t byte_count) {
+    if (byte_count > 0) {
+        memmove(target, source, byte_count);
+    }
+}
+
+// Items of the same type are copied with memmove, which is correct for any overlap.
+// Items of different types are converted one at a time, from the start.
 #define COPY(source_range, target_range) do { \
-    FOR_EACH2(_source, _target, (source_range), (target_range)) \
-        *_target = *_source; \
+    if (CARMA_IS_SAME_TYPE(*(source_range).data, *(target_range).data)) { \
+        carma_move_bytes((target_range).data, (source_range).data, \
+            carma_min_count((size_t)(source_range).count, (size_t)(target_range).count) * sizeof(*(target_range).data)); \
+    } else { \
+        FOR_EACH2(_source, _target, (source_range), (target_range)) \
+            *_target = *_source; \
+    } \
 } while (0)
 
+// Copies the last items of the source to the last items of the target.
+// Items of the same type are copied with memmove, which is correct for any overlap.
+// Items of different types are converted one at a time, from the end.
 #define COPY_BACKWARD(source_range, target_range) do { \
-    FOR_EACH_BACKWARD2(_source, _target, (source_range), (target_range)) \
-        *_target = *_source; \
+    if (CARMA_IS_SAME_TYPE(*(source_range).data, *(target_range).data)) { \
+        size_t _copy_count = carma_min_count((size_t)(source_range).count, (size_t)(target_range).count); \
+        carma_move_bytes( \
+            (target_range).data + (target_range).count - _copy_count, \
+            (source_range).data + (source_range).count - _copy_count, \
+            _copy_count * sizeof(*(target_range).data) \
+        ); \
+    } else { \
+        FOR_EACH_BACKWARD2(_source, _target, (source_range), (target_range)) \
+            *_target = *_source; \
+    } \
 } while (0)
 
 #define REPLACE(range, old_item, new_item) do { \
@@ -251,12 +453,375 @@ static inline bool carma_are_bits_equal(
     if (byte_count0 != byte_count1) {
         return false;
     }
-    return memcmp(data0, data1, byte_count0) == 0;
+    // memcmp is undefined for NULL pointers, also when nothing is compared.
+    return byte_count0 == 0 || memcmp(data0, data1, byte_count0) == 0;
 }
 
 #define ARE_EQUAL(range0, range1) \
     carma_are_bits_equal((range0).data, (range1).data, COUNT_BYTES(range0), COUNT_BYTES(range1))
 
+////////////////////////////////////////////////////////////////////////////////
+// RANGE ALGORITHMS - SORT
+
+#define CARMA_LESS(a, b) ((a) < (b))
+#define CARMA_GREATER(a, b) ((b) < (a))
+
+// Parts of at most this many items are sorted with insertion sort.
+#define CARMA_SORT_INSERTION_COUNT 16
+// The larger part of each partition is pushed and the smaller part is sorted first,
+// so the stack never holds more parts than the number of bits of the count.
+#define CARMA_SORT_STACK_SIZE 64
+
+#define CARMA_SORT_CALL_LESS(less, a, b) less(a, b)
+#define CARMA_SORT_CALL_KEY(key, a, b) (key(a) < key(b))
+
+// Introsort that calls compare(argument, a, b) to tell if the item a should come before the item b.
+// Parts are split by quicksort around the median of their first, middle and last items.
+// Parts that are split more than twice the logarithm of the count are sorted with heapsort instead,
+// so the worst case is O(count*log(count)). Small parts are sorted with insertion sort.
+// Like pdqsort, items equal to the pivot are split off in one pass, so repeated items take linear time.
+#define CARMA_SORT_WITH(range, compare, argument) do { \
+    CARMA_AUTO _sort_data = (range).data; \
+    size_t _sort_count = (size_t)(range).count; \
+    size_t _sort_stack_begin[CARMA_SORT_STACK_SIZE]; \
+    size_t _sort_stack_end[CARMA_SORT_STACK_SIZE]; \
+    size_t _sort_stack_depth[CARMA_SORT_STACK_SIZE]; \
+    size_t _sort_stack_count = 0; \
+    size_t _sort_begin = 0; \
+    size_t _sort_end = _sort_count; \
+    size_t _sort_depth = 0; \
+    for (size_t _sort_n = _sort_count; _sort_n > 1; _sort_n /= 2) { \
+        _sort_depth += 2; \
+    } \
+    for (;;) { \
+        while (_sort_end - _sort_begin > CARMA_SORT_INSERTION_COUNT && _sort_depth > 0) { \
+            --_sort_depth; \
+            size_t _sort_middle = _sort_begin + (_sort_end - _sort_begin) / 2; \
+            if (compare(argument, _sort_data[_sort_middle], _sort_data[_sort_begin])) { \
+                SWAP(_sort_data[_sort_middle], _sort_data[_sort_begin]); \
+            } \
+            if (compare(argument, _sort_data[_sort_end - 1], _sort_data[_sort_middle])) { \
+                SWAP(_sort_data[_sort_end - 1], _sort_data[_sort_middle]); \
+                if (compare(argument, _sort_data[_sort_middle], _sort_data[_sort_begin])) { \
+                    SWAP(_sort_data[_sort_middle], _sort_data[_sort_begin]); \
+                } \
+            } \
+            SWAP(_sort_data[_sort_begin], _sort_data[_sort_middle]); \
+            CARMA_AUTO _sort_pivot = _sort_data[_sort_begin]; \
+            size_t _sort_i = _sort_begin + 1; \
+            if (_sort_begin > 0 && !compare(argument, _sort_data[_sort_begin - 1], _sort_pivot)) { \
+                /* The pivot is equal to the item before the part, which is not greater than any item of the part. */ \
+                /* So the items that are not greater than the pivot are equal to it and are already sorted. */ \
+                for (size_t _sort_k = _sort_begin + 1; _sort_k < _sort_end; ++_sort_k) { \
+                    CARMA_AUTO _sort_item = _sort_data[_sort_k]; \
+                    bool _sort_is_left = !compare(argument, _sort_pivot, _sort_item); \
+                    _sort_data[_sort_k] = _sort_data[_sort_i]; \
+                    _sort_data[_sort_i] = _sort_item; \
+                    _sort_i += _sort_is_left; \
+                } \
+                _sort_begin = _sort_i; \
+                continue; \
+            } \
+            /* Lomuto partition that moves each item without a branch, */ \
+            /* so that it does not depend on predicting the comparisons. */ \
+            for (size_t _sort_k = _sort_begin + 1; _sort_k < _sort_end; ++_sort_k) { \
+                CARMA_AUTO _sort_item = _sort_data[_sort_k]; \
+                bool _sort_is_left = compare(argument, _sort_item, _sort_pivot); \
+                _sort_data[_sort_k] = _sort_data[_sort_i]; \
+                _sort_data[_sort_i] = _sort_item; \
+                _sort_i += _sort_is_left; \
+            } \
+            _sort_data[_sort_begin] = _sort_data[_sort_i - 1]; \
+            _sort_data[_sort_i - 1] = _sort_pivot; \
+            CHECK_INTERNAL(_sort_stack_count < CARMA_SORT_STACK_SIZE, "Sort stack overflow"); \
+            if (_sort_i - 1 - _sort_begin < _sort_end - _sort_i) { \
+                _sort_stack_begin[_sort_stack_count] = _sort_i; \
+                _sort_stack_end[_sort_stack_count] = _sort_end; \
+                _sort_end = _sort_i - 1; \
+            } else { \
+                _sort_stack_begin[_sort_stack_count] = _sort_begin; \
+                _sort_stack_end[_sort_stack_count] = _sort_i - 1; \
+                _sort_begin = _sort_i; \
+            } \
+            _sort_stack_depth[_sort_stack_count++] = _sort_depth; \
+        } \
+        if (_sort_end - _sort_begin > CARMA_SORT_INSERTION_COUNT) { \
+            /* Heapsort, where the loop first builds the heap and then pops the max item to the end. */ \
+            CARMA_AUTO _heap = _sort_data + _sort_begin; \
+            size_t _heap_count = _sort_end - _sort_begin; \
+            size_t _heap_start = _heap_count / 2; \
+            for (;;) { \
+                if (_heap_start > 0) { \
+                    --_heap_start; \
+                } else { \
+                    if (_heap_count <= 1) { \
+                        break; \
+                    } \
+                    --_heap_count; \
+                    SWAP(_heap[0], _heap[_heap_count]); \
+                } \
+                CARMA_AUTO _heap_item = _heap[_heap_start]; \
+                size_t _heap_root = _heap_start; \
+                for (;;) { \
+                    size_t _heap_child = 2 * _heap_root + 1; \
+                    if (_heap_child >= _heap_count) { \
+                        break; \
+                    } \
+                    if (_heap_child + 1 < _heap_count && compare(argument, _heap[_heap_child], _heap[_heap_child + 1])) { \
+                        ++_heap_child; \
+                    } \
+                    if (!compare(argument, _heap_item, _heap[_heap_child])) { \
+                        break; \
+                    } \
+                    _heap[_heap_root] = _heap[_heap_child]; \
+                    _heap_root = _heap_child; \
+                } \
+                _heap[_heap_root] = _heap_item; \
+            } \
+        } else { \
+            for (size_t _sort_k = _sort_begin + 1; _sort_k < _sort_end; ++_sort_k) { \
+                CARMA_AUTO _sort_item = _sort_data[_sort_k]; \
+                size_t _sort_m = _sort_k; \
+                for (; _sort_m > _sort_begin && compare(argument, _sort_item, _sort_data[_sort_m - 1]); --_sort_m) { \
+                    _sort_data[_sort_m] = _sort_data[_sort_m - 1]; \
+                } \
+                _sort_data[_sort_m] = _sort_item; \
+            } \
+        } \
+        if (_sort_stack_count == 0) { \
+            break; \
+        } \
+        --_sort_stack_count; \
+        _sort_begin = _sort_stack_begin[_sort_stack_count]; \
+        _sort_end = _sort_stack_end[_sort_stack_count]; \
+        _sort_depth = _sort_stack_depth[_sort_stack_count]; \
+    } \
+} while (0)
+
+// Sorts the items so that less(a, b) is false for each item a that comes after an item b.
+// The less is a function or macro like CARMA_LESS or CARMA_GREATER that takes two items.
+// The sort is not stable.
+#define SORT(range, less) CARMA_SORT_WITH(range, CARMA_SORT_CALL_LESS, less)
+
+// Sorts the items in increasing order of key(item).
+// The key is a function or macro that takes an item and returns something that can be compared with <.
+#define SORT_BY_KEY(range, key) CARMA_SORT_WITH(range, CARMA_SORT_CALL_KEY, key)
+
+// Maps floating point numbers to unsigned integers in the same order,
+// by flipping all bits of negative numbers and the sign bit of positive numbers.
+static inline uint64_t carma_radix_key_of_float(float key) {
+    uint32_t bits = 0;
+    memcpy(&bits, &key, sizeof(bits));
+    return bits & UINT32_C(0x80000000) ? ~bits : bits | UINT32_C(0x80000000);
+}
+
+static inline uint64_t carma_radix_key_of_double(double key) {
+    uint64_t bits = 0;
+    memcpy(&bits, &key, sizeof(bits));
+    return bits & UINT64_C(0x8000000000000000) ? ~bits : bits | UINT64_C(0x8000000000000000);
+}
+
+// Maps signed integers to unsigned integers in the same order,
+// by flipping the sign bit at the size of the key, so that the bytes above the size stay zero.
+static inline uint64_t carma_radix_key_of_signed(int64_t key, size_t key_size) {
+    uint64_t bits = (uint64_t)key;
+    if (key_size < sizeof(bits)) {
+        bits &= (UINT64_C(1) << (8 * key_size)) - 1;
+    }
+    return bits ^ (UINT64_C(1) << (8 * key_size - 1));
+}
+
+#define CARMA_RADIX_KEY(key) ( \
+    CARMA_IS_FLOATING_POINT(key) ? ( \
+        sizeof(key) == sizeof(float) ? carma_radix_key_of_float((float)(key)) : carma_radix_key_of_double((double)(key)) \
+    ) : \
+    CARMA_IS_SIGNED(key) ? carma_radix_key_of_signed((int64_t)(key), sizeof(key)) : \
+    (uint64_t)(key) \
+)
+
+// Least significant byte radix sort, that first counts the bytes of all keys in one pass over the items,
+// and then moves the items between the range and a buffer in one pass for each byte.
+// Bytes that are the same for all keys, like the upper bytes of small integers, are skipped.
+#define RADIX_SORT_BY_KEY(range, key) do { \
+    CARMA_AUTO _radix_data = (range).data; \
+    size_t _radix_count = (size_t)(range).count; \
+    if (_radix_count > 1) { \
+        size_t _radix_histograms[8][256]; \
+        memset(_radix_histograms, 0, sizeof(_radix_histograms)); \
+        for (size_t _radix_i = 0; _radix_i < _radix_count; ++_radix_i) { \
+            uint64_t _radix_key = CARMA_RADIX_KEY(key(_radix_data[_radix_i])); \
+            for (size_t _radix_byte = 0; _radix_byte < 8; ++_radix_byte) { \
+                _radix_histograms[_radix_byte][(_radix_key >> (8 * _radix_byte)) & 0xFF]++; \
+            } \
+        } \
+        CARMA_AUTO _radix_buffer = _radix_data; \
+        CARMA_MALLOC(_radix_buffer, _radix_count); \
+        CARMA_AUTO _radix_source = _radix_data; \
+        CARMA_AUTO _radix_target = _radix_buffer; \
+        uint64_t _radix_first_key = CARMA_RADIX_KEY(key(_radix_data[0])); \
+        for (size_t _radix_byte = 0; _radix_byte < 8; ++_radix_byte) { \
+            size_t* _radix_offsets = _radix_histograms[_radix_byte]; \
+            if (_radix_offsets[(_radix_first_key >> (8 * _radix_byte)) & 0xFF] == _radix_count) { \
+                continue; \
+            } \
+            size_t _radix_offset = 0; \
+            for (size_t _radix_b = 0; _radix_b < 256; ++_radix_b) { \
+                size_t _radix_bucket_count = _radix_offsets[_radix_b]; \
+                _radix_offsets[_radix_b] = _radix_offset; \
+                _radix_offset += _radix_bucket_count; \
+            } \
+            for (size_t _radix_i = 0; _radix_i < _radix_count; ++_radix_i) { \
+                uint64_t _radix_key = CARMA_RADIX_KEY(key(_radix_source[_radix_i])); \
+                _radix_target[_radix_offsets[(_radix_key >> (8 * _radix_byte)) & 0xFF]++] = _radix_source[_radix_i]; \
+            } \
+            SWAP(_radix_source, _radix_target); \
+        } \
+        if (_radix_source != _radix_data) { \
+            for (size_t _radix_i = 0; _radix_i < _radix_count; ++_radix_i) { \
+                _radix_data[_radix_i] = _radix_source[_radix_i]; \
+            } \
+        } \
+        CARMA_FREE(_radix_buffer, _radix_count); \
+    } \
+} while (0)
+
+// Sorts a range of integers or floating point numbers in increasing order.
+#define RADIX_SORT(range) RADIX_SORT_BY_KEY(range, CARMA_IDENTITY)
+
+////////////////////////////////////////////////////////////////////////////////
+// RANGE ALGORITHMS - BINARY SEARCH
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define CARMA_PREFETCH(address) __builtin_prefetch(address)
+#else
+    #define CARMA_PREFETCH(address) ((void)0)
+#endif
+
+#define CARMA_SEARCH_LESS(key, item, value) (key(item) < (value))
+#define CARMA_SEARCH_LESS_EQUAL(key, item, value) (!((value) < key(item)))
+
+// Allocates result in the surrounding scope and sets it to the index of the first item
+// for which is_before(key, item, value) is false, or to the count if there is no such item.
+// The loop halves the count without a branch on the comparison, and prefetches the two items
+// that the next step can compare with, so that it waits for one cache miss at a time instead of two.
+#define CARMA_PARTITION_POINT(result, range, is_before, key, value) \
+    size_t result = 0; \
+    do { \
+        CARMA_AUTO _search_base = (range).data; \
+        size_t _search_count = (size_t)(range).count; \
+        CARMA_AUTO _search_value = (value); \
+        if (_search_count > 0) { \
+            while (_search_count > 1) { \
+                size_t _search_half = _search_count / 2; \
+                CARMA_PREFETCH(_search_base + _search_half / 2); \
+                CARMA_PREFETCH(_search_base + _search_half + _search_half / 2); \
+                _search_base = is_before(key, _search_base[_search_half], _search_value) ? \
+                    _search_base + _search_half : _search_base; \
+                _search_count -= _search_half; \
+            } \
+            result = (size_t)(_search_base - (range).data) + is_before(key, *_search_base, _search_value); \
+        } \
+    } while (0)
+
+// Allocates result in the surrounding scope and sets it to the index of the first item that is not less than value.
+#define LOWER_BOUND(result, range, value) \
+    CARMA_PARTITION_POINT(result, range, CARMA_SEARCH_LESS, CARMA_IDENTITY, value)
+
+// Allocates result in the surrounding scope and sets it to the index of the first item that is greater than value.
+#define UPPER_BOUND(result, range, value) \
+    CARMA_PARTITION_POINT(result, range, CARMA_SEARCH_LESS_EQUAL, CARMA_IDENTITY, value)
+
+#define LOWER_BOUND_BY_KEY(result, range, key, value) \
+    CARMA_PARTITION_POINT(result, range, CARMA_SEARCH_LESS, key, value)
+
+#define UPPER_BOUND_BY_KEY(result, range, key, value) \
+    CARMA_PARTITION_POINT(result, range, CARMA_SEARCH_LESS_EQUAL, key, value)
+
+// Allocates first and last in the surrounding scope, so that [first, last) are the indices of the items equal to value.
+#define EQUAL_RANGE(first, last, range, value) \
+    LOWER_BOUND(first, range, value); \
+    UPPER_BOUND(last, range, value)
+
+// Allocates the bool result in the surrounding scope and sets it to true if an item is equal to value.
+// The value is evaluated twice.
+#define BINARY_SEARCH(result, range, value) \
+    LOWER_BOUND(result##_index, range, value); \
+    bool result = result##_index < (size_t)(range).count && !((value) < (range).data[result##_index])
+
+////////////////////////////////////////////////////////////////////////////////
+// RANGE ALGORITHMS - EYTZINGER INDEX
+
+// An Eytzinger index has the items of a sorted range in the order of a breadth first walk of a binary search tree.
+// The root is at index 0 and the children of the item at index i - 1 are at 2 * i - 1 and 2 * i.
+// A search then reads the items of the first levels from the same few cache lines,
+// and the 16 items that are four levels below an item are next to each other, so they can be prefetched together.
+
+// Allocates index with the count of sorted_range and copies the items into it in Eytzinger order.
+// The index is freed with FREE_RANGE.
+#define INIT_EYTZINGER(index, sorted_range) do { \
+    size_t _eytzinger_count = (size_t)(sorted_range).count; \
+    INIT_RANGE(index, _eytzinger_count); \
+    /* Walk the tree in order, which visits the items in sorted order, starting from the leftmost item. */ \
+    size_t _eytzinger_k = 1; \
+    while (2 * _eytzinger_k <= _eytzinger_count) { \
+        _eytzinger_k *= 2; \
+    } \
+    for (size_t _eytzinger_i = 0; _eytzinger_i < _eytzinger_count; ++_eytzinger_i) { \
+        (index).data[_eytzinger_k - 1] = (sorted_range).data[_eytzinger_i]; \
+        if (2 * _eytzinger_k + 1 <= _eytzinger_count) { \
+            _eytzinger_k = 2 * _eytzinger_k + 1; \
+            while (2 * _eytzinger_k <= _eytzinger_count) { \
+                _eytzinger_k *= 2; \
+            } \
+        } else { \
+            while (_eytzinger_k % 2 == 1) { \
+                _eytzinger_k /= 2; \
+            } \
+            _eytzinger_k /= 2; \
+        } \
+    } \
+} while (0)
+
+static inline size_t carma_count_trailing_ones(size_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return ~x == 0 ? sizeof(x) * CHAR_BIT : (size_t)__builtin_ctzll((unsigned long long)~x);
+#else
+    size_t count = 0;
+    for (; x & 1; x >>= 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+// The search goes left or right at each level without a branch, and prefetches four levels ahead.
+// At the end the path has a 1 for each step to the right, and the lower bound is the last node
+// where the path went left, which is found by removing the trailing right steps and the left step before them.
+#define CARMA_EYTZINGER_SEARCH(result, index, is_before, key, value) \
+    size_t result = (size_t)(index).count; \
+    do { \
+        CARMA_AUTO _eytzinger_data = (index).data; \
+        size_t _eytzinger_count = (size_t)(index).count; \
+        CARMA_AUTO _eytzinger_value = (value); \
+        size_t _eytzinger_k = 1; \
+        while (_eytzinger_k <= _eytzinger_count) { \
+            CARMA_PREFETCH((const void*)((uintptr_t)_eytzinger_data + (16 * _eytzinger_k - 1) * sizeof(*_eytzinger_data))); \
+            _eytzinger_k = 2 * _eytzinger_k + is_before(key, _eytzinger_data[_eytzinger_k - 1], _eytzinger_value); \
+        } \
+        _eytzinger_k >>= carma_count_trailing_ones(_eytzinger_k) + 1; \
+        if (_eytzinger_k > 0) { \
+            result = _eytzinger_k - 1; \
+        } \
+    } while (0)
+
+// Allocates result in the surrounding scope and sets it to the index in the Eytzinger index
+// of the first item in sorted order that is not less than value, or to the count if there is no such item.
+#define EYTZINGER_LOWER_BOUND(result, index, value) \
+    CARMA_EYTZINGER_SEARCH(result, index, CARMA_SEARCH_LESS, CARMA_IDENTITY, value)
+
+#define EYTZINGER_LOWER_BOUND_BY_KEY(result, index, key, value) \
+    CARMA_EYTZINGER_SEARCH(result, index, CARMA_SEARCH_LESS, key, value)
+
 ////////////////////////////////////////////////////////////////////////////////
 // RANGE ALGORITHMS - DROP
 // TODO: think about capacity when calling drop functions with a darray.
@@ -317,11 +882,12 @@ static inline bool carma_are_bits_equal(
 // DYNAMIC ARRAY ALGORITHMS
 
 #define RESERVE(dynamic_array, new_capacity) do { \
-    (dynamic_array).capacity = (new_capacity); \
-    if ((dynamic_array).count > (new_capacity)) { \
-        (dynamic_array).count = (new_capacity); \
+    CARMA_TYPE_OF((dynamic_array).capacity) _reserve_capacity = (new_capacity); \
+    CARMA_REALLOC((dynamic_array).data, (dynamic_array).capacity, _reserve_capacity); \
+    (dynamic_array).capacity = _reserve_capacity; \
+    if ((dynamic_array).count > _reserve_capacity) { \
+        (dynamic_array).count = _reserve_capacity; \
     } \
-    CARMA_REALLOC((dynamic_array).data, (new_capacity)); \
 } while (0)
 
 #define CARMA_DOUBLED_CAPACITY(capacity) \
@@ -332,16 +898,18 @@ static inline bool carma_are_bits_equal(
             : (CARMA_ABORT_FAILURE("No room to double capacity") , (capacity))
 
 #define RESERVE_EXPONENTIAL_GROWTH(dynamic_array, min_required_capacity) do { \
-    while ((dynamic_array).capacity < (min_required_capacity)) { \
-        (dynamic_array).capacity = CARMA_DOUBLED_CAPACITY((dynamic_array).capacity); \
+    CARMA_TYPE_OF((dynamic_array).capacity) _grown_capacity = (dynamic_array).capacity; \
+    while (_grown_capacity < (min_required_capacity)) { \
+        _grown_capacity = CARMA_DOUBLED_CAPACITY(_grown_capacity); \
+    } \
+    if (_grown_capacity != (dynamic_array).capacity) { \
+        RESERVE((dynamic_array), _grown_capacity); \
     } \
-    RESERVE((dynamic_array), (dynamic_array).capacity); \
 } while (0)
 
 #define APPEND(dynamic_array, item) do { \
     if ((dynamic_array).count == (dynamic_array).capacity) { \
-        (dynamic_array).capacity = CARMA_DOUBLED_CAPACITY((dynamic_array).capacity); \
-        CARMA_REALLOC((dynamic_array).data, (dynamic_array).capacity); \
+        RESERVE((dynamic_array), CARMA_DOUBLED_CAPACITY((dynamic_array).capacity)); \
     } \
     ((dynamic_array).data)[(dynamic_array).count] = (item); \
     (dynamic_array).count++; \
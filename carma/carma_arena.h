@@ -0,0 +1,282 @@
+#pragma once
+
+#include "carma_std.h"
+
+#include "carma.h"
+#include "carma_string.h"
+
+/*
+An arena is a bump allocator that hands out memory from a list of chunks.
+All memory in an arena is released together with RESET_ARENA or FREE_ARENA,
+instead of freeing each dynamic array on its own.
+
+CarmaArena arena = {};
+StringBuilder s = {};
+IntArray numbers = {};
+SERIALIZE_CSTRING_ARENA(s, "Hello", arena);
+APPEND_ARENA(numbers, 3, arena);
+RESET_ARENA(arena);
+*/
+
+////////////////////////////////////////////////////////////////////////////////
+// ARENA
+
+#ifndef CARMA_ARENA_ALIGNMENT
+#define CARMA_ARENA_ALIGNMENT 16
+#endif
+
+#ifndef CARMA_ARENA_CHUNK_CAPACITY
+#define CARMA_ARENA_CHUNK_CAPACITY (64 * 1024)
+#endif
+
+// The bytes of a chunk follow directly after this header.
+typedef struct CarmaArenaChunk {
+    struct CarmaArenaChunk* previous;
+    size_t count;
+    size_t capacity;
+} CarmaArenaChunk;
+
+typedef struct CarmaArena {
+    CarmaArenaChunk* chunk;
+} CarmaArena;
+
+typedef struct CarmaArenaMark {
+    CarmaArenaChunk* chunk;
+    size_t count;
+} CarmaArenaMark;
+
+static inline size_t carma_arena_align(size_t byte_count) {
+    return (byte_count + (CARMA_ARENA_ALIGNMENT - 1)) & ~(size_t)(CARMA_ARENA_ALIGNMENT - 1);
+}
+
+static inline char* carma_arena_chunk_data(CarmaArenaChunk* chunk) {
+    return (char*)chunk + carma_arena_align(sizeof(CarmaArenaChunk));
+}
+
+static inline void carma_arena_add_chunk(CarmaArena* arena, size_t byte_count) {
+    // Each chunk is at least twice as big as the previous one,
+    // so that a reset arena soon fits a whole workload in a single chunk.
+    size_t capacity = CARMA_ARENA_CHUNK_CAPACITY;
+    if (arena->chunk) {
+        capacity = CARMA_DOUBLED_CAPACITY(arena->chunk->capacity);
+    }
+    if (capacity < byte_count) {
+        capacity = byte_count;
+    }
+    // Chunks use malloc directly, so that an arena can itself be used as CARMA_ALLOCATOR.
+    CarmaArenaChunk* chunk = (CarmaArenaChunk*)malloc(carma_arena_align(sizeof(CarmaArenaChunk)) + capacity);
+    CHECK_INTERNAL(chunk, "malloc failed");
+    chunk->previous = arena->chunk;
+    chunk->count = 0;
+    chunk->capacity = capacity;
+    arena->chunk = chunk;
+}
+
+static inline void* carma_arena_allocate(CarmaArena* arena, size_t byte_count) {
+    byte_count = carma_arena_align(byte_count);
+    if (!arena->chunk || arena->chunk->capacity - arena->chunk->count < byte_count) {
+        carma_arena_add_chunk(arena, byte_count);
+    }
+    void* buffer = carma_arena_chunk_data(arena->chunk) + arena->chunk->count;
+    arena->chunk->count += byte_count;
+    return buffer;
+}
+
+// Grows or shrinks the buffer in place if it is the last allocation of the arena.
+// Otherwise a new buffer is allocated and the old one is left unused until the arena is reset.
+static inline void* carma_arena_reallocate(
+    CarmaArena* arena, void* buffer, size_t old_byte_count, size_t new_byte_count
+) {
+    if (!buffer) {
+        return carma_arena_allocate(arena, new_byte_count);
+    }
+    CarmaArenaChunk* chunk = arena->chunk;
+    char* chunk_data = carma_arena_chunk_data(chunk);
+    size_t old_end = carma_arena_align(old_byte_count);
+    size_t new_end = carma_arena_align(new_byte_count);
+    bool is_last = (char*)buffer + old_end == chunk_data + chunk->count;
+    if (is_last && (char*)buffer + new_end <= chunk_data + chunk->capacity) {
+        chunk->count = (size_t)((char*)buffer + new_end - chunk_data);
+        return buffer;
+    }
+    if (new_byte_count <= old_byte_count) {
+        return buffer;
+    }
+    void* new_buffer = carma_arena_allocate(arena, new_byte_count);
+    memcpy(new_buffer, buffer, old_byte_count);
+    return new_buffer;
+}
+
+static inline void carma_arena_rewind(CarmaArena* arena, CarmaArenaMark mark) {
+    while (arena->chunk != mark.chunk) {
+        CarmaArenaChunk* previous = arena->chunk->previous;
+        free(arena->chunk);
+        arena->chunk = previous;
+    }
+    if (arena->chunk) {
+        arena->chunk->count = mark.count;
+    }
+}
+
+static inline void carma_arena_reset(CarmaArena* arena) {
+    // Keep the newest chunk, since it is the biggest one.
+    if (!arena->chunk) {
+        return;
+    }
+    CarmaArenaChunk* newest = arena->chunk;
+    arena->chunk = newest->previous;
+    carma_arena_rewind(arena, MAKE(CarmaArenaMark));
+    newest->previous = NULL;
+    newest->count = 0;
+    arena->chunk = newest;
+}
+
+// Releases all memory of the arena, including its chunks.
+#define FREE_ARENA(arena) carma_arena_rewind(&(arena), MAKE(CarmaArenaMark))
+
+// Releases all memory allocated from the arena, but keeps one chunk for re-use.
+#define RESET_ARENA(arena) carma_arena_reset(&(arena))
+
+// Remembers the current position of the arena, so that later allocations can be released with REWIND_ARENA.
+#define MARK_ARENA(arena) \
+    ((arena).chunk ? MAKE(CarmaArenaMark, (arena).chunk, (arena).chunk->count) : MAKE(CarmaArenaMark))
+
+#define REWIND_ARENA(arena, mark) carma_arena_rewind(&(arena), (mark))
+
+////////////////////////////////////////////////////////////////////////////////
+// ARENA AS ALLOCATOR
+
+static inline void* carma_arena_allocator_allocate(void* context, size_t byte_count) {
+    return carma_arena_allocate((CarmaArena*)context, byte_count);
+}
+
+static inline void* carma_arena_allocator_reallocate(
+    void* context, void* buffer, size_t old_byte_count, size_t new_byte_count
+) {
+    return carma_arena_reallocate((CarmaArena*)context, buffer, old_byte_count, new_byte_count);
+}
+
+static inline void carma_arena_allocator_free(void* context, void* buffer, size_t byte_count) {
+    // Only the last allocation can be given back. Other memory is released with the arena.
+    CarmaArena* arena = (CarmaArena*)context;
+    if (buffer && arena->chunk) {
+        char* chunk_data = carma_arena_chunk_data(arena->chunk);
+        if ((char*)buffer + carma_arena_align(byte_count) == chunk_data + arena->chunk->count) {
+            arena->chunk->count = (size_t)((char*)buffer - chunk_data);
+        }
+    }
+}
+
+// Makes a CarmaAllocator that allocates from the arena,
+// so that the arena can be used as CARMA_ALLOCATOR.
+#define MAKE_ARENA_ALLOCATOR(arena) MAKE(CarmaAllocator, \
+    carma_arena_allocator_allocate, \
+    carma_arena_allocator_reallocate, \
+    carma_arena_allocator_free, \
+    &(arena) \
+)
+
+////////////////////////////////////////////////////////////////////////////////
+// DYNAMIC ARRAY ALGORITHMS USING AN ARENA
+// Dynamic arrays allocated from an arena should not be freed with FREE_DARRAY.
+// Their memory is released together with the arena.
+
+#define CARMA_REALLOC_ARENA(buffer, old_capacity, new_capacity, arena) do { \
+    buffer = (CARMA_TYPE_OF(buffer))carma_arena_reallocate( \
+        &(arena), \
+        (buffer), \
+        (old_capacity) * sizeof(CARMA_TYPE_OF(*(buffer))), \
+        (new_capacity) * sizeof(CARMA_TYPE_OF(*(buffer))) \
+    ); \
+} while (0)
+
+#define INIT_DARRAY_ARENA(darray, mycount, mycapacity, arena) do { \
+    (darray).data = (POINTER_TYPE(darray))carma_arena_allocate(&(arena), (mycapacity) * ITEM_SIZE(darray)); \
+    memset((darray).data, 0, (mycapacity) * ITEM_SIZE(darray)); \
+    (darray).count = (mycount); \
+    (darray).capacity = (mycapacity); \
+} while (0)
+
+#define RESERVE_ARENA(dynamic_array, new_capacity, arena) do { \
+    CARMA_TYPE_OF((dynamic_array).capacity) _ra_new_capacity = (new_capacity); \
+    CARMA_REALLOC_ARENA((dynamic_array).data, (dynamic_array).capacity, _ra_new_capacity, arena); \
+    (dynamic_array).capacity = _ra_new_capacity; \
+    if ((dynamic_array).count > _ra_new_capacity) { \
+        (dynamic_array).count = _ra_new_capacity; \
+    } \
+} while (0)
+
+#define RESERVE_EXPONENTIAL_GROWTH_ARENA(dynamic_array, min_required_capacity, arena) do { \
+    CARMA_TYPE_OF((dynamic_array).capacity) _rega_capacity = (dynamic_array).capacity; \
+    while (_rega_capacity < (min_required_capacity)) { \
+        _rega_capacity = CARMA_DOUBLED_CAPACITY(_rega_capacity); \
+    } \
+    if (_rega_capacity != (dynamic_array).capacity) { \
+        RESERVE_ARENA((dynamic_array), _rega_capacity, arena); \
+    } \
+} while (0)
+
+#define APPEND_ARENA(dynamic_array, item, arena) do { \
+    if ((dynamic_array).count == (dynamic_array).capacity) { \
+        RESERVE_ARENA((dynamic_array), CARMA_DOUBLED_CAPACITY((dynamic_array).capacity), arena); \
+    } \
+    ((dynamic_array).data)[(dynamic_array).count] = (item); \
+    (dynamic_array).count++; \
+} while (0)
+
+#define CONCAT_ARENA(dynamic_array, range, arena) do { \
+    CARMA_AUTO _ca_new_count = (dynamic_array).count + (range).count; \
+    RESERVE_EXPONENTIAL_GROWTH_ARENA((dynamic_array), _ca_new_count, arena); \
+    COPY(range, SUB_RANGE(dynamic_array, (dynamic_array).count, (range).count)); \
+    (dynamic_array).count = _ca_new_count; \
+} while (0)
+
+////////////////////////////////////////////////////////////////////////////////
+// STRING BUILDER MACROS USING AN ARENA
+// These reserve enough capacity in the arena up front,
+// so that the ordinary serialization macros never need to reallocate.
+
+static inline char* carma_make_cstring_arena(const char* data, size_t count, CarmaArena* arena) {
+    char* result = (char*)carma_arena_allocate(arena, count + 1);
+    memcpy(result, data, count);
+    result[count] = '\0';
+    return result;
+}
+
+#define MAKE_CSTRING_ARENA(string, arena) carma_make_cstring_arena((string).data, (string).count, &(arena))
+
+static inline char* carma_as_cstring_arena(StringBuilder* string_builder, CarmaArena* arena) {
+    RESERVE_EXPONENTIAL_GROWTH_ARENA(*string_builder, string_builder->count + 1, *arena);
+    string_builder->data[string_builder->count] = '\0';
+    return string_builder->data;
+}
+
+#define AS_CSTRING_ARENA(string_builder, arena) carma_as_cstring_arena(&(string_builder), &(arena))
+
+#define SERIALIZE_INTEGRAL_ARENA(string_builder, x, arena) do { \
+    RESERVE_EXPONENTIAL_GROWTH_ARENA((string_builder), (string_builder).count + CARMA_MAX_SERIALIZED_INTEGRAL_SIZE(x), arena); \
+    SERIALIZE_INTEGRAL((string_builder), (x)); \
+} while (0)
+
+#define SERIALIZE_DOUBLE_ARENA(string_builder, x, arena) do { \
+    RESERVE_EXPONENTIAL_GROWTH_ARENA((string_builder), (string_builder).count + CARMA_MAX_SERIALIZED_DOUBLE_SIZE, arena); \
+    SERIALIZE_DOUBLE((string_builder), (x)); \
+} while (0)
+
+#define SERIALIZE_BOOL_ARENA(string_builder, x, arena) do { \
+    RESERVE_EXPONENTIAL_GROWTH_ARENA((string_builder), (string_builder).count + sizeof("false"), arena); \
+    SERIALIZE_BOOL((string_builder), (x)); \
+} while (0)
+
+#define SERIALIZE_CHARACTER_ARENA(string_builder, x, arena) do { \
+    RESERVE_EXPONENTIAL_GROWTH_ARENA((string_builder), (string_builder).count + 2, arena); \
+    SERIALIZE_CHARACTER((string_builder), (x)); \
+} while (0)
+
+#define SERIALIZE_CSTRING_ARENA(string_builder, cstring, arena) do { \
+    const char* _sca_cstring = (cstring); \
+    StringView _sca_tail = {_sca_cstring, strlen(_sca_cstring)}; \
+    RESERVE_EXPONENTIAL_GROWTH_ARENA((string_builder), (string_builder).count + _sca_tail.count + 1, arena); \
+    CONCAT((string_builder), _sca_tail); \
+    (string_builder).data[(string_builder).count] = '\0'; \
+} while (0)
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "carma_std.h"
+
+#include "carma.h"
+#include "carma_string.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CARMA_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define CARMA_HAS_MMAP 0
+#endif
+
+// A mapped file is a read-only range of the bytes of a file.
+// It is backed by mmap when possible, and otherwise by a buffer
+// that the whole file is read into. Use MAKE_MAPPED_FILE and FREE_MAPPED_FILE.
+// The bytes are not null terminated.
+typedef struct MappedFile {
+    const char* data;
+    size_t count;
+    bool is_mapped;
+} MappedFile;
+
+// Reads the rest of a stream into a buffer of exactly the read size.
+// Used for pipes and other files that cannot be mapped.
+static inline
+MappedFile carma_read_mapped_file(FILE* file) {
+    StringBuilder buffer = {};
+    READ_STREAM(buffer, file);
+    if (buffer.count == 0) {
+        FREE_DARRAY(buffer);
+        return (MappedFile){};
+    }
+    char* data = (char*)carma_reallocate(CARMA_ALLOCATOR, buffer.data, buffer.capacity, buffer.count);
+    CHECK_INTERNAL(data, "realloc failed");
+    return (MappedFile){data, buffer.count, false};
+}
+
+// Returns an empty MappedFile if the file cannot be opened.
+static inline
+MappedFile carma_map_file(const char* file_path) {
+#if CARMA_HAS_MMAP
+    int descriptor = open(file_path, O_RDONLY);
+    if (descriptor < 0) {
+        return (MappedFile){};
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode)) {
+        size_t count = (size_t)status.st_size;
+        if (count == 0) {
+            close(descriptor);
+            return (MappedFile){};
+        }
+        void* data = mmap(NULL, count, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (data != MAP_FAILED) {
+            posix_madvise(data, count, POSIX_MADV_SEQUENTIAL);
+            close(descriptor);
+            return (MappedFile){(const char*)data, count, true};
+        }
+    }
+    // Read through the same descriptor, since pipes can only be opened once.
+    FILE* file = fdopen(descriptor, "rb");
+    if (!file) {
+        close(descriptor);
+        return (MappedFile){};
+    }
+#else
+    FILE* file = fopen(file_path, "rb");
+    if (!file) {
+        return (MappedFile){};
+    }
+#endif
+    MappedFile result = carma_read_mapped_file(file);
+    fclose(file);
+    return result;
+}
+
+static inline
+void carma_unmap_file(MappedFile file) {
+    if (!file.data) {
+        return;
+    }
+#if CARMA_HAS_MMAP
+    if (file.is_mapped) {
+        munmap((void*)(uintptr_t)file.data, file.count);
+        return;
+    }
+#endif
+    carma_free(CARMA_ALLOCATOR, (void*)(uintptr_t)file.data, file.count);
+}
+
+#define MAKE_MAPPED_FILE(file_path) carma_map_file(file_path)
+
+#define FREE_MAPPED_FILE(mapped_file) do { \
+    carma_unmap_file(mapped_file); \
+    (mapped_file) = (MappedFile){}; \
+} while (0)
@@ -0,0 +1,322 @@
+#pragma once
+
+#include "carma.h"
+#include "carma_json_parse.h"
+#include "carma_make.h"
+#include "carma_string.h"
+
+/*
+An index of a json document is built once, in a single pass over the text,
+and then lets you jump directly to values, instead of re-parsing the text for each key.
+The indexed macros return the same StringView as the non-indexed macros,
+so you can mix them with the other parsing macros:
+
+StringView json = ...;
+JsonIndex index = MAKE_JSON_INDEX(json);
+int width = PARSE_JSON_KEY_INT_INDEXED(index, json, "width");
+StringView points_x = PARSE_JSON_KEY_INDEXED(index, json, "points_x");
+FOR_EACH_JSON_ARRAY_ITEM_INDEXED(item, index, points_x) {
+    double x = PARSE_DOUBLE(item);
+}
+FREE_JSON_INDEX(index);
+*/
+
+typedef enum JsonTokenType {
+    JSON_TOKEN_OBJECT,
+    JSON_TOKEN_ARRAY,
+    JSON_TOKEN_STRING,
+    JSON_TOKEN_SCALAR,
+} JsonTokenType;
+
+// A token is a value of the document, or a key of an object.
+// The begin and count give the same StringView as parse_json_item for strings and scalars,
+// so strings are without quotes. Objects and arrays include their brackets and end at the closing one,
+// while parse_json_item also includes any whitespace after the closing bracket.
+// The tokens are stored in the order of the text, and next is the index of the token after
+// the value and all its nested values, which is used to skip them.
+// The keys and values of an object are stored as key, value, key, value...
+// The offsets are 32 bits to keep the tokens small, which limits the text to 4 GB.
+typedef struct JsonToken {
+    uint32_t begin;
+    uint32_t count;
+    uint32_t next;
+    JsonTokenType type;
+} JsonToken;
+
+// The text is what the offsets of the tokens are relative to.
+// The hint is the last token that was found, since lookups tend to be close to each other.
+typedef struct JsonIndex {
+    JsonToken* data;
+    size_t count;
+    size_t capacity;
+    const char* text;
+    size_t hint;
+} JsonIndex;
+
+typedef struct JsonIndexStack {
+    size_t* data;
+    size_t count;
+    size_t capacity;
+} JsonIndexStack;
+
+// The children of an object or array token, used for the loops.
+typedef struct JsonIndexCursor {
+    const JsonToken* it;
+    const JsonToken* end;
+} JsonIndexCursor;
+
+////////////////////////////////////////////////////////////////////////////////
+// BUILDING THE INDEX
+
+// Indexes the first json value of the text, and ignores anything after it.
+// Returns an empty index if the structure of the value is broken,
+// like unbalanced brackets, missing commas and colons, or unterminated strings.
+// The scalars are only split on the structural characters and whitespace, and not checked.
+static inline
+JsonIndex carma_make_json_index(StringView json) {
+    CHECK_EXTERNAL(json.count <= UINT32_MAX, "Json index only supports texts up to 4 GB, not %zu bytes", json.count);
+    auto index = MAKE(JsonIndex, .text=json.data);
+    auto stack = MAKE(JsonIndexStack);
+    auto state = CARMA_JSON_EXPECT_VALUE;
+    auto it = json.data;
+    auto end = END_POINTER(json);
+    while (!(state == CARMA_JSON_EXPECT_COMMA_OR_CLOSE && IS_EMPTY(stack))) {
+        for (; it != end && carma_is_json_whitespace(*it); ++it) {
+        }
+        if (it == end) {
+            break;
+        }
+        auto c = *it;
+        auto is_value_expected = state == CARMA_JSON_EXPECT_VALUE || state == CARMA_JSON_EXPECT_VALUE_OR_CLOSE;
+        auto is_key_expected = state == CARMA_JSON_EXPECT_KEY || state == CARMA_JSON_EXPECT_KEY_OR_CLOSE;
+        if (c == '{' || c == '[') {
+            if (!is_value_expected) {
+                break;
+            }
+            APPEND(stack, index.count);
+            JsonTokenType type = c == '{' ? JSON_TOKEN_OBJECT : JSON_TOKEN_ARRAY;
+            APPEND(index, ((JsonToken){(uint32_t)(it - json.data), 0, 0, type}));
+            state = c == '{' ? CARMA_JSON_EXPECT_KEY_OR_CLOSE : CARMA_JSON_EXPECT_VALUE_OR_CLOSE;
+            ++it;
+        } else if (c == '}' || c == ']') {
+            if (IS_EMPTY(stack)) {
+                break;
+            }
+            auto token = &index.data[LAST_ITEM(stack)];
+            JsonTokenType type = c == '}' ? JSON_TOKEN_OBJECT : JSON_TOKEN_ARRAY;
+            auto close_state = c == '}' ? CARMA_JSON_EXPECT_KEY_OR_CLOSE : CARMA_JSON_EXPECT_VALUE_OR_CLOSE;
+            if (token->type != type || (state != CARMA_JSON_EXPECT_COMMA_OR_CLOSE && state != close_state)) {
+                break;
+            }
+            ++it;
+            token->count = (uint32_t)(it - json.data) - token->begin;
+            token->next = (uint32_t)index.count;
+            DROP_BACK(stack);
+            state = CARMA_JSON_EXPECT_COMMA_OR_CLOSE;
+        } else if (c == ',') {
+            if (state != CARMA_JSON_EXPECT_COMMA_OR_CLOSE) {
+                break;
+            }
+            auto is_object = index.data[LAST_ITEM(stack)].type == JSON_TOKEN_OBJECT;
+            state = is_object ? CARMA_JSON_EXPECT_KEY : CARMA_JSON_EXPECT_VALUE;
+            ++it;
+        } else if (c == ':') {
+            if (state != CARMA_JSON_EXPECT_COLON) {
+                break;
+            }
+            state = CARMA_JSON_EXPECT_VALUE;
+            ++it;
+        } else if (c == '"') {
+            if (!is_value_expected && !is_key_expected) {
+                break;
+            }
+            auto begin = it + 1;
+            auto quote = carma_find_quote_or_backslash(begin, end);
+            while (quote != end && *quote == '\\' && end - quote >= 2) {
+                quote = carma_find_quote_or_backslash(quote + 2, end);
+            }
+            if (quote == end || *quote != '"') {
+                break;
+            }
+            auto token = MAKE(JsonToken, (uint32_t)(begin - json.data), (uint32_t)(quote - begin), (uint32_t)index.count + 1, JSON_TOKEN_STRING);
+            APPEND(index, token);
+            state = is_key_expected ? CARMA_JSON_EXPECT_COLON : CARMA_JSON_EXPECT_COMMA_OR_CLOSE;
+            it = quote + 1;
+        } else {
+            if (!is_value_expected) {
+                break;
+            }
+            auto begin = it;
+            for (; it != end && !carma_is_json_scalar_end(*it); ++it) {
+            }
+            if (it == begin) {
+                break;
+            }
+            auto token = MAKE(JsonToken, (uint32_t)(begin - json.data), (uint32_t)(it - begin), (uint32_t)index.count + 1, JSON_TOKEN_SCALAR);
+            APPEND(index, token);
+            state = CARMA_JSON_EXPECT_COMMA_OR_CLOSE;
+        }
+    }
+    auto is_complete = state == CARMA_JSON_EXPECT_COMMA_OR_CLOSE && IS_EMPTY(stack);
+    FREE_DARRAY(stack);
+    if (!is_complete) {
+        FREE_DARRAY(index);
+        index.text = NULL;
+    }
+    return index;
+}
+
+#define MAKE_JSON_INDEX(json) carma_make_json_index(json)
+
+#define FREE_JSON_INDEX(index) do { \
+    FREE_DARRAY(index); \
+    (index).text = NULL; \
+    (index).hint = 0; \
+} while (0)
+
+static inline
+StringView carma_json_token_value(const JsonIndex* index, const JsonToken* token) {
+    return MAKE(StringView, index->text + token->begin, token->count);
+}
+
+// Returns the StringView of the token with the given index.
+#define JSON_TOKEN_VALUE(index, token_index) carma_json_token_value(&(index), (index).data + (token_index))
+
+////////////////////////////////////////////////////////////////////////////////
+// USING THE INDEX
+
+// Returns the token of a value that was returned by the index, or the count of the index if there is none.
+// The tokens are sorted on their position in the text, so they are searched with a galloping search
+// from the hint, followed by a binary search.
+static inline
+size_t carma_find_json_token(JsonIndex* index, StringView value) {
+    parse_whitespace(&value);
+    if (IS_EMPTY(*index) || (uintptr_t)value.data < (uintptr_t)index->text ||
+        (uintptr_t)value.data - (uintptr_t)index->text > UINT32_MAX) {
+        return index->count;
+    }
+    auto offset = (uint32_t)((uintptr_t)value.data - (uintptr_t)index->text);
+    auto hint = index->hint < index->count ? index->hint : 0;
+    size_t low = 0;
+    size_t high = index->count;
+    if (index->data[hint].begin <= offset) {
+        low = hint;
+        for (size_t step = 1; hint + step < index->count; step *= 2) {
+            if (index->data[hint + step].begin > offset) {
+                high = hint + step;
+                break;
+            }
+            low = hint + step;
+        }
+    } else {
+        high = hint;
+        for (size_t step = 1; step <= hint; step *= 2) {
+            if (index->data[hint - step].begin <= offset) {
+                low = hint - step;
+                break;
+            }
+            high = hint - step;
+        }
+    }
+    // Find the last token that begins at or before the value:
+    while (high - low > 1) {
+        auto middle = low + (high - low) / 2;
+        if (index->data[middle].begin <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    if (index->data[low].begin != offset) {
+        return index->count;
+    }
+    index->hint = low;
+    return low;
+}
+
+static inline
+JsonIndexCursor carma_find_json_children(JsonIndex* index, StringView value, JsonTokenType type) {
+    auto token = carma_find_json_token(index, value);
+    if (token == index->count || index->data[token].type != type) {
+        return MAKE(JsonIndexCursor);
+    }
+    return MAKE(JsonIndexCursor, index->data + token + 1, index->data + index->data[token].next);
+}
+
+// Also moves the hint to the value, so that looking it up is fast.
+static inline
+StringView carma_json_cursor_value(JsonIndex* index, JsonIndexCursor cursor, size_t offset) {
+    if (cursor.it == cursor.end) {
+        return MAKE(StringView);
+    }
+    index->hint = (size_t)(cursor.it - index->data) + offset;
+    return carma_json_token_value(index, cursor.it + offset);
+}
+
+// Loops through the items of an array that was returned by the index.
+#define FOR_EACH_JSON_ARRAY_ITEM_INDEXED(item, index, array) \
+    for (JsonIndexCursor item##_cursor = carma_find_json_children(&(index), (array), JSON_TOKEN_ARRAY); \
+        item##_cursor.it; \
+        item##_cursor.it = NULL) \
+    for (StringView item = carma_json_cursor_value(&(index), item##_cursor, 0); \
+        item##_cursor.it != item##_cursor.end; \
+        item##_cursor.it = (index).data + item##_cursor.it->next, \
+        (item) = carma_json_cursor_value(&(index), item##_cursor, 0))
+
+// Loops through the keys and values of an object that was returned by the index.
+#define FOR_EACH_JSON_OBJECT_ITEM_INDEXED(key, value, index, object) \
+    for (JsonIndexCursor key##_cursor = carma_find_json_children(&(index), (object), JSON_TOKEN_OBJECT); \
+        key##_cursor.it; \
+        key##_cursor.it = NULL) \
+    for (StringView key = carma_json_cursor_value(&(index), key##_cursor, 0), value = carma_json_cursor_value(&(index), key##_cursor, 1); \
+        key##_cursor.it != key##_cursor.end; \
+        key##_cursor.it = (index).data + key##_cursor.it[1].next, \
+        (key) = carma_json_cursor_value(&(index), key##_cursor, 0), \
+        (value) = carma_json_cursor_value(&(index), key##_cursor, 1))
+
+static inline
+StringView parse_json_key_indexed(JsonIndex* index, StringView object, const char* key) {
+    auto key2 = STRING_VIEW(key);
+    FOR_EACH_JSON_OBJECT_ITEM_INDEXED(k, v, *index, object) {
+        if (ARE_EQUAL(key2, k)) {
+            return v;
+        }
+    }
+    return MAKE(StringView);
+}
+
+#define PARSE_JSON_KEY_INDEXED(index, object, key) parse_json_key_indexed(&(index), (object), (key))
+
+static inline int parse_json_key_int_indexed_or_exit(JsonIndex* index, StringView s, const char* key) {
+    auto value = parse_json_key_indexed(index, s, key);
+    auto optional = TRY_PARSE_INT(value);
+    if (!optional.ok) {
+        auto cstring = MAKE_CSTRING(s);
+        CARMA_EXIT_FAILURE("Could not parse key %s as int from string: %.16s...\n", key, cstring);
+    }
+    return optional.value;
+}
+
+static inline uint64_t parse_json_key_u64_indexed_or_exit(JsonIndex* index, StringView s, const char* key) {
+    auto value = parse_json_key_indexed(index, s, key);
+    auto optional = TRY_PARSE_U64(value);
+    if (!optional.ok) {
+        auto cstring = MAKE_CSTRING(s);
+        CARMA_EXIT_FAILURE("Could not parse key %s as u64 from string: %.16s...\n", key, cstring);
+    }
+    return optional.value;
+}
+
+static inline double parse_json_key_double_indexed_or_exit(JsonIndex* index, StringView s, const char* key) {
+    auto value = parse_json_key_indexed(index, s, key);
+    auto optional = TRY_PARSE_DOUBLE(value);
+    if (!optional.ok) {
+        auto cstring = MAKE_CSTRING(s);
+        CARMA_EXIT_FAILURE("Could not parse key %s as double from string: %.16s...\n", key, cstring);
+    }
+    return optional.value;
+}
+
+#define PARSE_JSON_KEY_INT_INDEXED(index, s, key) parse_json_key_int_indexed_or_exit(&(index), (s), key)
+#define PARSE_JSON_KEY_U64_INDEXED(index, s, key) parse_json_key_u64_indexed_or_exit(&(index), (s), key)
+#define PARSE_JSON_KEY_DOUBLE_INDEXED(index, s, key) parse_json_key_double_indexed_or_exit(&(index), (s), key)
@@ -5,18 +5,125 @@
 
 /*
 * Make parse_json_key_int_or_exit report outer file and line on failure.
-* More principled distinction between empty collections and parsing failure for
-  strings, arrays, objects.
+*/
+
+/*
+The parsing functions return a StringView with NULL data when they fail,
+so that failures can be told apart from empty strings like "".
 */
 
 static inline
 StringView parse_json_item(StringView* s);
 
+// Scalars like numbers and true are not quoted, so they end at the next structural character or whitespace.
+static inline
+bool carma_is_json_scalar_end(char c) {
+    switch (c) {
+        case ',': case ':': case '[': case ']': case '{': case '}': case '"':
+        case ' ': case '\t': case '\n': case '\r': case '\v': case '\f':
+            return true;
+    }
+    return false;
+}
+
+// The whitespace of the json grammar, which is stricter than is_whitespace.
+static inline
+bool carma_is_json_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Where a json token ends, or where it stops following the json grammar.
+typedef struct CarmaJsonSkip {
+    const char* it;
+    bool ok;
+} CarmaJsonSkip;
+
+static inline
+CarmaJsonSkip carma_skip_json_digits(const char* it, const char* end) {
+    if (it == end || !is_digit(*it)) {
+        return MAKE(CarmaJsonSkip, it, false);
+    }
+    for (++it; it != end && is_digit(*it); ++it) {
+    }
+    return MAKE(CarmaJsonSkip, it, true);
+}
+
+// Skips an optional minus, an integer without leading zeros, an optional fraction and an optional exponent.
+static inline
+CarmaJsonSkip carma_skip_json_number(const char* it, const char* end) {
+    if (it != end && *it == '-') {
+        ++it;
+    }
+    auto skip = MAKE(CarmaJsonSkip, it + 1, true);
+    if (it == end || *it != '0') {
+        skip = carma_skip_json_digits(it, end);
+    }
+    if (skip.ok && skip.it != end && *skip.it == '.') {
+        skip = carma_skip_json_digits(skip.it + 1, end);
+    }
+    if (skip.ok && skip.it != end && (*skip.it == 'e' || *skip.it == 'E')) {
+        it = skip.it + 1;
+        if (it != end && (*it == '+' || *it == '-')) {
+            ++it;
+        }
+        skip = carma_skip_json_digits(it, end);
+    }
+    return skip;
+}
+
+static inline
+CarmaJsonSkip carma_skip_json_literal(const char* it, const char* end, const char* literal) {
+    for (; *literal; ++it, ++literal) {
+        if (it == end || *it != *literal) {
+            return MAKE(CarmaJsonSkip, it, false);
+        }
+    }
+    return MAKE(CarmaJsonSkip, it, true);
+}
+
+// Skips true, false, null or a number.
+static inline
+CarmaJsonSkip carma_skip_json_scalar(const char* it, const char* end) {
+    if (it == end) {
+        return MAKE(CarmaJsonSkip, it, false);
+    }
+    switch (*it) {
+        case 't': return carma_skip_json_literal(it, end, "true");
+        case 'f': return carma_skip_json_literal(it, end, "false");
+        case 'n': return carma_skip_json_literal(it, end, "null");
+    }
+    return carma_skip_json_number(it, end);
+}
+
+// Returns true, false, null or a number, and leaves the input as it is if there is none.
+// A number is returned as text, for the number parsers like TRY_PARSE_DOUBLE.
+static inline
+StringView parse_json_scalar(StringView* s) {
+    auto skip = carma_skip_json_scalar(s->data, END_POINTER(*s));
+    if (!skip.ok) {
+        return MAKE(StringView);
+    }
+    auto scalar = MAKE(StringView, s->data, (size_t)(skip.it - s->data));
+    s->data = skip.it;
+    s->count -= scalar.count;
+    return scalar;
+}
+
+#define PARSE_JSON_SCALAR(s) parse_json_scalar(&(s))
+
+// Like parse_quoted_string, but returns NULL data for unterminated strings.
+static inline
+StringView carma_parse_json_string(StringView* s) {
+    auto begin = s->data;
+    auto value = parse_quoted_string(s);
+    return s->data != begin ? value : MAKE(StringView);
+}
+
 static inline
 StringView parse_json_object_key(StringView* s) {
     parse_whitespace(s);
-    auto key = parse_quoted_string(s);
-    if (IS_EMPTY(key)) {
+    auto key = carma_parse_json_string(s);
+    if (!key.data) {
         return MAKE(StringView);
     }
     if (!parse_structural_character(s, ':')) {
@@ -29,7 +136,7 @@ static inline
 StringView parse_json_object_value(StringView* s) {
     parse_whitespace(s);
     auto value = parse_json_item(s);
-    if (IS_EMPTY(value)) {
+    if (!value.data) {
         return MAKE(StringView);
     }
     parse_whitespace(s);
@@ -54,7 +161,7 @@ StringView parse_first_json_array_item(StringView* s) {
         return MAKE(StringView);
     }
     auto result = parse_json_item(s);
-    if (IS_EMPTY(result)) {
+    if (!result.data) {
         return MAKE(StringView);
     }
     return result;
@@ -72,7 +179,7 @@ StringView parse_next_json_array_item(StringView* s) {
         return MAKE(StringView);
     }
     auto result = parse_json_item(s);
-    if (IS_EMPTY(result)) {
+    if (!result.data) {
         return MAKE(StringView);
     }
     return result;
@@ -85,7 +192,7 @@ StringView parse_json_array(StringView* s) {
         return MAKE(StringView);
     }
     while (!IS_EMPTY(*s) && FIRST_ITEM(*s) != ']') {
-        if (IS_EMPTY(parse_json_item(s))) {
+        if (!parse_json_item(s).data) {
             return MAKE(StringView);
         }
         if (!parse_structural_character(s, ',')) {
@@ -111,8 +218,8 @@ StringView parse_first_json_object_key(StringView* s) {
     if (parse_structural_character(s, '}')) {
         return MAKE(StringView);
     }
-    auto result = parse_quoted_string(s);
-    if (IS_EMPTY(result)) {
+    auto result = carma_parse_json_string(s);
+    if (!result.data) {
         return MAKE(StringView);
     }
     return result;
@@ -125,7 +232,7 @@ StringView parse_next_json_object_value(StringView* s) {
         return MAKE(StringView);
     }
     auto result = parse_json_item(s);
-    if (IS_EMPTY(result)) {
+    if (!result.data) {
         return MAKE(StringView);
     }
     return result;
@@ -141,8 +248,8 @@ StringView parse_next_json_object_key(StringView* s) {
     if (!parse_structural_character(s, ',')) {
         return MAKE(StringView);
     }
-    auto result = parse_quoted_string(s);
-    if (IS_EMPTY(result)) {
+    auto result = carma_parse_json_string(s);
+    if (!result.data) {
         return MAKE(StringView);
     }
     return result;
@@ -155,10 +262,10 @@ StringView parse_json_object(StringView* s) {
         return MAKE(StringView);
     }
     while (!parse_structural_character(s, '}')) {
-        if (IS_EMPTY(parse_json_object_key(s))) {
+        if (!parse_json_object_key(s).data) {
             return MAKE(StringView);
         }
-        if (IS_EMPTY(parse_json_object_value(s))) {
+        if (!parse_json_object_value(s).data) {
             return MAKE(StringView);
         }
     }
@@ -178,21 +285,21 @@ StringView parse_json_item(StringView* s) {
     switch (c) {
         case '{': return parse_json_object(s);
         case '[': return parse_json_array(s);
-        case '"': return parse_quoted_string(s);
+        case '"': return carma_parse_json_string(s);
     }
-    return parse_int_as_string(s);
+    return parse_json_scalar(s);
 }
 
 #define FOR_EACH_JSON_ARRAY_ITEM(item, array) \
     for (auto (item) = parse_first_json_array_item(&array); \
-    !IS_EMPTY(item); \
+    (item).data; \
     (item) = parse_next_json_array_item(&array))
 
 #define FOR_EACH_JSON_OBJECT_ITEM(key, value, object) \
     for ( \
         StringView (key) = parse_first_json_object_key(&object), \
         (value) = parse_next_json_object_value(&object); \
-        !IS_EMPTY(key) && !IS_EMPTY(value); \
+        (key).data && (value).data; \
         (key) = parse_next_json_object_key(&object), \
         (value) = parse_next_json_object_value(&object) \
     )
@@ -243,3 +350,260 @@ static inline double parse_json_key_double_or_exit(StringView s, const char* key
 #define PARSE_JSON_KEY_INT(s, key) parse_json_key_int_or_exit((s), key)
 #define PARSE_JSON_KEY_U64(s, key) parse_json_key_u64_or_exit((s), key)
 #define PARSE_JSON_KEY_DOUBLE(s, key) parse_json_key_double_or_exit((s), key)
+
+////////////////////////////////////////////////////////////////////////////////
+// VALIDATION
+
+// What the grammar allows at the current position of the text.
+typedef enum CarmaJsonState {
+    CARMA_JSON_EXPECT_VALUE,
+    CARMA_JSON_EXPECT_VALUE_OR_CLOSE,
+    CARMA_JSON_EXPECT_KEY,
+    CARMA_JSON_EXPECT_KEY_OR_CLOSE,
+    CARMA_JSON_EXPECT_COLON,
+    CARMA_JSON_EXPECT_COMMA_OR_CLOSE,
+} CarmaJsonState;
+
+// Skips the rest of a string after the opening quote,
+// and checks that it has no control characters and only the escape sequences of the json grammar.
+static inline
+CarmaJsonSkip carma_skip_json_string(const char* it, const char* end) {
+    for (;;) {
+        it = carma_find_json_string_end(it, end);
+        if (it == end || (unsigned char)*it < 0x20) {
+            return MAKE(CarmaJsonSkip, it, false);
+        }
+        if (*it == '"') {
+            return MAKE(CarmaJsonSkip, it + 1, true);
+        }
+        if (++it == end) {
+            return MAKE(CarmaJsonSkip, it, false);
+        }
+        switch (*it) {
+            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                ++it;
+                break;
+            case 'u':
+                ++it;
+                for (int i = 0; i < 4; ++i, ++it) {
+                    if (it == end || !is_hex_digit(*it)) {
+                        return MAKE(CarmaJsonSkip, it, false);
+                    }
+                }
+                break;
+            default:
+                return MAKE(CarmaJsonSkip, it, false);
+        }
+    }
+}
+
+// The error offset is the position of the first byte that breaks the json grammar,
+// or the count of the text if it ends too early.
+typedef struct JsonValidation {
+    size_t error_offset;
+    bool ok;
+} JsonValidation;
+
+// Checks that the text is a single json value, surrounded by optional whitespace, as in RFC 8259.
+// It is done in a single pass, and stops at the first error.
+// The bytes of strings are not checked to be UTF-8.
+static inline
+JsonValidation validate_json(StringView json) {
+    auto stack = MAKE(StringBuilder);
+    CarmaJsonState state = CARMA_JSON_EXPECT_VALUE;
+    auto it = json.data;
+    auto end = END_POINTER(json);
+    for (;;) {
+        for (; it != end && carma_is_json_whitespace(*it); ++it) {
+        }
+        if (it == end || (state == CARMA_JSON_EXPECT_COMMA_OR_CLOSE && IS_EMPTY(stack))) {
+            break;
+        }
+        auto c = *it;
+        auto is_value_expected = state == CARMA_JSON_EXPECT_VALUE || state == CARMA_JSON_EXPECT_VALUE_OR_CLOSE;
+        auto is_key_expected = state == CARMA_JSON_EXPECT_KEY || state == CARMA_JSON_EXPECT_KEY_OR_CLOSE;
+        if (c == '{' || c == '[') {
+            if (!is_value_expected) {
+                break;
+            }
+            APPEND(stack, c);
+            state = c == '{' ? CARMA_JSON_EXPECT_KEY_OR_CLOSE : CARMA_JSON_EXPECT_VALUE_OR_CLOSE;
+            ++it;
+        } else if (c == '}' || c == ']') {
+            auto open = c == '}' ? '{' : '[';
+            CarmaJsonState close_state = c == '}' ? CARMA_JSON_EXPECT_KEY_OR_CLOSE : CARMA_JSON_EXPECT_VALUE_OR_CLOSE;
+            if (IS_EMPTY(stack) || LAST_ITEM(stack) != open ||
+                (state != CARMA_JSON_EXPECT_COMMA_OR_CLOSE && state != close_state)) {
+                break;
+            }
+            DROP_BACK(stack);
+            state = CARMA_JSON_EXPECT_COMMA_OR_CLOSE;
+            ++it;
+        } else if (c == ',') {
+            if (state != CARMA_JSON_EXPECT_COMMA_OR_CLOSE) {
+                break;
+            }
+            state = LAST_ITEM(stack) == '{' ? CARMA_JSON_EXPECT_KEY : CARMA_JSON_EXPECT_VALUE;
+            ++it;
+        } else if (c == ':') {
+            if (state != CARMA_JSON_EXPECT_COLON) {
+                break;
+            }
+            state = CARMA_JSON_EXPECT_VALUE;
+            ++it;
+        } else if (c == '"') {
+            if (!is_value_expected && !is_key_expected) {
+                break;
+            }
+            auto skip = carma_skip_json_string(it + 1, end);
+            it = skip.it;
+            if (!skip.ok) {
+                break;
+            }
+            state = is_key_expected ? CARMA_JSON_EXPECT_COLON : CARMA_JSON_EXPECT_COMMA_OR_CLOSE;
+        } else {
+            if (!is_value_expected) {
+                break;
+            }
+            auto skip = carma_skip_json_scalar(it, end);
+            it = skip.it;
+            if (!skip.ok) {
+                break;
+            }
+            state = CARMA_JSON_EXPECT_COMMA_OR_CLOSE;
+        }
+    }
+    auto ok = it == end && state == CARMA_JSON_EXPECT_COMMA_OR_CLOSE && IS_EMPTY(stack);
+    FREE_DARRAY(stack);
+    return MAKE(JsonValidation, (size_t)(it - json.data), ok);
+}
+
+#define VALIDATE_JSON(s) validate_json(s)
+
+////////////////////////////////////////////////////////////////////////////////
+// UNESCAPING
+
+// Returns the value of four hex digits, or -1 if they are not hex digits.
+static inline
+int32_t carma_parse_hex4(const char* it) {
+    int32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        auto c = it[i];
+        int32_t digit = is_digit(c) ? c - '0' : ('a' <= (c | 0x20) && (c | 0x20) <= 'f') ? (c | 0x20) - 'a' + 10 : -1;
+        if (digit < 0) {
+            return -1;
+        }
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+// Writes the code point as 1 to 4 bytes of UTF-8, and returns the number of bytes.
+static inline
+size_t carma_encode_utf8(char* out, uint32_t code_point) {
+    if (code_point < 0x80) {
+        out[0] = (char)code_point;
+        return 1;
+    }
+    if (code_point < 0x800) {
+        out[0] = (char)(0xC0 | (code_point >> 6));
+        out[1] = (char)(0x80 | (code_point & 0x3F));
+        return 2;
+    }
+    if (code_point < 0x10000) {
+        out[0] = (char)(0xE0 | (code_point >> 12));
+        out[1] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (code_point & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (code_point >> 18));
+    out[1] = (char)(0x80 | ((code_point >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (code_point & 0x3F));
+    return 4;
+}
+
+// Decodes the escape sequences of a string that was returned by the json parsing functions.
+// The unicode escapes are written as UTF-8, where surrogate pairs are combined
+// and lone surrogates are replaced by the replacement character U+FFFD.
+// The out needs room for escaped.count bytes, since the decoded string is never longer,
+// and out can be escaped.data to decode the string in place.
+// The backslashes are found with memchr, and the bytes between them are copied in blocks.
+// Returns the decoded string in out, or a StringView with NULL data for invalid escapes.
+static inline
+StringView carma_unescape_json_string(char* out, StringView escaped) {
+    auto it = escaped.data;
+    auto end = END_POINTER(escaped);
+    auto out_it = out;
+    while (it != end) {
+        auto backslash = (const char*)memchr(it, '\\', (size_t)(end - it));
+        auto count = (size_t)((backslash ? backslash : end) - it);
+        if (out_it != it) {
+            memmove(out_it, it, count);
+        }
+        out_it += count;
+        if (!backslash) {
+            break;
+        }
+        it = backslash + 1;
+        if (it == end) {
+            return MAKE(StringView);
+        }
+        auto c = *it++;
+        switch (c) {
+            case '"': case '\\': case '/': *out_it++ = c; break;
+            case 'b': *out_it++ = '\b'; break;
+            case 'f': *out_it++ = '\f'; break;
+            case 'n': *out_it++ = '\n'; break;
+            case 'r': *out_it++ = '\r'; break;
+            case 't': *out_it++ = '\t'; break;
+            case 'u': {
+                auto code_point = end - it >= 4 ? carma_parse_hex4(it) : -1;
+                if (code_point < 0) {
+                    return MAKE(StringView);
+                }
+                it += 4;
+                if (0xD800 <= code_point && code_point <= 0xDBFF && end - it >= 6 && it[0] == '\\' && it[1] == 'u') {
+                    auto low = carma_parse_hex4(it + 2);
+                    if (0xDC00 <= low && low <= 0xDFFF) {
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                        it += 6;
+                    }
+                }
+                if (0xD800 <= code_point && code_point <= 0xDFFF) {
+                    code_point = 0xFFFD;
+                }
+                out_it += carma_encode_utf8(out_it, (uint32_t)code_point);
+                break;
+            }
+            default:
+                return MAKE(StringView);
+        }
+    }
+    return MAKE(StringView, out, (size_t)(out_it - out));
+}
+
+// Appends the decoded string to a StringBuilder, and returns false for invalid escapes,
+// in which case the StringBuilder is left as it was.
+static inline
+bool unescape_json_string(StringBuilder* string_builder, StringView escaped) {
+    if (IS_EMPTY(escaped)) {
+        return true;
+    }
+    RESERVE_EXPONENTIAL_GROWTH(*string_builder, string_builder->count + escaped.count);
+    auto decoded = carma_unescape_json_string(END_POINTER(*string_builder), escaped);
+    string_builder->count += decoded.count;
+    return decoded.data != NULL;
+}
+
+#define UNESCAPE_JSON_STRING(string_builder, escaped) unescape_json_string(&(string_builder), (escaped))
+
+// Decodes a string in the buffer that it points into, which needs to be mutable,
+// like the text from read_text_file. Returns the decoded string at the same data,
+// or a StringView with NULL data for invalid escapes.
+static inline
+StringView unescape_json_string_in_place(StringView escaped) {
+    return carma_unescape_json_string((char*)(uintptr_t)escaped.data, escaped);
+}
+
+#define UNESCAPE_JSON_STRING_IN_PLACE(escaped) unescape_json_string_in_place(escaped)
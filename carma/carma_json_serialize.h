@@ -3,6 +3,7 @@
 #include "carma_std.h"
 
 #include "carma.h"
+#include "carma_parse.h"
 #include "carma_string.h"
 
 /*
@@ -47,7 +48,7 @@ typedef struct JsonBuilder {
 static inline void carma_handle_json_array_delimiter(JsonBuilder* json) {
     if (ENDS_WITH_ITEM(json->context_stack, JSON_ARRAY)) {
         if (!ENDS_WITH_ITEM(json->string, '[')) {
-            APPEND(json->string, ',');
+            SERIALIZE_CHARACTER(json->string, ',');
         }
     }
 }
@@ -55,30 +56,30 @@ static inline void carma_handle_json_array_delimiter(JsonBuilder* json) {
 static inline void carma_handle_json_object_delimiter(JsonBuilder* json) {
     if (ENDS_WITH_ITEM(json->context_stack, JSON_OBJECT)) {
         if (!ENDS_WITH_ITEM(json->string, '{')) {
-            APPEND(json->string, ',');
+            SERIALIZE_CHARACTER(json->string, ',');
         }
     }
 }
 
 static inline void carma_begin_json_array(JsonBuilder* json) {
     carma_handle_json_array_delimiter(json);
-    APPEND(json->string, '[');
+    SERIALIZE_CHARACTER(json->string, '[');
     APPEND(json->context_stack, JSON_ARRAY);
 }
 
 static inline void carma_end_json_array(JsonBuilder* json) {
-    APPEND(json->string, ']');
+    SERIALIZE_CHARACTER(json->string, ']');
     DROP_BACK(json->context_stack);
 }
 
 static inline void carma_begin_json_object(JsonBuilder* json) {
     carma_handle_json_array_delimiter(json);
-    APPEND(json->string, '{');
+    SERIALIZE_CHARACTER(json->string, '{');
     APPEND(json->context_stack, JSON_OBJECT);
 }
 
 static inline void carma_end_json_object(JsonBuilder* json) {
-    APPEND(json->string, '}');
+    SERIALIZE_CHARACTER(json->string, '}');
     DROP_BACK(json->context_stack);
 }
 
@@ -97,21 +98,137 @@ static inline void carma_end_json_object(JsonBuilder* json) {
     SERIALIZE_BOOL((json).string, b); \
 } while(0)
 
-#define ADD_JSON_CSTRING(json, s) do { \
+// Writes the escape sequence of a quote, backslash or control character, and returns its length.
+static inline
+size_t carma_write_json_escape(char* out, char c) {
+    out[0] = '\\';
+    switch (c) {
+        case '"': out[1] = '"'; return 2;
+        case '\\': out[1] = '\\'; return 2;
+        case '\b': out[1] = 'b'; return 2;
+        case '\f': out[1] = 'f'; return 2;
+        case '\n': out[1] = 'n'; return 2;
+        case '\r': out[1] = 'r'; return 2;
+        case '\t': out[1] = 't'; return 2;
+    }
+    const char* hex_digits = "0123456789abcdef";
+    out[1] = 'u';
+    out[2] = '0';
+    out[3] = '0';
+    out[4] = hex_digits[(unsigned char)c >> 4];
+    out[5] = hex_digits[(unsigned char)c & 0xF];
+    return 6;
+}
+
+// Appends the string between quotes, and escapes the quotes, backslashes and control characters.
+// The runs of characters that need no escapes are found 16 bytes at a time and copied in blocks.
+static inline
+void carma_serialize_json_string(StringBuilder* string, StringView s) {
+    // Room for the quotes, the null terminator, and the string if it has no escapes:
+    RESERVE_EXPONENTIAL_GROWTH(*string, string->count + s.count + 3);
+    string->data[string->count++] = '"';
+    auto it = s.data;
+    auto end = END_POINTER(s);
+    while (it != end) {
+        auto special = carma_find_json_string_end(it, end);
+        auto count = (size_t)(special - it);
+        memcpy(END_POINTER(*string), it, count);
+        string->count += count;
+        if (special == end) {
+            break;
+        }
+        // Room for the rest of the string and the longest escape sequence:
+        RESERVE_EXPONENTIAL_GROWTH(*string, string->count + (size_t)(end - special) + 8);
+        string->count += carma_write_json_escape(END_POINTER(*string), *special);
+        it = special + 1;
+    }
+    string->data[string->count++] = '"';
+    string->data[string->count] = '\0';
+}
+
+#define ADD_JSON_STRING_VIEW(json, s) do { \
     carma_handle_json_array_delimiter(&(json)); \
-    SERIALIZE_CHARACTER((json).string, '"'); \
-    SERIALIZE_CSTRING((json).string, (s)); \
-    SERIALIZE_CHARACTER((json).string, '"'); \
+    carma_serialize_json_string(&(json).string, (s)); \
 } while(0)
 
-#define ADD_JSON_KEY(json, k) do { \
-    carma_handle_json_object_delimiter(&json); \
-    SERIALIZE_CHARACTER((json).string, '"'); \
-    SERIALIZE_CSTRING((json).string, (k)); \
-    SERIALIZE_CHARACTER((json).string, '"'); \
+#define ADD_JSON_CSTRING(json, s) do { \
+    const char* _json_cstring = (s); \
+    ADD_JSON_STRING_VIEW((json), STRING_VIEW(_json_cstring)); \
+} while(0)
+
+#define ADD_JSON_KEY_STRING_VIEW(json, k) do { \
+    carma_handle_json_object_delimiter(&(json)); \
+    carma_serialize_json_string(&(json).string, (k)); \
     SERIALIZE_CHARACTER((json).string, ':'); \
 } while(0)
 
+#define ADD_JSON_KEY(json, k) do { \
+    const char* _json_key = (k); \
+    ADD_JSON_KEY_STRING_VIEW((json), STRING_VIEW(_json_key)); \
+} while(0)
+
+// The array macros below write a whole range as a json array in one loop,
+// with one reservation for the longest text that the items can have,
+// instead of checking delimiters and capacity for each item.
+// The comma after the last item is replaced by the closing bracket.
+static inline
+size_t carma_end_json_array_items(StringBuilder* string, char* it) {
+    if (it[-1] == ',') {
+        --it;
+    }
+    *it++ = ']';
+    *it = '\0';
+    return (size_t)(it - string->data);
+}
+
+// Adds a range of any integer type as a json array.
+#define ADD_JSON_INT_ARRAY(json, range) do { \
+    carma_handle_json_array_delimiter(&(json)); \
+    CARMA_AUTO _json_range = (range); \
+    size_t _json_item_size = CARMA_MAX_SERIALIZED_INTEGRAL_SIZE(*_json_range.data); \
+    RESERVE_EXPONENTIAL_GROWTH((json).string, (json).string.count + _json_range.count * _json_item_size + 3); \
+    char* _json_it = END_POINTER((json).string); \
+    *_json_it++ = '['; \
+    FOR_EACH(_json_item, _json_range) { \
+        _json_it += carma_format_integer(_json_it, (uint64_t)*_json_item, *_json_item < 1 && *_json_item != 0); \
+        *_json_it++ = ','; \
+    } \
+    (json).string.count = carma_end_json_array_items(&(json).string, _json_it); \
+} while(0)
+
+// Adds a range of doubles or floats as a json array.
+#define ADD_JSON_DOUBLE_ARRAY(json, range) do { \
+    carma_handle_json_array_delimiter(&(json)); \
+    CARMA_AUTO _json_range = (range); \
+    RESERVE_EXPONENTIAL_GROWTH((json).string, (json).string.count + _json_range.count * CARMA_MAX_SERIALIZED_DOUBLE_SIZE + 3); \
+    char* _json_it = END_POINTER((json).string); \
+    *_json_it++ = '['; \
+    FOR_EACH(_json_item, _json_range) { \
+        _json_it += carma_format_double(_json_it, (double)*_json_item, CARMA_IS_FLOAT(*_json_item)); \
+        *_json_it++ = ','; \
+    } \
+    (json).string.count = carma_end_json_array_items(&(json).string, _json_it); \
+} while(0)
+
+// Adds a range of bools, or of anything that can be a condition, as a json array.
+#define ADD_JSON_BOOL_ARRAY(json, range) do { \
+    carma_handle_json_array_delimiter(&(json)); \
+    CARMA_AUTO _json_range = (range); \
+    RESERVE_EXPONENTIAL_GROWTH((json).string, (json).string.count + _json_range.count * 6 + 3); \
+    char* _json_it = END_POINTER((json).string); \
+    *_json_it++ = '['; \
+    FOR_EACH(_json_item, _json_range) { \
+        if (*_json_item) { \
+            memcpy(_json_it, "true,", 5); \
+            _json_it += 5; \
+        } else { \
+            memcpy(_json_it, "false,", 6); \
+            _json_it += 6; \
+        } \
+    } \
+    (json).string.count = carma_end_json_array_items(&(json).string, _json_it); \
+} while(0)
+
 #define ADD_JSON_ARRAY(json) for ( \
     bool run = (carma_begin_json_array(&json), true); \
     run; \
@@ -0,0 +1,341 @@
+#pragma once
+
+#include "carma.h"
+#include "carma_json_parse.h"
+#include "carma_make.h"
+#include "carma_string.h"
+
+/*
+A json stream parses a document that is given in chunks, instead of in one StringView,
+so files can be parsed without reading all of them into memory.
+You feed it chunks of bytes and get events for the values, keys and brackets:
+
+JsonStream stream = MAKE_JSON_STREAM();
+FEED_JSON_STREAM(stream, chunk);
+FOR_EACH_JSON_EVENT(event, stream) {
+    if (event.type == JSON_EVENT_KEY && ARE_EQUAL(event.value, STRING_LITERAL("width"))) {
+        ...
+    }
+}
+FEED_JSON_STREAM(stream, next_chunk);
+...
+FINISH_JSON_STREAM(stream);
+FOR_EACH_JSON_EVENT(event, stream) {
+    ...
+}
+FREE_JSON_STREAM(stream);
+
+Or you let it read the chunks from a file:
+
+JsonStream stream = MAKE_NDJSON_STREAM();
+FOR_EACH_JSON_FILE_EVENT(event, stream, file) {
+    if (event.type == JSON_EVENT_END_DOCUMENT) {
+        record_count++;
+    }
+}
+FREE_JSON_STREAM(stream);
+*/
+
+typedef enum JsonEventType {
+    // No more events until more input is fed, or no more events at all when the stream is finished.
+    JSON_EVENT_NONE,
+    JSON_EVENT_BEGIN_OBJECT,
+    JSON_EVENT_END_OBJECT,
+    JSON_EVENT_BEGIN_ARRAY,
+    JSON_EVENT_END_ARRAY,
+    JSON_EVENT_KEY,
+    JSON_EVENT_STRING,
+    JSON_EVENT_SCALAR,
+    // After each complete root value.
+    JSON_EVENT_END_DOCUMENT,
+    // Reported once, after which the stream gives no more events.
+    JSON_EVENT_ERROR,
+} JsonEventType;
+
+// The value is set for keys, strings and scalars, and is the same StringView that parse_json_item gives.
+// So strings are without quotes and escapes are kept, and scalars are the text for the number parsers.
+// The value points into the fed chunk or into the stream, and is valid until the next event.
+typedef struct JsonEvent {
+    JsonEventType type;
+    StringView value;
+} JsonEvent;
+
+// What the grammar allows at the current position of the stream,
+// or which token is unfinished at the end of the last chunk.
+typedef enum CarmaJsonStreamState {
+    CARMA_JSON_STREAM_EXPECT_ROOT,
+    CARMA_JSON_STREAM_EXPECT_VALUE,
+    CARMA_JSON_STREAM_EXPECT_VALUE_OR_CLOSE,
+    CARMA_JSON_STREAM_EXPECT_KEY,
+    CARMA_JSON_STREAM_EXPECT_KEY_OR_CLOSE,
+    CARMA_JSON_STREAM_EXPECT_COLON,
+    CARMA_JSON_STREAM_EXPECT_COMMA_OR_CLOSE,
+    CARMA_JSON_STREAM_EXPECT_END_OF_ROOT,
+    CARMA_JSON_STREAM_IN_STRING,
+    CARMA_JSON_STREAM_IN_SCALAR,
+    CARMA_JSON_STREAM_FAILED,
+} CarmaJsonStreamState;
+
+// The memory of a stream is bounded by the chunk size, the longest token that is split between chunks,
+// and the nesting depth, and does not grow with the size of the document.
+// The input is the part of the last fed chunk that is not parsed yet.
+// The token is a copy of a string or scalar that is split between chunks.
+// The stack has a bracket for each object and array that is open.
+// The chunk is the buffer that files are read into, with chunk_size bytes at a time.
+// The offset is the position of the last fed chunk in the document, and is used to report errors.
+typedef struct JsonStream {
+    StringView input;
+    StringBuilder token;
+    StringBuilder stack;
+    StringBuilder chunk;
+    size_t chunk_size;
+    const char* chunk_begin;
+    size_t offset;
+    CarmaJsonStreamState state;
+    bool is_key;
+    bool is_escaped;
+    bool is_ndjson;
+    bool is_finished;
+} JsonStream;
+
+// Newline delimited json is a sequence of root values, with one per line.
+static inline
+JsonStream carma_make_json_stream(bool is_ndjson) {
+    return MAKE(JsonStream, .chunk_size=CARMA_FILE_READ_CHUNK_SIZE, .is_ndjson=is_ndjson);
+}
+
+#define MAKE_JSON_STREAM() carma_make_json_stream(false)
+#define MAKE_NDJSON_STREAM() carma_make_json_stream(true)
+
+#define FREE_JSON_STREAM(stream) do { \
+    FREE_DARRAY((stream).token); \
+    FREE_DARRAY((stream).stack); \
+    FREE_DARRAY((stream).chunk); \
+    (stream) = carma_make_json_stream((stream).is_ndjson); \
+} while (0)
+
+// Gives the next chunk of the document to the stream.
+// All events of the previous chunk should be read before feeding the next one.
+// The chunks are ignored after an error.
+static inline
+void carma_feed_json_stream(JsonStream* stream, StringView chunk) {
+    if (stream->state == CARMA_JSON_STREAM_FAILED) {
+        return;
+    }
+    CHECK_INTERNAL(IS_EMPTY(stream->input), "Feeding a json stream before all events of the previous chunk are read");
+    CHECK_INTERNAL(!stream->is_finished, "Feeding a json stream that is finished");
+    stream->offset += (size_t)(stream->input.data - stream->chunk_begin);
+    stream->chunk_begin = chunk.data;
+    stream->input = chunk;
+}
+
+#define FEED_JSON_STREAM(stream, chunk) carma_feed_json_stream(&(stream), (chunk))
+
+// Tells the stream that no more chunks are coming, so that the last scalar can end and truncated documents fail.
+#define FINISH_JSON_STREAM(stream) do {(stream).is_finished = true;} while (0)
+
+// The position in the document of the next byte to parse, which is where the parsing failed after an error.
+#define JSON_STREAM_OFFSET(stream) ((stream).offset + (size_t)((stream).input.data - (stream).chunk_begin))
+
+////////////////////////////////////////////////////////////////////////////////
+// PARSING EVENTS
+
+static inline
+JsonEvent carma_fail_json_stream(JsonStream* stream) {
+    stream->state = CARMA_JSON_STREAM_FAILED;
+    return MAKE(JsonEvent, .type=JSON_EVENT_ERROR);
+}
+
+static inline
+JsonEvent carma_continue_json_string(JsonStream* stream) {
+    auto it = stream->input.data;
+    auto end = END_POINTER(stream->input);
+    auto quote = it;
+    if (stream->is_escaped && quote != end) {
+        ++quote;
+        stream->is_escaped = false;
+    }
+    quote = carma_find_quote_or_backslash(quote, end);
+    while (quote != end && *quote == '\\') {
+        if (end - quote < 2) {
+            stream->is_escaped = true;
+            quote = end;
+            break;
+        }
+        quote = carma_find_quote_or_backslash(quote + 2, end);
+    }
+    CONCAT(stream->token, MAKE(StringView, it, (size_t)(quote - it)));
+    if (quote == end) {
+        stream->input = MAKE(StringView, end, 0);
+        return stream->is_finished ? carma_fail_json_stream(stream) : MAKE(JsonEvent);
+    }
+    stream->input = MAKE(StringView, quote + 1, (size_t)(end - quote - 1));
+    stream->state = stream->is_key ? CARMA_JSON_STREAM_EXPECT_COLON : CARMA_JSON_STREAM_EXPECT_COMMA_OR_CLOSE;
+    auto type = stream->is_key ? JSON_EVENT_KEY : JSON_EVENT_STRING;
+    return MAKE(JsonEvent, type, MAKE(StringView, stream->token.data, stream->token.count));
+}
+
+static inline
+JsonEvent carma_continue_json_scalar(JsonStream* stream) {
+    auto it = stream->input.data;
+    auto end = END_POINTER(stream->input);
+    auto scalar_end = it;
+    for (; scalar_end != end && !carma_is_json_scalar_end(*scalar_end); ++scalar_end) {
+    }
+    CONCAT(stream->token, MAKE(StringView, it, (size_t)(scalar_end - it)));
+    stream->input = MAKE(StringView, scalar_end, (size_t)(end - scalar_end));
+    if (scalar_end == end && !stream->is_finished) {
+        return MAKE(JsonEvent);
+    }
+    stream->state = CARMA_JSON_STREAM_EXPECT_COMMA_OR_CLOSE;
+    return MAKE(JsonEvent, JSON_EVENT_SCALAR, MAKE(StringView, stream->token.data, stream->token.count));
+}
+
+// Returns the next event of the fed chunks.
+// Tokens that are split between chunks are copied and returned when the rest of them is fed.
+// Only the structure is checked, and the scalars are only split on the structural characters and whitespace.
+static inline
+JsonEvent carma_next_json_event(JsonStream* stream) {
+    for (;;) {
+        auto state = stream->state;
+        if (state == CARMA_JSON_STREAM_FAILED) {
+            return MAKE(JsonEvent);
+        }
+        if (state == CARMA_JSON_STREAM_IN_STRING) {
+            return carma_continue_json_string(stream);
+        }
+        if (state == CARMA_JSON_STREAM_IN_SCALAR) {
+            return carma_continue_json_scalar(stream);
+        }
+        if (state == CARMA_JSON_STREAM_EXPECT_COMMA_OR_CLOSE && IS_EMPTY(stream->stack)) {
+            stream->state = CARMA_JSON_STREAM_EXPECT_END_OF_ROOT;
+            return MAKE(JsonEvent, .type=JSON_EVENT_END_DOCUMENT);
+        }
+        auto it = stream->input.data;
+        auto end = END_POINTER(stream->input);
+        for (; it != end && is_whitespace(*it); ++it) {
+            if (*it == '\n' && state == CARMA_JSON_STREAM_EXPECT_END_OF_ROOT && stream->is_ndjson) {
+                state = stream->state = CARMA_JSON_STREAM_EXPECT_ROOT;
+            }
+        }
+        stream->input = MAKE(StringView, it, (size_t)(end - it));
+        if (it == end) {
+            auto is_complete = state == CARMA_JSON_STREAM_EXPECT_END_OF_ROOT ||
+                (state == CARMA_JSON_STREAM_EXPECT_ROOT && stream->is_ndjson);
+            return stream->is_finished && !is_complete ? carma_fail_json_stream(stream) : MAKE(JsonEvent);
+        }
+        auto c = *it;
+        auto is_value_expected = state == CARMA_JSON_STREAM_EXPECT_ROOT ||
+            state == CARMA_JSON_STREAM_EXPECT_VALUE || state == CARMA_JSON_STREAM_EXPECT_VALUE_OR_CLOSE;
+        auto is_key_expected = state == CARMA_JSON_STREAM_EXPECT_KEY || state == CARMA_JSON_STREAM_EXPECT_KEY_OR_CLOSE;
+        if (c == '{' || c == '[') {
+            if (!is_value_expected) {
+                return carma_fail_json_stream(stream);
+            }
+            APPEND(stream->stack, c);
+            DROP_FRONT(stream->input);
+            stream->state = c == '{' ? CARMA_JSON_STREAM_EXPECT_KEY_OR_CLOSE : CARMA_JSON_STREAM_EXPECT_VALUE_OR_CLOSE;
+            return MAKE(JsonEvent, .type=c == '{' ? JSON_EVENT_BEGIN_OBJECT : JSON_EVENT_BEGIN_ARRAY);
+        } else if (c == '}' || c == ']') {
+            auto open = c == '}' ? '{' : '[';
+            CarmaJsonStreamState close_state = c == '}' ? CARMA_JSON_STREAM_EXPECT_KEY_OR_CLOSE : CARMA_JSON_STREAM_EXPECT_VALUE_OR_CLOSE;
+            if (IS_EMPTY(stream->stack) || LAST_ITEM(stream->stack) != open ||
+                (state != CARMA_JSON_STREAM_EXPECT_COMMA_OR_CLOSE && state != close_state)) {
+                return carma_fail_json_stream(stream);
+            }
+            DROP_BACK(stream->stack);
+            DROP_FRONT(stream->input);
+            stream->state = CARMA_JSON_STREAM_EXPECT_COMMA_OR_CLOSE;
+            return MAKE(JsonEvent, .type=c == '}' ? JSON_EVENT_END_OBJECT : JSON_EVENT_END_ARRAY);
+        } else if (c == ',') {
+            if (state != CARMA_JSON_STREAM_EXPECT_COMMA_OR_CLOSE) {
+                return carma_fail_json_stream(stream);
+            }
+            DROP_FRONT(stream->input);
+            auto is_object = LAST_ITEM(stream->stack) == '{';
+            stream->state = is_object ? CARMA_JSON_STREAM_EXPECT_KEY : CARMA_JSON_STREAM_EXPECT_VALUE;
+        } else if (c == ':') {
+            if (state != CARMA_JSON_STREAM_EXPECT_COLON) {
+                return carma_fail_json_stream(stream);
+            }
+            DROP_FRONT(stream->input);
+            stream->state = CARMA_JSON_STREAM_EXPECT_VALUE;
+        } else if (c == '"') {
+            if (!is_value_expected && !is_key_expected) {
+                return carma_fail_json_stream(stream);
+            }
+            stream->is_key = is_key_expected;
+            auto remaining = stream->input;
+            auto value = parse_quoted_string(&remaining);
+            if (remaining.data != stream->input.data) {
+                stream->input = remaining;
+                stream->state = is_key_expected ? CARMA_JSON_STREAM_EXPECT_COLON : CARMA_JSON_STREAM_EXPECT_COMMA_OR_CLOSE;
+                return MAKE(JsonEvent, is_key_expected ? JSON_EVENT_KEY : JSON_EVENT_STRING, value);
+            }
+            // The string continues in the next chunk:
+            DROP_FRONT(stream->input);
+            CLEAR(stream->token);
+            stream->is_escaped = false;
+            stream->state = CARMA_JSON_STREAM_IN_STRING;
+            return carma_continue_json_string(stream);
+        } else {
+            if (!is_value_expected) {
+                return carma_fail_json_stream(stream);
+            }
+            auto scalar_end = it;
+            for (; scalar_end != end && !carma_is_json_scalar_end(*scalar_end); ++scalar_end) {
+            }
+            if (scalar_end != end) {
+                stream->input = MAKE(StringView, scalar_end, (size_t)(end - scalar_end));
+                stream->state = CARMA_JSON_STREAM_EXPECT_COMMA_OR_CLOSE;
+                return MAKE(JsonEvent, JSON_EVENT_SCALAR, MAKE(StringView, it, (size_t)(scalar_end - it)));
+            }
+            // The scalar might continue in the next chunk:
+            CLEAR(stream->token);
+            stream->state = CARMA_JSON_STREAM_IN_SCALAR;
+            return carma_continue_json_scalar(stream);
+        }
+    }
+}
+
+#define NEXT_JSON_EVENT(stream) carma_next_json_event(&(stream))
+
+// Loops over the events of the chunks that are fed so far.
+#define FOR_EACH_JSON_EVENT(event, stream) \
+    for ( \
+    JsonEvent event = carma_next_json_event(&(stream)); \
+    (event).type != JSON_EVENT_NONE; \
+    event = carma_next_json_event(&(stream)) \
+    )
+
+////////////////////////////////////////////////////////////////////////////////
+// READING FILES
+
+// Returns the next event of the file, and reads the next chunk of the file into the stream when needed.
+static inline
+JsonEvent carma_read_json_event(JsonStream* stream, FILE* file) {
+    for (;;) {
+        auto event = carma_next_json_event(stream);
+        if (event.type != JSON_EVENT_NONE || stream->is_finished || stream->state == CARMA_JSON_STREAM_FAILED) {
+            return event;
+        }
+        if (stream->chunk.capacity < stream->chunk_size) {
+            RESERVE(stream->chunk, stream->chunk_size);
+        }
+        stream->chunk.count = fread(stream->chunk.data, 1, stream->chunk.capacity, file);
+        if (stream->chunk.count == 0) {
+            FINISH_JSON_STREAM(*stream);
+        } else {
+            carma_feed_json_stream(stream, MAKE(StringView, stream->chunk.data, stream->chunk.count));
+        }
+    }
+}
+
+// Loops over the events of a FILE*, which is read in chunks of the chunk_size of the stream.
+// Use this for files that are too big to read into memory.
+#define FOR_EACH_JSON_FILE_EVENT(event, stream, file) \
+    for ( \
+    JsonEvent event = carma_read_json_event(&(stream), (file)); \
+    (event).type != JSON_EVENT_NONE; \
+    event = carma_read_json_event(&(stream), (file)) \
+    )
@@ -0,0 +1,758 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "carma_std.h"
+
+#include "carma.h"
+
+/*
+A thread pool runs loops over ranges on several threads.
+The loop body is a function that is called for each item, index or pixel,
+together with a context pointer for everything else that the function needs:
+
+void shade_pixel(size_t x, size_t y, void* context) {
+    Image* image = context;
+    image->data[y * image->width + x] = ...;
+}
+
+ThreadPool* pool = MAKE_THREAD_POOL(0);
+PARALLEL_FOR_XY(pool, image, shade_pixel, &image);
+double total = PARALLEL_SUM(pool, values);
+FREE_THREAD_POOL(pool);
+
+The items are split into chunks of grain items each, that the threads take one at a time.
+Each thread starts with its own queue of neighbouring chunks,
+and steals chunks from the back of the queues of the other threads when its own queue is empty.
+The chunks only depend on the item count and the grain, and not on the number of threads.
+A grain of 0 picks a grain that gives about CARMA_PARALLEL_CHUNK_COUNT chunks.
+
+The calling thread also works on the chunks, and the loop returns when all chunks are done.
+A pool runs one loop at a time. A parallel loop that is started from inside another loop of the same pool,
+or that is given a NULL pool, runs the same chunks on the calling thread.
+*/
+
+#define CARMA_PARALLEL_CHUNK_COUNT 1024
+
+typedef void (*CarmaParallelChunkFunction)(void* task, size_t chunk_index, size_t begin, size_t end);
+
+typedef struct CarmaParallelQueue {
+    // The chunk indices [head, tail) that are left, packed as head | tail << 32,
+    // so that taking from the front and stealing from the back are a single compare and swap.
+    _Alignas(64) _Atomic uint64_t chunks;
+} CarmaParallelQueue;
+
+struct ThreadPool;
+
+typedef struct CarmaParallelWorker {
+    struct ThreadPool* pool;
+    size_t index;
+    pthread_t thread;
+} CarmaParallelWorker;
+
+typedef struct ThreadPool {
+    // The calling thread is worker 0 and the pool starts threads for the other workers.
+    CarmaParallelWorker* workers;
+    CarmaParallelQueue* queues;
+    size_t thread_count;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_condition;
+    pthread_cond_t done_condition;
+    size_t generation;
+    size_t busy_thread_count;
+    bool is_running;
+    bool is_stopping;
+    // The loop that is running.
+    CarmaParallelChunkFunction function;
+    void* task;
+    size_t count;
+    size_t grain;
+} ThreadPool;
+
+////////////////////////////////////////////////////////////////////////////////
+// CHUNKS
+
+static inline size_t carma_parallel_grain(size_t count, size_t grain) {
+    if (grain == 0) {
+        grain = count / CARMA_PARALLEL_CHUNK_COUNT;
+    }
+    return grain ? grain : 1;
+}
+
+static inline size_t carma_parallel_chunk_count(size_t count, size_t grain) {
+    return count / grain + (count % grain != 0);
+}
+
+static inline void carma_run_parallel_chunk(
+    CarmaParallelChunkFunction function, void* task, size_t count, size_t grain, size_t chunk_index
+) {
+    size_t begin = chunk_index * grain;
+    size_t end = count - begin < grain ? count : begin + grain;
+    function(task, chunk_index, begin, end);
+}
+
+static inline bool carma_take_parallel_chunk(CarmaParallelQueue* queue, bool is_stealing, size_t* chunk_index) {
+    uint64_t chunks = atomic_load_explicit(&queue->chunks, memory_order_relaxed);
+    for (;;) {
+        uint64_t head = chunks & UINT32_MAX;
+        uint64_t tail = chunks >> 32;
+        if (head >= tail) {
+            return false;
+        }
+        uint64_t new_chunks = is_stealing ? head | (tail - 1) << 32 : (head + 1) | tail << 32;
+        if (atomic_compare_exchange_weak_explicit(
+            &queue->chunks, &chunks, new_chunks, memory_order_relaxed, memory_order_relaxed
+        )) {
+            *chunk_index = is_stealing ? tail - 1 : head;
+            return true;
+        }
+    }
+}
+
+static inline void carma_run_parallel_chunks(ThreadPool* pool, size_t worker_index) {
+    size_t chunk_index = 0;
+    for (;;) {
+        bool is_found = carma_take_parallel_chunk(&pool->queues[worker_index], false, &chunk_index);
+        for (size_t i = 1; !is_found && i < pool->thread_count; ++i) {
+            size_t victim = (worker_index + i) % pool->thread_count;
+            is_found = carma_take_parallel_chunk(&pool->queues[victim], true, &chunk_index);
+        }
+        if (!is_found) {
+            return;
+        }
+        carma_run_parallel_chunk(pool->function, pool->task, pool->count, pool->grain, chunk_index);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// THREAD POOL
+
+static inline void* carma_run_parallel_worker(void* argument) {
+    CarmaParallelWorker* worker = (CarmaParallelWorker*)argument;
+    ThreadPool* pool = worker->pool;
+    size_t generation = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->is_stopping && pool->generation == generation) {
+            pthread_cond_wait(&pool->work_condition, &pool->mutex);
+        }
+        if (pool->is_stopping) {
+            break;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+        carma_run_parallel_chunks(pool, worker->index);
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->busy_thread_count == 0) {
+            pthread_cond_signal(&pool->done_condition);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+// A thread_count of 0 uses one thread per online processor.
+// The pool uses malloc directly, since CARMA_ALLOCATOR can be a thread local allocator.
+static inline ThreadPool* make_thread_pool(size_t thread_count) {
+    if (thread_count == 0) {
+        long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = processor_count > 0 ? (size_t)processor_count : 1;
+    }
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    CHECK_INTERNAL(pool, "calloc failed");
+    pool->workers = (CarmaParallelWorker*)calloc(thread_count, sizeof(CarmaParallelWorker));
+    CHECK_INTERNAL(pool->workers, "calloc failed");
+    pool->queues = (CarmaParallelQueue*)aligned_alloc(
+        _Alignof(CarmaParallelQueue), thread_count * sizeof(CarmaParallelQueue)
+    );
+    CHECK_INTERNAL(pool->queues, "aligned_alloc failed");
+    for (size_t i = 0; i < thread_count; ++i) {
+        atomic_init(&pool->queues[i].chunks, 0);
+    }
+    pool->thread_count = thread_count;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_condition, NULL);
+    pthread_cond_init(&pool->done_condition, NULL);
+    for (size_t i = 0; i < thread_count; ++i) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        if (i > 0) {
+            int error = pthread_create(&pool->workers[i].thread, NULL, carma_run_parallel_worker, &pool->workers[i]);
+            CHECK_INTERNAL(error == 0, "pthread_create failed with %d", error);
+        }
+    }
+    return pool;
+}
+
+static inline void free_thread_pool(ThreadPool* pool) {
+    if (!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->is_stopping = true;
+    pthread_cond_broadcast(&pool->work_condition);
+    pthread_mutex_unlock(&pool->mutex);
+    for (size_t i = 1; i < pool->thread_count; ++i) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&pool->done_condition);
+    pthread_cond_destroy(&pool->work_condition);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->queues);
+    free(pool->workers);
+    free(pool);
+}
+
+#define MAKE_THREAD_POOL(thread_count) make_thread_pool(thread_count)
+
+#define FREE_THREAD_POOL(pool) do { \
+    free_thread_pool(pool); \
+    (pool) = NULL; \
+} while (0)
+
+// Calls function(task, chunk_index, begin, end) for the chunks of the items [0, count),
+// on the threads of the pool, and returns when all chunks are done.
+static inline void parallel_for_chunks(
+    ThreadPool* pool, size_t count, size_t grain, CarmaParallelChunkFunction function, void* task
+) {
+    if (count == 0) {
+        return;
+    }
+    grain = carma_parallel_grain(count, grain);
+    size_t chunk_count = carma_parallel_chunk_count(count, grain);
+    CHECK_INTERNAL(chunk_count <= UINT32_MAX, "Too many parallel chunks %zu, use a larger grain", chunk_count);
+    bool is_parallel = pool && pool->thread_count > 1 && chunk_count > 1;
+    if (is_parallel) {
+        pthread_mutex_lock(&pool->mutex);
+        is_parallel = !pool->is_running;
+        if (is_parallel) {
+            pool->is_running = true;
+            pool->function = function;
+            pool->task = task;
+            pool->count = count;
+            pool->grain = grain;
+            for (size_t i = 0; i < pool->thread_count; ++i) {
+                uint64_t head = chunk_count * i / pool->thread_count;
+                uint64_t tail = chunk_count * (i + 1) / pool->thread_count;
+                atomic_store_explicit(&pool->queues[i].chunks, head | tail << 32, memory_order_relaxed);
+            }
+            pool->busy_thread_count = pool->thread_count - 1;
+            pool->generation++;
+            pthread_cond_broadcast(&pool->work_condition);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    if (!is_parallel) {
+        for (size_t i = 0; i < chunk_count; ++i) {
+            carma_run_parallel_chunk(function, task, count, grain, i);
+        }
+        return;
+    }
+    carma_run_parallel_chunks(pool, 0);
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->busy_thread_count > 0) {
+        pthread_cond_wait(&pool->done_condition, &pool->mutex);
+    }
+    pool->is_running = false;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// PARALLEL LOOPS
+
+typedef struct CarmaParallelForEach {
+    char* data;
+    size_t item_size;
+    void (*function)(void* item, void* context);
+    void* context;
+} CarmaParallelForEach;
+
+static inline void carma_parallel_for_each_chunk(void* task, size_t chunk_index, size_t begin, size_t end) {
+    (void)chunk_index;
+    CarmaParallelForEach* for_each = (CarmaParallelForEach*)task;
+    for (size_t i = begin; i < end; ++i) {
+        for_each->function(for_each->data + i * for_each->item_size, for_each->context);
+    }
+}
+
+typedef struct CarmaParallelForIndex {
+    void (*function)(size_t index, void* context);
+    void* context;
+} CarmaParallelForIndex;
+
+static inline void carma_parallel_for_index_chunk(void* task, size_t chunk_index, size_t begin, size_t end) {
+    (void)chunk_index;
+    CarmaParallelForIndex* for_index = (CarmaParallelForIndex*)task;
+    for (size_t i = begin; i < end; ++i) {
+        for_index->function(i, for_index->context);
+    }
+}
+
+typedef struct CarmaParallelForXY {
+    size_t width;
+    void (*function)(size_t x, size_t y, void* context);
+    void* context;
+} CarmaParallelForXY;
+
+// The chunks of a 2D array are rows, so the grain is a number of rows.
+static inline void carma_parallel_for_xy_chunk(void* task, size_t chunk_index, size_t begin, size_t end) {
+    (void)chunk_index;
+    CarmaParallelForXY* for_xy = (CarmaParallelForXY*)task;
+    for (size_t y = begin; y < end; ++y) {
+        for (size_t x = 0; x < for_xy->width; ++x) {
+            for_xy->function(x, y, for_xy->context);
+        }
+    }
+}
+
+// Calls function(void* item, void* context) with a pointer to each item of the range.
+#define PARALLEL_FOR_EACH_GRAIN(pool, range, grain, function, context) do { \
+    CARMA_AUTO _parallel_range = (range); \
+    CarmaParallelForEach _parallel_task = { \
+        (char*)_parallel_range.data, sizeof(*_parallel_range.data), (function), (context) \
+    }; \
+    parallel_for_chunks((pool), (size_t)_parallel_range.count, (grain), carma_parallel_for_each_chunk, &_parallel_task); \
+} while (0)
+
+// Calls function(size_t index, void* context) for each index of the range.
+#define PARALLEL_FOR_INDEX_GRAIN(pool, range, grain, function, context) do { \
+    CarmaParallelForIndex _parallel_task = {(function), (context)}; \
+    parallel_for_chunks((pool), (size_t)(range).count, (grain), carma_parallel_for_index_chunk, &_parallel_task); \
+} while (0)
+
+// Calls function(size_t x, size_t y, void* context) for each position of the 2D array.
+#define PARALLEL_FOR_XY_GRAIN(pool, array, grain, function, context) do { \
+    CarmaParallelForXY _parallel_task = {(size_t)(array).width, (function), (context)}; \
+    parallel_for_chunks((pool), (size_t)(array).height, (grain), carma_parallel_for_xy_chunk, &_parallel_task); \
+} while (0)
+
+#define PARALLEL_FOR_EACH(pool, range, function, context) \
+    PARALLEL_FOR_EACH_GRAIN(pool, range, 0, function, context)
+
+#define PARALLEL_FOR_INDEX(pool, range, function, context) \
+    PARALLEL_FOR_INDEX_GRAIN(pool, range, 0, function, context)
+
+#define PARALLEL_FOR_XY(pool, array, function, context) \
+    PARALLEL_FOR_XY_GRAIN(pool, array, 0, function, context)
+
+////////////////////////////////////////////////////////////////////////////////
+// PARALLEL REDUCTIONS
+
+// Reduces count items into the accumulator, that already has a value.
+typedef void (*CarmaReduceFunction)(void* accumulator, const void* items, size_t count, void* context);
+
+// The partial result of each chunk gets its own cache line,
+// so that threads do not write to the same cache line while they reduce their chunks.
+#define CARMA_PARALLEL_PARTIAL_ALIGNMENT 64
+
+// A small grain over many items would need a partial result for each of its many chunks.
+// Above this many chunks, neighbouring chunks are reduced in blocks that only depend on the chunk count,
+// so that the partial results take at most this many cache lines.
+#define CARMA_PARALLEL_MAX_PARTIAL_COUNT 4096
+
+typedef struct CarmaParallelReduction {
+    const char* data;
+    size_t item_size;
+    size_t grain;
+    char* partials;
+    size_t partial_size;
+    const void* init;
+    CarmaReduceFunction reduce;
+    void* context;
+} CarmaParallelReduction;
+
+// Reduces the chunks of a block in order, each from the init value, into the partial result of the block.
+static inline void carma_parallel_reduce_block(void* task, size_t block_index, size_t begin, size_t end) {
+    CarmaParallelReduction* reduction = (CarmaParallelReduction*)task;
+    char* partial = reduction->partials + block_index * reduction->partial_size;
+    char chunk_partial[CARMA_PARALLEL_PARTIAL_ALIGNMENT];
+    memcpy(partial, reduction->init, reduction->item_size);
+    size_t chunk_end = end - begin < reduction->grain ? end : begin + reduction->grain;
+    reduction->reduce(partial, reduction->data + begin * reduction->item_size, chunk_end - begin, reduction->context);
+    for (begin = chunk_end; begin < end; begin = chunk_end) {
+        chunk_end = end - begin < reduction->grain ? end : begin + reduction->grain;
+        memcpy(chunk_partial, reduction->init, reduction->item_size);
+        reduction->reduce(
+            chunk_partial, reduction->data + begin * reduction->item_size, chunk_end - begin, reduction->context
+        );
+        reduction->reduce(partial, chunk_partial, 1, reduction->context);
+    }
+}
+
+// Reduces the items into the result, that has the init value of the reduction.
+// Each chunk is reduced into a partial result that starts from the init value,
+// and then the partial results are reduced into the result in the order of the chunks.
+// With more than CARMA_PARALLEL_MAX_PARTIAL_COUNT chunks, the partial results of the chunks
+// are first reduced in blocks of neighbouring chunks.
+// So the result only depends on the items and the grain, and not on the threads,
+// also for floating point numbers.
+static inline void parallel_reduce(
+    ThreadPool* pool, const void* data, size_t count, size_t item_size, size_t grain,
+    CarmaReduceFunction reduce, void* context, void* result
+) {
+    if (count == 0) {
+        return;
+    }
+    CHECK_INTERNAL(item_size <= CARMA_PARALLEL_PARTIAL_ALIGNMENT, "Too large item size %zu for a reduction", item_size);
+    grain = carma_parallel_grain(count, grain);
+    size_t chunk_count = carma_parallel_chunk_count(count, grain);
+    size_t chunks_per_block = carma_parallel_chunk_count(chunk_count, CARMA_PARALLEL_MAX_PARTIAL_COUNT);
+    size_t block_grain = count / chunks_per_block < grain ? count : grain * chunks_per_block;
+    size_t block_count = carma_parallel_chunk_count(count, block_grain);
+    char init[CARMA_PARALLEL_PARTIAL_ALIGNMENT];
+    memcpy(init, result, item_size);
+    CarmaParallelReduction reduction = {
+        (const char*)data, item_size, grain, NULL, CARMA_PARALLEL_PARTIAL_ALIGNMENT, init, reduce, context
+    };
+    // The buffer comes from CARMA_ALLOCATOR like the buffer of parallel_sort,
+    // with room to align the partial results to cache lines.
+    size_t buffer_size = block_count * reduction.partial_size + CARMA_PARALLEL_PARTIAL_ALIGNMENT - 1;
+    char* buffer = (char*)carma_byte_malloc(buffer_size);
+    size_t misalignment = (uintptr_t)buffer % CARMA_PARALLEL_PARTIAL_ALIGNMENT;
+    reduction.partials = buffer + (misalignment ? CARMA_PARALLEL_PARTIAL_ALIGNMENT - misalignment : 0);
+    parallel_for_chunks(pool, count, block_grain, carma_parallel_reduce_block, &reduction);
+    for (size_t i = 0; i < block_count; ++i) {
+        reduce(result, reduction.partials + i * reduction.partial_size, 1, context);
+    }
+    carma_free(CARMA_ALLOCATOR, buffer, buffer_size);
+}
+
+#define CARMA_DEFINE_PARALLEL_REDUCTIONS(type, name) \
+    static inline void carma_parallel_sum_##name(void* accumulator, const void* items, size_t count, void* context) { \
+        (void)context; \
+        struct {const type* data; size_t count;} range = {(const type*)items, count}; \
+        REDUCE_LANES(sum, range, (type)0, CARMA_ADD); \
+        *(type*)accumulator += sum; \
+    } \
+    static inline void carma_parallel_min_##name(void* accumulator, const void* items, size_t count, void* context) { \
+        (void)context; \
+        struct {const type* data; size_t count;} range = {(const type*)items, count}; \
+        REDUCE_LANES(min, range, *(type*)accumulator, CARMA_MIN); \
+        *(type*)accumulator = min; \
+    } \
+    static inline void carma_parallel_max_##name(void* accumulator, const void* items, size_t count, void* context) { \
+        (void)context; \
+        struct {const type* data; size_t count;} range = {(const type*)items, count}; \
+        REDUCE_LANES(max, range, *(type*)accumulator, CARMA_MAX); \
+        *(type*)accumulator = max; \
+    }
+
+CARMA_DEFINE_PARALLEL_REDUCTIONS(int8_t, int8)
+CARMA_DEFINE_PARALLEL_REDUCTIONS(uint8_t, uint8)
+CARMA_DEFINE_PARALLEL_REDUCTIONS(int16_t, int16)
+CARMA_DEFINE_PARALLEL_REDUCTIONS(uint16_t, uint16)
+CARMA_DEFINE_PARALLEL_REDUCTIONS(int32_t, int32)
+CARMA_DEFINE_PARALLEL_REDUCTIONS(uint32_t, uint32)
+CARMA_DEFINE_PARALLEL_REDUCTIONS(int64_t, int64)
+CARMA_DEFINE_PARALLEL_REDUCTIONS(uint64_t, uint64)
+CARMA_DEFINE_PARALLEL_REDUCTIONS(float, float)
+CARMA_DEFINE_PARALLEL_REDUCTIONS(double, double)
+
+typedef enum CarmaReduceOperation {
+    CARMA_REDUCE_SUM,
+    CARMA_REDUCE_MIN,
+    CARMA_REDUCE_MAX,
+} CarmaReduceOperation;
+
+// Picks the reduce function from the size and kind of the item type, without _Generic which is not in C++.
+static inline CarmaReduceFunction carma_parallel_reduce_function(
+    CarmaReduceOperation operation, size_t item_size, bool is_floating_point, bool is_signed
+) {
+    static const CarmaReduceFunction functions[][3] = {
+        {carma_parallel_sum_int8, carma_parallel_min_int8, carma_parallel_max_int8},
+        {carma_parallel_sum_uint8, carma_parallel_min_uint8, carma_parallel_max_uint8},
+        {carma_parallel_sum_int16, carma_parallel_min_int16, carma_parallel_max_int16},
+        {carma_parallel_sum_uint16, carma_parallel_min_uint16, carma_parallel_max_uint16},
+        {carma_parallel_sum_int32, carma_parallel_min_int32, carma_parallel_max_int32},
+        {carma_parallel_sum_uint32, carma_parallel_min_uint32, carma_parallel_max_uint32},
+        {carma_parallel_sum_int64, carma_parallel_min_int64, carma_parallel_max_int64},
+        {carma_parallel_sum_uint64, carma_parallel_min_uint64, carma_parallel_max_uint64},
+        {carma_parallel_sum_float, carma_parallel_min_float, carma_parallel_max_float},
+        {carma_parallel_sum_double, carma_parallel_min_double, carma_parallel_max_double},
+    };
+    size_t type_index = 0;
+    if (is_floating_point) {
+        CHECK_INTERNAL(item_size == sizeof(float) || item_size == sizeof(double),
+            "Unsupported floating point size %zu for a parallel reduction", item_size);
+        type_index = item_size == sizeof(float) ? 8 : 9;
+    } else {
+        CHECK_INTERNAL(item_size == 1 || item_size == 2 || item_size == 4 || item_size == 8,
+            "Unsupported integer size %zu for a parallel reduction", item_size);
+        size_t size_index = item_size == 1 ? 0 : item_size == 2 ? 1 : item_size == 4 ? 2 : 3;
+        type_index = 2 * size_index + !is_signed;
+    }
+    return functions[type_index][operation];
+}
+
+// The result of min and max starts at the first item, which is fine since they ignore repeated items.
+static inline void* carma_parallel_reduce_numbers(
+    ThreadPool* pool, const void* data, size_t count, size_t item_size, size_t grain,
+    CarmaReduceOperation operation, bool is_floating_point, bool is_signed, void* result
+) {
+    if (operation != CARMA_REDUCE_SUM) {
+        CHECK_INTERNAL(count > 0, "Parallel min or max of an empty range");
+        memcpy(result, data, item_size);
+    }
+    CarmaReduceFunction reduce = carma_parallel_reduce_function(operation, item_size, is_floating_point, is_signed);
+    parallel_reduce(pool, data, count, item_size, grain, reduce, NULL, result);
+    return result;
+}
+
+// The result is written to a compound literal of the item type, so that the macros are expressions.
+#define CARMA_PARALLEL_REDUCE_NUMBERS(pool, range, grain, operation) \
+    (*(VALUE_TYPE(range)*)carma_parallel_reduce_numbers( \
+        (pool), (range).data, (size_t)(range).count, sizeof(*(range).data), (grain), (operation), \
+        CARMA_IS_FLOATING_POINT(*(range).data), CARMA_IS_SIGNED(*(range).data), &(VALUE_TYPE(range)){0} \
+    ))
+
+// The sum has the type of the items.
+#define PARALLEL_SUM_GRAIN(pool, range, grain) CARMA_PARALLEL_REDUCE_NUMBERS(pool, range, grain, CARMA_REDUCE_SUM)
+// The min and max assume that the range is not empty.
+#define PARALLEL_MIN_GRAIN(pool, range, grain) CARMA_PARALLEL_REDUCE_NUMBERS(pool, range, grain, CARMA_REDUCE_MIN)
+#define PARALLEL_MAX_GRAIN(pool, range, grain) CARMA_PARALLEL_REDUCE_NUMBERS(pool, range, grain, CARMA_REDUCE_MAX)
+
+#define PARALLEL_SUM(pool, range) PARALLEL_SUM_GRAIN(pool, range, 0)
+#define PARALLEL_MIN(pool, range) PARALLEL_MIN_GRAIN(pool, range, 0)
+#define PARALLEL_MAX(pool, range) PARALLEL_MAX_GRAIN(pool, range, 0)
+
+typedef struct CarmaParallelReduceItems {
+    void (*op)(void* accumulator, const void* item);
+    size_t item_size;
+} CarmaParallelReduceItems;
+
+static inline void carma_parallel_reduce_with_op(void* accumulator, const void* items, size_t count, void* context) {
+    CarmaParallelReduceItems* reduce_items = (CarmaParallelReduceItems*)context;
+    for (size_t i = 0; i < count; ++i) {
+        reduce_items->op(accumulator, (const char*)items + i * reduce_items->item_size);
+    }
+}
+
+static inline void* carma_parallel_reduce_items(
+    ThreadPool* pool, const void* data, size_t count, size_t item_size, size_t grain,
+    void (*op)(void* accumulator, const void* item), void* result
+) {
+    CarmaParallelReduceItems reduce_items = {op, item_size};
+    parallel_reduce(pool, data, count, item_size, grain, carma_parallel_reduce_with_op, &reduce_items, result);
+    return result;
+}
+
+// Calls op(void* accumulator, const void* item) to reduce each item into the accumulator.
+// The accumulator has the type of the items. The op is also used to reduce the partial results of the chunks,
+// so it should be associative and init should not change the result, like 0 for a sum.
+#define PARALLEL_REDUCE_GRAIN(pool, range, grain, init, op) \
+    (*(VALUE_TYPE(range)*)carma_parallel_reduce_items( \
+        (pool), (range).data, (size_t)(range).count, sizeof(*(range).data), (grain), (op), &(VALUE_TYPE(range)){init} \
+    ))
+
+#define PARALLEL_REDUCE(pool, range, init, op) PARALLEL_REDUCE_GRAIN(pool, range, 0, init, op)
+
+////////////////////////////////////////////////////////////////////////////////
+// PARALLEL SORT
+
+// The functions of a parallel sort for one item type and order.
+typedef struct CarmaSortFunctions {
+    size_t item_size;
+    // Sorts the items in place.
+    void (*sort)(void* items, size_t count);
+    // Merges the sorted items a and b into target, taking the item of a when the items are equal.
+    void (*merge)(const void* a, size_t a_count, const void* b, size_t b_count, void* target);
+    // Returns how many of the first diagonal items of the merge of a and b come from a.
+    size_t (*split)(const void* a, size_t a_count, const void* b, size_t b_count, size_t diagonal);
+} CarmaSortFunctions;
+
+// The default grain gives about this many runs, that are sorted on their own and then merged.
+#define CARMA_PARALLEL_SORT_RUN_COUNT 64
+// Ranges of at most this many items are sorted on the calling thread.
+#define CARMA_PARALLEL_SORT_MIN_GRAIN 16384
+
+typedef struct CarmaParallelSort {
+    const CarmaSortFunctions* functions;
+    char* data;
+    char* buffer;
+    size_t count;
+    // The number of items of the sorted runs that are merged pairwise.
+    size_t run_count;
+    bool is_copying_runs;
+    char* source;
+    char* target;
+} CarmaParallelSort;
+
+static inline void carma_parallel_sort_run(void* task, size_t chunk_index, size_t begin, size_t end) {
+    (void)chunk_index;
+    CarmaParallelSort* sort = (CarmaParallelSort*)task;
+    size_t item_size = sort->functions->item_size;
+    sort->functions->sort(sort->data + begin * item_size, end - begin);
+    if (sort->is_copying_runs) {
+        memcpy(sort->buffer + begin * item_size, sort->data + begin * item_size, (end - begin) * item_size);
+    }
+}
+
+// Writes the merged items [begin, end) of the pairs of runs.
+// The chunk can span several pairs, and each pair can be split over several chunks,
+// so each chunk finds where its part of each pair starts and ends in the two runs.
+static inline void carma_parallel_merge_chunk(void* task, size_t chunk_index, size_t begin, size_t end) {
+    (void)chunk_index;
+    CarmaParallelSort* sort = (CarmaParallelSort*)task;
+    const CarmaSortFunctions* functions = sort->functions;
+    size_t item_size = functions->item_size;
+    size_t pair_count = 2 * sort->run_count;
+    while (begin < end) {
+        size_t pair_begin = begin - begin % pair_count;
+        size_t pair_end = sort->count - pair_begin < pair_count ? sort->count : pair_begin + pair_count;
+        size_t chunk_end = end < pair_end ? end : pair_end;
+        const char* a = sort->source + pair_begin * item_size;
+        size_t a_count = carma_min_count(sort->run_count, pair_end - pair_begin);
+        const char* b = a + a_count * item_size;
+        size_t b_count = pair_end - pair_begin - a_count;
+        size_t diagonal0 = begin - pair_begin;
+        size_t diagonal1 = chunk_end - pair_begin;
+        size_t a0 = functions->split(a, a_count, b, b_count, diagonal0);
+        size_t a1 = functions->split(a, a_count, b, b_count, diagonal1);
+        size_t b0 = diagonal0 - a0;
+        size_t b1 = diagonal1 - a1;
+        functions->merge(
+            a + a0 * item_size, a1 - a0, b + b0 * item_size, b1 - b0, sort->target + begin * item_size
+        );
+        begin = chunk_end;
+    }
+}
+
+// Sorts the items in runs of grain items, on the threads of the pool,
+// and then merges pairs of runs until there is one run.
+// Each round of merges is split into chunks of grain items of the merged result,
+// so all threads merge also when there are fewer pairs than threads.
+// The runs only depend on the count and the grain, so the result does not depend on the threads,
+// also for items that are equal but not the same.
+static inline void parallel_sort(
+    ThreadPool* pool, void* data, size_t count, size_t grain, const CarmaSortFunctions* functions
+) {
+    if (grain == 0) {
+        grain = count / CARMA_PARALLEL_SORT_RUN_COUNT;
+        grain = grain < CARMA_PARALLEL_SORT_MIN_GRAIN ? CARMA_PARALLEL_SORT_MIN_GRAIN : grain;
+    }
+    if (count <= grain) {
+        functions->sort(data, count);
+        return;
+    }
+    size_t round_count = 0;
+    for (size_t run_count = grain; run_count < count; run_count *= 2) {
+        round_count++;
+    }
+    CarmaParallelSort sort = {functions, (char*)data, NULL, count, grain, round_count % 2 == 1, NULL, NULL};
+    sort.buffer = (char*)carma_byte_malloc(count * functions->item_size);
+    // With an odd number of rounds the sorted runs are copied to the buffer, so that the last round writes to the data.
+    parallel_for_chunks(pool, count, grain, carma_parallel_sort_run, &sort);
+    sort.source = sort.is_copying_runs ? sort.buffer : sort.data;
+    sort.target = sort.is_copying_runs ? sort.data : sort.buffer;
+    for (; sort.run_count < count; sort.run_count *= 2) {
+        parallel_for_chunks(pool, count, grain, carma_parallel_merge_chunk, &sort);
+        char* source = sort.source;
+        sort.source = sort.target;
+        sort.target = source;
+    }
+    carma_free(CARMA_ALLOCATOR, sort.buffer, count * functions->item_size);
+}
+
+// Defines the functions of a parallel sort for items of the given type,
+// that calls compare(argument, a, b) to tell if the item a should come before the item b.
+#define CARMA_DEFINE_SORT_FUNCTIONS(name, type, compare, argument) \
+    static inline void carma_sort_##name(void* items, size_t count) { \
+        struct {type* data; size_t count;} range = {(type*)items, count}; \
+        CARMA_SORT_WITH(range, compare, argument); \
+    } \
+    static inline void carma_merge_##name(const void* a, size_t a_count, const void* b, size_t b_count, void* target) { \
+        const type* a_items = (const type*)a; \
+        const type* b_items = (const type*)b; \
+        type* target_items = (type*)target; \
+        size_t i = 0; \
+        size_t j = 0; \
+        while (i < a_count && j < b_count) { \
+            bool is_b = compare(argument, b_items[j], a_items[i]); \
+            *target_items++ = *(is_b ? b_items + j : a_items + i); \
+            j += is_b; \
+            i += !is_b; \
+        } \
+        while (i < a_count) { \
+            *target_items++ = a_items[i++]; \
+        } \
+        while (j < b_count) { \
+            *target_items++ = b_items[j++]; \
+        } \
+    } \
+    static inline size_t carma_split_##name(const void* a, size_t a_count, const void* b, size_t b_count, size_t diagonal) { \
+        const type* a_items = (const type*)a; \
+        const type* b_items = (const type*)b; \
+        size_t low = diagonal > b_count ? diagonal - b_count : 0; \
+        size_t high = diagonal < a_count ? diagonal : a_count; \
+        while (low < high) { \
+            size_t middle = low + (high - low) / 2; \
+            if (compare(argument, b_items[diagonal - middle - 1], a_items[middle])) { \
+                high = middle; \
+            } else { \
+                low = middle + 1; \
+            } \
+        } \
+        return low; \
+    } \
+    static const CarmaSortFunctions carma_sort_functions_##name = { \
+        sizeof(type), carma_sort_##name, carma_merge_##name, carma_split_##name \
+    };
+
+// Defines a function name(ThreadPool* pool, type* data, size_t count),
+// that sorts the items like SORT(range, less) on the threads of the pool.
+#define DEFINE_PARALLEL_SORT(name, type, less) \
+    CARMA_DEFINE_SORT_FUNCTIONS(name, type, CARMA_SORT_CALL_LESS, less) \
+    static inline void name(ThreadPool* pool, type* data, size_t count) { \
+        parallel_sort(pool, data, count, 0, &carma_sort_functions_##name); \
+    }
+
+// Defines a function name(ThreadPool* pool, type* data, size_t count),
+// that sorts the items like SORT_BY_KEY(range, key) on the threads of the pool.
+#define DEFINE_PARALLEL_SORT_BY_KEY(name, type, key) \
+    CARMA_DEFINE_SORT_FUNCTIONS(name, type, CARMA_SORT_CALL_KEY, key) \
+    static inline void name(ThreadPool* pool, type* data, size_t count) { \
+        parallel_sort(pool, data, count, 0, &carma_sort_functions_##name); \
+    }
+
+CARMA_DEFINE_SORT_FUNCTIONS(int8, int8_t, CARMA_SORT_CALL_LESS, CARMA_LESS)
+CARMA_DEFINE_SORT_FUNCTIONS(uint8, uint8_t, CARMA_SORT_CALL_LESS, CARMA_LESS)
+CARMA_DEFINE_SORT_FUNCTIONS(int16, int16_t, CARMA_SORT_CALL_LESS, CARMA_LESS)
+CARMA_DEFINE_SORT_FUNCTIONS(uint16, uint16_t, CARMA_SORT_CALL_LESS, CARMA_LESS)
+CARMA_DEFINE_SORT_FUNCTIONS(int32, int32_t, CARMA_SORT_CALL_LESS, CARMA_LESS)
+CARMA_DEFINE_SORT_FUNCTIONS(uint32, uint32_t, CARMA_SORT_CALL_LESS, CARMA_LESS)
+CARMA_DEFINE_SORT_FUNCTIONS(int64, int64_t, CARMA_SORT_CALL_LESS, CARMA_LESS)
+CARMA_DEFINE_SORT_FUNCTIONS(uint64, uint64_t, CARMA_SORT_CALL_LESS, CARMA_LESS)
+CARMA_DEFINE_SORT_FUNCTIONS(float, float, CARMA_SORT_CALL_LESS, CARMA_LESS)
+CARMA_DEFINE_SORT_FUNCTIONS(double, double, CARMA_SORT_CALL_LESS, CARMA_LESS)
+
+// Picks the sort functions from the size and kind of the item type, like carma_parallel_reduce_function.
+static inline const CarmaSortFunctions* carma_parallel_sort_functions(
+    size_t item_size, bool is_floating_point, bool is_signed
+) {
+    static const CarmaSortFunctions* functions[] = {
+        &carma_sort_functions_int8, &carma_sort_functions_uint8,
+        &carma_sort_functions_int16, &carma_sort_functions_uint16,
+        &carma_sort_functions_int32, &carma_sort_functions_uint32,
+        &carma_sort_functions_int64, &carma_sort_functions_uint64,
+        &carma_sort_functions_float, &carma_sort_functions_double,
+    };
+    if (is_floating_point) {
+        CHECK_INTERNAL(item_size == sizeof(float) || item_size == sizeof(double),
+            "Unsupported floating point size %zu for a parallel sort", item_size);
+        return functions[item_size == sizeof(float) ? 8 : 9];
+    }
+    CHECK_INTERNAL(item_size == 1 || item_size == 2 || item_size == 4 || item_size == 8,
+        "Unsupported integer size %zu for a parallel sort", item_size);
+    size_t size_index = item_size == 1 ? 0 : item_size == 2 ? 1 : item_size == 4 ? 2 : 3;
+    return functions[2 * size_index + !is_signed];
+}
+
+// Sorts a range of integers or floating point numbers in increasing order, on the threads of the pool.
+#define PARALLEL_SORT_GRAIN(pool, range, grain) \
+    parallel_sort((pool), (range).data, (size_t)(range).count, (grain), carma_parallel_sort_functions( \
+        sizeof(*(range).data), CARMA_IS_FLOATING_POINT(*(range).data), CARMA_IS_SIGNED(*(range).data) \
+    ))
+
+#define PARALLEL_SORT(pool, range) PARALLEL_SORT_GRAIN(pool, range, 0)
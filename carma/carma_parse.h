@@ -2,6 +2,8 @@
 
 #include "carma_std.h"
 
+#include <float.h>
+
 #include "carma.h"
 #include "carma_error.h"
 #include "carma_make.h"
@@ -33,6 +35,21 @@ typedef struct ParsedU64 {
     bool ok;
 } ParsedU64;
 
+typedef struct ParsedI32 {
+    int32_t value;
+    bool ok;
+} ParsedI32;
+
+typedef struct ParsedI64 {
+    int64_t value;
+    bool ok;
+} ParsedI64;
+
+typedef struct ParsedU32 {
+    uint32_t value;
+    bool ok;
+} ParsedU32;
+
 typedef struct ParsedDouble {
     double value;
     bool ok;
@@ -43,6 +60,11 @@ bool is_digit(char c) {
     return '0' <= c && c <= '9';
 }
 
+static inline
+bool is_hex_digit(char c) {
+    return is_digit(c) || ('a' <= c && c <= 'f') || ('A' <= c && c <= 'F');
+}
+
 static inline
 bool is_whitespace(char c) {
     return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
@@ -59,34 +81,165 @@ ParsedChar try_parse_char(StringView* s) {
     return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// PARSE INTEGERS
+// Integers are parsed 8 digits at a time while possible,
+// by treating the 8 characters as a single 64 bit integer (SWAR).
+// The parsing fails without consuming anything if the value does not fit in the type.
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CARMA_HAS_SWAR_DIGITS 1
+#else
+#define CARMA_HAS_SWAR_DIGITS 0
+#endif
+
+static inline
+uint64_t carma_load_u64(const char* data) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+// Returns a word with a non-zero byte for each character that is not a digit.
 static inline
-ParsedU64 try_parse_u64(StringView* s) {
+uint64_t carma_find_non_digits(uint64_t word) {
+    // A byte is a digit if its high nibble is 3, and adding 6 to it does not carry into the high nibble:
+    return ((word & 0xF0F0F0F0F0F0F0F0ull) | (((word + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ^
+        0x3333333333333333ull;
+}
+
+static inline
+int carma_count_trailing_zeros(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int count = 0;
+    for (; !(x & 1); x >>= 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+// Combines neighbouring digits pairwise: 1 digit -> 2 digits -> 4 digits -> 8 digits.
+static inline
+uint32_t carma_parse_eight_digits(uint64_t word) {
+    word = ((word & 0x0F0F0F0F0F0F0F0Full) * 2561) >> 8;
+    word = ((word & 0x00FF00FF00FF00FFull) * 6553601) >> 16;
+    return (uint32_t)(((word & 0x0000FFFF0000FFFFull) * 42949672960001ull) >> 32);
+}
+
+// Parses the digits at the front of s, if there is at least one and the value is at most max_value.
+// Numbers with fewer than 8 digits are parsed one digit at a time.
+// The branch predictor guesses where such a loop ends, so the next number can start
+// before the digits are counted, which is faster than waiting for the count of an 8 digit load.
+// Longer numbers are parsed 8 digits at a time.
+static inline
+ParsedU64 carma_try_parse_digits(StringView* s, uint64_t max_value) {
     auto result = MAKE(ParsedU64);
-    while (!IS_EMPTY(*s) && is_digit(FIRST_ITEM(*s))) {
-        result.value *= 10;
-        result.value += FIRST_ITEM(*s) - '0';
-        DROP_FRONT(*s);
-        result.ok = true;
+    auto begin = s->data;
+    auto it = begin;
+    auto end = END_POINTER(*s);
+    uint64_t value = 0;
+    // Fewer than 8 digits always fit in 64 bits:
+    if (s->count >= 8 && carma_find_non_digits(carma_load_u64(begin))) {
+        // There is a non-digit among the first 8 characters, so the loop does not need to check for the end:
+        for (; is_digit(*it); ++it) {
+            value = 10 * value + (uint64_t)(*it - '0');
+        }
+    } else if (s->count < 8) {
+        for (; it != end && is_digit(*it); ++it) {
+            value = 10 * value + (uint64_t)(*it - '0');
+        }
+    } else {
+#if CARMA_HAS_SWAR_DIGITS
+        static const uint32_t powers_of_ten[8] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000};
+        while (end - it >= 8 && it - begin <= 8) {
+            auto word = carma_load_u64(it);
+            auto non_digits = carma_find_non_digits(word);
+            if (non_digits) {
+                // Shift out the bytes after the digits, which leaves zero bytes as leading zeros:
+                auto digit_count = carma_count_trailing_zeros(non_digits) / 8;
+                value = powers_of_ten[digit_count] * value + carma_parse_eight_digits(word << (63 - 8 * digit_count) << 1);
+                it += digit_count;
+                end = it; // Skip the scalar loops below.
+                break;
+            }
+            value = 100000000 * value + carma_parse_eight_digits(word);
+            it += 8;
+        }
+#endif
+        // 19 digits always fit in 64 bits, so only check for overflow after that:
+        auto unchecked_end = (size_t)(end - begin) > 19 ? begin + 19 : end;
+        for (; it < unchecked_end && is_digit(*it); ++it) {
+            value = 10 * value + (uint64_t)(*it - '0');
+        }
+        for (; it != end && is_digit(*it); ++it) {
+            uint64_t digit = (uint64_t)(*it - '0');
+            if (value > (UINT64_MAX - digit) / 10) {
+                return result;
+            }
+            value = 10 * value + digit;
+        }
+    }
+    if (it == begin || value > max_value) {
+        return result;
     }
+    result.value = value;
+    result.ok = true;
+    s->count -= (size_t)(it - begin);
+    s->data = it;
     return result;
 }
 
+// Parses an optional minus sign and the digits,
+// if the value is in the range [-max_value - 1, max_value].
 static inline
-ParsedInt try_parse_int(StringView* s) {
-    auto sign = +1;
-    if (STARTS_WITH_ITEM(*s, '-')) {
-        sign = -1;
-        DROP_FRONT(*s);
+ParsedI64 carma_try_parse_signed(StringView* s, uint64_t max_value) {
+    auto result = MAKE(ParsedI64);
+    auto remaining = *s;
+    auto negative = STARTS_WITH_ITEM(remaining, '-');
+    if (negative) {
+        DROP_FRONT(remaining);
     }
-    auto abs_value = try_parse_u64(s);
-    auto result = MAKE(ParsedInt);
-    if (abs_value.ok) {
-        result.value = sign * (int)abs_value.value;
+    auto magnitude = carma_try_parse_digits(&remaining, negative ? max_value + 1 : max_value);
+    if (magnitude.ok) {
+        // Negate without overflowing for the most negative value:
+        result.value = negative ? -(int64_t)(magnitude.value - 1) - 1 : (int64_t)magnitude.value;
         result.ok = true;
+        *s = remaining;
     }
     return result;
 }
 
+static inline
+ParsedU64 try_parse_u64(StringView* s) {
+    return carma_try_parse_digits(s, UINT64_MAX);
+}
+
+static inline
+ParsedU32 try_parse_u32(StringView* s) {
+    auto parsed = carma_try_parse_digits(s, UINT32_MAX);
+    return (ParsedU32){(uint32_t)parsed.value, parsed.ok};
+}
+
+static inline
+ParsedI64 try_parse_i64(StringView* s) {
+    return carma_try_parse_signed(s, INT64_MAX);
+}
+
+static inline
+ParsedI32 try_parse_i32(StringView* s) {
+    auto parsed = carma_try_parse_signed(s, INT32_MAX);
+    return (ParsedI32){(int32_t)parsed.value, parsed.ok};
+}
+
+static inline
+ParsedInt try_parse_int(StringView* s) {
+    auto parsed = carma_try_parse_signed(s, INT_MAX);
+    return (ParsedInt){(int)parsed.value, parsed.ok};
+}
+
 static inline
 StringView parse_int_as_string(StringView* s) {
     auto input_data = s->data;
@@ -106,70 +259,265 @@ StringView parse_int_as_string(StringView* s) {
     return MAKE(StringView, .data=input_data, .count=input_count - s->count);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// PARSE DOUBLE
+// Decimal numbers are converted to the closest double with the algorithm of Eisel and Lemire.
+// Numbers that are exactly representable use a faster path,
+// and numbers with more than 19 significant digits that cannot be rounded fall back to strtod.
+
+static inline
+double carma_make_double(uint64_t mantissa, int64_t exponent, bool negative) {
+    uint64_t bits = mantissa | ((uint64_t)exponent << 52) | ((uint64_t)negative << 63);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Returns the double closest to w * 10^q.
+static inline
+double carma_decimal_to_double(uint64_t w, int64_t q, bool negative) {
+    if (w == 0 || q < CARMA_SMALLEST_POWER_OF_FIVE) {
+        return carma_make_double(0, 0, negative);
+    }
+    if (q > CARMA_LARGEST_POWER_OF_FIVE) {
+        return carma_make_double(0, 0x7FF, negative);
+    }
+    int leading_zeros = carma_count_leading_zeros(w);
+    w <<= leading_zeros;
+    size_t index = 2 * (size_t)(q - CARMA_SMALLEST_POWER_OF_FIVE);
+    uint64_t low;
+    uint64_t high = carma_multiply_u64(w, carma_powers_of_five[index], &low);
+    // Only use the low word of the power of five if the high word is not precise enough:
+    if ((high & 0x1FF) == 0x1FF) {
+        uint64_t second_low;
+        uint64_t second_high = carma_multiply_u64(w, carma_powers_of_five[index + 1], &second_low);
+        low += second_high;
+        if (second_high > low) {
+            high++;
+        }
+    }
+    int upper_bit = (int)(high >> 63);
+    int shift = upper_bit + 9;
+    uint64_t mantissa = high >> shift;
+    // The binary exponent is log2(10^q) = q * 217706 / 2^16, biased by 1023.
+    int64_t exponent = ((217706 * q) >> 16) + 63 + upper_bit - leading_zeros + 1023;
+    if (exponent <= 0) {
+        // Subnormal number:
+        if (-exponent + 1 >= 64) {
+            return carma_make_double(0, 0, negative);
+        }
+        mantissa >>= -exponent + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        exponent = mantissa < (1ull << 52) ? 0 : 1;
+        return carma_make_double(mantissa, exponent, negative);
+    }
+    // Round to even when the number is exactly half way between two doubles:
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == high) {
+        mantissa &= ~1ull;
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (2ull << 52)) {
+        mantissa = 1ull << 52;
+        exponent++;
+    }
+    mantissa &= ~(1ull << 52);
+    if (exponent >= 0x7FF) {
+        return carma_make_double(0, 0x7FF, negative);
+    }
+    return carma_make_double(mantissa, exponent, negative);
+}
+
+// Rebuilds the number as digits and an exponent without a decimal point,
+// so that strtod does not depend on the locale.
+// Digits after the first 780 can only matter as a tie breaker, so they are replaced by a single 1.
+static inline
+double carma_parse_double_with_strtod(const char* begin, const char* end, bool negative, int64_t exponent) {
+    char buffer[820];
+    size_t count = 0;
+    if (negative) {
+        buffer[count++] = '-';
+    }
+    bool is_fraction = false;
+    bool is_truncated = false;
+    bool is_significant = false;
+    for (const char* it = begin; it != end; ++it) {
+        if (*it == '.') {
+            is_fraction = true;
+            continue;
+        }
+        is_significant = is_significant || *it != '0';
+        if (!is_significant) {
+            exponent -= is_fraction;
+        } else if (count < 780) {
+            buffer[count++] = *it;
+            exponent -= is_fraction;
+        } else {
+            exponent += !is_fraction;
+            is_truncated = is_truncated || *it != '0';
+        }
+    }
+    if (is_truncated) {
+        buffer[count++] = '1';
+        exponent--;
+    }
+    if (!is_significant) {
+        buffer[count++] = '0';
+    }
+    snprintf(buffer + count, sizeof(buffer) - count, "e%lld", (long long)exponent);
+    return strtod(buffer, NULL);
+}
+
 static inline
 ParsedDouble try_parse_double(StringView* s) {
-    auto sign = +1.0;
-    if (STARTS_WITH_ITEM(*s, '-')) {
-        sign = -1.0;
-        DROP_FRONT(*s);
+    static const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    auto result = MAKE(ParsedDouble);
+    auto it = s->data;
+    auto end = END_POINTER(*s);
+    auto negative = it != end && *it == '-';
+    it += negative;
+    auto digits_begin = it;
+    uint64_t mantissa = 0;
+    int64_t exponent = 0;
+    auto significant_count = 0;
+    auto is_truncated = false;
+    // Leading zeros are not significant:
+    for (; it != end && *it == '0'; ++it) {
     }
-    auto integral = 0.0;
-    auto optional_integral = try_parse_u64(s);
-    if (optional_integral.ok) {
-        integral = (double)optional_integral.value;
+    for (; it != end && is_digit(*it); ++it) {
+        if (significant_count < 19) {
+            mantissa = 10 * mantissa + (uint64_t)(*it - '0');
+            significant_count++;
+        } else {
+            exponent++;
+            is_truncated = is_truncated || *it != '0';
+        }
     }
-    auto fractional = 0.0;
-    auto optional_fractional = MAKE(ParsedU64);
-    if (STARTS_WITH_ITEM(*s, '.')) {
-        DROP_FRONT(*s);
-        auto count = s->count;
-        optional_fractional = try_parse_u64(s);
-        if (optional_fractional.ok) {
-            fractional = (double)optional_fractional.value;
-            for (; count > s->count; --count) {
-                fractional *= 0.1;
+    auto has_digits = it != digits_begin;
+    if (it != end && *it == '.') {
+        auto fraction_begin = ++it;
+        if (significant_count == 0) {
+            for (; it != end && *it == '0'; ++it) {
+                exponent--;
             }
         }
+        for (; it != end && is_digit(*it); ++it) {
+            if (significant_count < 19) {
+                mantissa = 10 * mantissa + (uint64_t)(*it - '0');
+                significant_count++;
+                exponent--;
+            } else {
+                is_truncated = is_truncated || *it != '0';
+            }
+        }
+        has_digits = has_digits || it != fraction_begin;
     }
-    auto result = MAKE(ParsedDouble);
-    if (optional_integral.ok || optional_fractional.ok) {
-        result.value = sign * (integral + fractional);
-        result.ok = true;
+    if (!has_digits) {
+        return result;
+    }
+    auto digits_end = it;
+    int64_t explicit_exponent = 0;
+    if (it != end && (*it == 'e' || *it == 'E')) {
+        auto exponent_it = it + 1;
+        auto exponent_negative = exponent_it != end && *exponent_it == '-';
+        exponent_it += exponent_it != end && (*exponent_it == '-' || *exponent_it == '+');
+        // The exponent is only part of the number if it has digits:
+        if (exponent_it != end && is_digit(*exponent_it)) {
+            for (; exponent_it != end && is_digit(*exponent_it); ++exponent_it) {
+                if (explicit_exponent < 100000) {
+                    explicit_exponent = 10 * explicit_exponent + (*exponent_it - '0');
+                }
+            }
+            explicit_exponent = exponent_negative ? -explicit_exponent : explicit_exponent;
+            exponent += explicit_exponent;
+            it = exponent_it;
+        }
     }
+    // The exponent is in [-22, 22] when its unsigned offset by 22 is at most 44,
+    // which checks the range without signed arithmetic that the compiler would assume does not overflow:
+    if (!is_truncated && (uint64_t)exponent + 22 <= 44 && mantissa <= (1ull << 53) && FLT_EVAL_METHOD == 0) {
+        // Both the mantissa and the power of ten are exact doubles, so a single rounding gives the closest double:
+        result.value = (double)mantissa;
+        result.value = exponent < 0 ? result.value / powers_of_ten[-exponent] : result.value * powers_of_ten[exponent];
+        result.value = negative ? -result.value : result.value;
+    } else {
+        result.value = carma_decimal_to_double(mantissa, exponent, negative);
+        // The dropped digits put the number between mantissa and mantissa + 1:
+        if (is_truncated && result.value != carma_decimal_to_double(mantissa + 1, exponent, negative)) {
+            result.value = carma_parse_double_with_strtod(digits_begin, digits_end, negative, explicit_exponent);
+        }
+    }
+    result.ok = true;
+    s->count -= (size_t)(it - s->data);
+    s->data = it;
     return result;
 }
 
+// Returns a pointer to the first quote or backslash, or end if there is none.
+static inline
+const char* carma_find_quote_or_backslash(const char* it, const char* end) {
+#if CARMA_HAS_SSE2
+    const __m128i quotes = _mm_set1_epi8('"');
+    const __m128i backslashes = _mm_set1_epi8('\\');
+    for (; end - it >= 16; it += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)it);
+        __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(chunk, quotes), _mm_cmpeq_epi8(chunk, backslashes));
+        int mask = _mm_movemask_epi8(matches);
+        if (mask) {
+            return it + carma_count_trailing_zeros((uint64_t)mask);
+        }
+    }
+#endif
+    for (; it != end && *it != '"' && *it != '\\'; ++it) {
+    }
+    return it;
+}
+
+// Returns a pointer to the first quote, backslash or control character, or end if there is none.
+static inline
+const char* carma_find_json_string_end(const char* it, const char* end) {
+#if CARMA_HAS_SSE2
+    const __m128i quotes = _mm_set1_epi8('"');
+    const __m128i backslashes = _mm_set1_epi8('\\');
+    const __m128i last_control_characters = _mm_set1_epi8(0x1F);
+    for (; end - it >= 16; it += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)it);
+        __m128i controls = _mm_cmpeq_epi8(_mm_max_epu8(chunk, last_control_characters), last_control_characters);
+        __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(chunk, quotes), _mm_cmpeq_epi8(chunk, backslashes));
+        int mask = _mm_movemask_epi8(_mm_or_si128(matches, controls));
+        if (mask) {
+            return it + carma_count_trailing_zeros((uint64_t)mask);
+        }
+    }
+#endif
+    for (; it != end && *it != '"' && *it != '\\' && (unsigned char)*it >= 0x20; ++it) {
+    }
+    return it;
+}
+
+// Returns the string between the quotes, with its escape sequences, and advances the input past the closing quote.
+// The quotes and backslashes are found 16 bytes at a time.
+// If the string is unterminated it returns the rest of the input and leaves the input as it is.
 static inline
 StringView parse_quoted_string(StringView* s) {
     if (!STARTS_WITH_ITEM(*s, '"')) {
         return MAKE(StringView);
     }
-    auto remaining = *s;
-    DROP_FRONT(remaining); // Opening quote
-    StringView value = {remaining.data, 0};
-    while (!IS_EMPTY(remaining)) {
-        if (FIRST_ITEM(remaining) == '"') {
-            DROP_FRONT(remaining); // Closing quote
-            *s = remaining;
-            return value; // Success
-        }
-        else if (FIRST_ITEM(remaining) == '\\') {
-            // Skip escape sequences
-            DROP_FRONT(remaining);
-            value.count++;
-            if (IS_EMPTY(remaining)) {
-                return value; // Dangling escape error
-            }
-            DROP_FRONT(remaining);
-            value.count++;
-        }
-        else {
-            DROP_FRONT(remaining);
-            value.count++;
-        }
+    auto begin = s->data + 1;
+    auto end = END_POINTER(*s);
+    auto it = carma_find_quote_or_backslash(begin, end);
+    while (it != end && *it == '\\' && end - it >= 2) {
+        it = carma_find_quote_or_backslash(it + 2, end); // Skip escape sequences
     }
-    // Unterminated string error
-    return value;
+    if (it == end || *it != '"') {
+        return MAKE(StringView, begin, (size_t)(end - begin)); // Unterminated string or dangling escape error
+    }
+    *s = MAKE(StringView, it + 1, (size_t)(end - it - 1));
+    return MAKE(StringView, begin, (size_t)(it - begin));
 }
 
 static inline char parse_char_or_exit(StringView* s) {
@@ -192,6 +540,21 @@ static inline int parse_int_or_exit(StringView* s) {
     return GET_OPTIONAL_OR_EXIT(optional, "Could not parse int");
 }
 
+static inline uint32_t parse_u32_or_exit(StringView* s) {
+    auto optional = try_parse_u32(s);
+    return GET_OPTIONAL_OR_EXIT(optional, "Could not parse uint32_t");
+}
+
+static inline int32_t parse_i32_or_exit(StringView* s) {
+    auto optional = try_parse_i32(s);
+    return GET_OPTIONAL_OR_EXIT(optional, "Could not parse int32_t");
+}
+
+static inline int64_t parse_i64_or_exit(StringView* s) {
+    auto optional = try_parse_i64(s);
+    return GET_OPTIONAL_OR_EXIT(optional, "Could not parse int64_t");
+}
+
 static inline double parse_double_or_exit(StringView* s) {
     auto optional = try_parse_double(s);
     return GET_OPTIONAL_OR_EXIT(optional, "Could not parse double");
@@ -200,12 +563,18 @@ static inline double parse_double_or_exit(StringView* s) {
 #define TRY_PARSE_CHAR(s) try_parse_char(&(s))
 #define TRY_PARSE_U64(s) try_parse_u64(&(s))
 #define TRY_PARSE_INT(s) try_parse_int(&(s))
+#define TRY_PARSE_U32(s) try_parse_u32(&(s))
+#define TRY_PARSE_I32(s) try_parse_i32(&(s))
+#define TRY_PARSE_I64(s) try_parse_i64(&(s))
 #define TRY_PARSE_DOUBLE(s) try_parse_double(&(s))
 #define PARSE_QUOTED_STRING(s) parse_quoted_string(&(s))
 
 #define PARSE_CHAR(s) parse_char_or_exit(&(s))
 #define PARSE_U64(s) parse_u64_or_exit(&(s))
 #define PARSE_INT(s) parse_int_or_exit(&(s))
+#define PARSE_U32(s) parse_u32_or_exit(&(s))
+#define PARSE_I32(s) parse_i32_or_exit(&(s))
+#define PARSE_I64(s) parse_i64_or_exit(&(s))
 #define PARSE_DOUBLE(s) parse_double_or_exit(&(s))
 
 static inline
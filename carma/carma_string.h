@@ -4,6 +4,23 @@
 
 #include "carma.h"
 #include "carma_make.h"
+#include "carma_powers_of_five.h"
+
+// File offsets are 64 bits where the platform allows it, since long is only 32 bits on Windows.
+#if defined(_WIN32)
+typedef long long CarmaFileOffset;
+#define CARMA_FTELL _ftelli64
+#define CARMA_FSEEK _fseeki64
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+typedef off_t CarmaFileOffset;
+#define CARMA_FTELL ftello
+#define CARMA_FSEEK fseeko
+#else
+typedef long CarmaFileOffset;
+#define CARMA_FTELL ftell
+#define CARMA_FSEEK fseek
+#endif
 
 typedef struct StringView {
     const char* data;
@@ -21,7 +38,7 @@ typedef struct StringBuilder {
 // GENERAL STRING MACROS
 
 static inline char* carma_make_cstring(const char* data, size_t count) {
-    char* result = (char*)malloc(count + 1);
+    char* result = (char*)carma_allocate(CARMA_ALLOCATOR, count + 1);
     if (result != NULL) {
         memcpy(result, data, count);
         result[count] = '\0';
@@ -31,6 +48,9 @@ static inline char* carma_make_cstring(const char* data, size_t count) {
 
 #define MAKE_CSTRING(string) carma_make_cstring((string).data, (string).count)
 
+// Frees a c string made by MAKE_CSTRING.
+#define FREE_CSTRING(cstring) carma_free(CARMA_ALLOCATOR, (cstring), strlen(cstring) + 1)
+
 #define PRINT_CARMA_STRING(string) do { \
     FOR_EACH(c, (string)) { \
         putchar(*c); \
@@ -85,15 +105,14 @@ StringView FORMAT_STRING(const char* format, ...) {
     return result;
 }
 
+// Uses memchr, which is vectorized by the C libraries.
 static inline
 size_t carma_count_steps_until_delimiter(const char* begin, const char* end, char delimiter) {
-    size_t steps = 0;
-    for (const char* iterator = begin; iterator != end; ++iterator, ++steps) {
-        if (*iterator == delimiter) {
-            return steps;
-        }
+    if (begin == end) {
+        return 0;
     }
-    return steps;
+    const char* iterator = (const char*)memchr(begin, delimiter, (size_t)(end - begin));
+    return (size_t)((iterator ? iterator : end) - begin);
 }
 
 static inline
@@ -119,6 +138,49 @@ size_t carma_count_steps_while(const char* begin, const char* end, int (*predica
 }
 
 
+// A character set is a lookup table that tells which characters that are in the set.
+// It is built once and is faster to check than calling a predicate function for each character.
+typedef struct CharacterSet {
+    bool contains[256];
+} CharacterSet;
+
+static inline
+CharacterSet carma_make_character_set(const char* characters) {
+    CharacterSet set = {};
+    for (const char* c = characters; *c; ++c) {
+        set.contains[(unsigned char)*c] = true;
+    }
+    return set;
+}
+
+static inline
+CharacterSet carma_make_character_set_predicate(int (*predicate)(int)) {
+    CharacterSet set = {};
+    for (int c = 0; c < 256; ++c) {
+        set.contains[c] = predicate(c);
+    }
+    return set;
+}
+
+#define MAKE_CHARACTER_SET(characters) carma_make_character_set(characters)
+#define MAKE_CHARACTER_SET_PREDICATE(predicate) carma_make_character_set_predicate(predicate)
+
+static inline
+size_t carma_count_steps_until_in_set(const char* begin, const char* end, const CharacterSet* set) {
+    const char* iterator = begin;
+    for (; iterator != end && !set->contains[(unsigned char)*iterator]; ++iterator) {
+    }
+    return (size_t)(iterator - begin);
+}
+
+static inline
+size_t carma_count_steps_while_in_set(const char* begin, const char* end, const CharacterSet* set) {
+    const char* iterator = begin;
+    for (; iterator != end && set->contains[(unsigned char)*iterator]; ++iterator) {
+    }
+    return (size_t)(iterator - begin);
+}
+
 #define FOR_EACH_WORD(word, string, delimiter) \
     for (\
     StringView word = {(string).data, 0};\
@@ -137,6 +199,58 @@ size_t carma_count_steps_while(const char* begin, const char* end, int (*predica
     (word).data += (word).count + carma_count_steps_while(END_POINTER(word), END_POINTER(string), (is_delimiter))\
     )
 
+#define FOR_EACH_WORD_IN_SET(word, string, delimiters) \
+    for (\
+    StringView word = {(string).data, 0};\
+    (word).count = carma_count_steps_until_in_set((word).data, END_POINTER(string), &(delimiters)),\
+    (word).data != END_POINTER(string)\
+    ;\
+    (word).data += (word).count + carma_count_steps_while_in_set(END_POINTER(word), END_POINTER(string), &(delimiters))\
+    )
+
+// Returns the line from begin to the line feed.
+// A carriage return before the line feed is not part of the line.
+static inline
+StringView carma_line_until(const char* begin, const char* line_feed) {
+    StringView line = {begin, (size_t)(line_feed - begin)};
+    if (line.count > 0 && line_feed[-1] == '\r') {
+        line.count--;
+    }
+    return line;
+}
+
+// Returns the line that starts at begin, without its line break.
+static inline
+StringView carma_line_starting_at(const char* begin, const char* end) {
+    StringView line = {begin, (size_t)(end - begin)};
+    if (begin == end) {
+        return line;
+    }
+    const char* line_feed = (const char*)memchr(begin, '\n', line.count);
+    return line_feed ? carma_line_until(begin, line_feed) : line;
+}
+
+// Returns the start of the line after the given line.
+static inline
+const char* carma_skip_line(StringView line, const char* end) {
+    const char* iterator = END_POINTER(line);
+    if (iterator != end && *iterator == '\r') {
+        iterator++;
+    }
+    if (iterator != end && *iterator == '\n') {
+        iterator++;
+    }
+    return iterator;
+}
+
+#define FOR_EACH_LINE(line, string) \
+    for (\
+    StringView line = carma_line_starting_at((string).data, END_POINTER(string));\
+    (line).data != END_POINTER(string)\
+    ;\
+    line = carma_line_starting_at(carma_skip_line((line), END_POINTER(string)), END_POINTER(string))\
+    )
+
 ////////////////////////////////////////////////////////////////////////////////
 // STRING BUILDER MACROS
 
@@ -148,62 +262,342 @@ static inline char* carma_as_cstring(StringBuilder* string_builder) {
 
 #define AS_CSTRING(string_builder) carma_as_cstring(&(string_builder))
 
+////////////////////////////////////////////////////////////////////////////////
+// NUMBER FORMATTING
+
+// Returns the high 64 bits of the 128 bit product and writes the low 64 bits to low.
+static inline
+uint64_t carma_multiply_u64(uint64_t a, uint64_t b, uint64_t* low) {
+#ifdef __SIZEOF_INT128__
+    __extension__ unsigned __int128 product = (unsigned __int128)a * b;
+    *low = (uint64_t)product;
+    return (uint64_t)(product >> 64);
+#else
+    uint64_t a_low = (uint32_t)a;
+    uint64_t a_high = a >> 32;
+    uint64_t b_low = (uint32_t)b;
+    uint64_t b_high = b >> 32;
+    uint64_t low_low = a_low * b_low;
+    uint64_t high_low = a_high * b_low;
+    uint64_t low_high = a_low * b_high;
+    uint64_t middle = high_low + (low_low >> 32) + (uint32_t)low_high;
+    *low = (middle << 32) | (uint32_t)low_low;
+    return a_high * b_high + (middle >> 32) + (low_high >> 32);
+#endif
+}
+
+static inline
+int carma_count_leading_zeros(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_clzll(x);
+#else
+    int count = 0;
+    for (; !(x & (1ull << 63)); x <<= 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+// Upper bound of the characters written by SERIALIZE_INTEGRAL, including sign and null terminator.
+// An integer of N bytes has at most 3 * N decimal digits.
+#define CARMA_MAX_SERIALIZED_INTEGRAL_SIZE(x) (3 * sizeof(x) + 2)
+
+// The two digit numbers from "00" to "99", so that two digits can be written per division.
+static const char carma_digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static inline
+int carma_count_decimal_digits(uint64_t x) {
+    // 10^n, except 0 instead of 1 so that 0 gets one digit:
+    static const uint64_t powers_of_ten[20] = {
+        0ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+        1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+        100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+        1000000000000000000ull, 10000000000000000000ull,
+    };
+    // Estimate the digit count from the bit count, since 1233 / 4096 is about log10(2):
+    int estimate = (64 - carma_count_leading_zeros(x | 1)) * 1233 >> 12;
+    return estimate + 1 - (x < powers_of_ten[estimate]);
+}
+
+// Writes the integer and a null terminator, and returns the count of the characters before the null terminator.
+// bits is the two's complement bits of the integer, and is_negative tells if it should be interpreted as signed.
+static inline
+size_t carma_format_integer(char* buffer, uint64_t bits, bool is_negative) {
+    char* it = buffer;
+    // Negate as unsigned, which works for the most negative value as well:
+    uint64_t value = is_negative ? 0 - bits : bits;
+    if (is_negative) {
+        *it++ = '-';
+    }
+    int digit_count = carma_count_decimal_digits(value);
+    char* back = it + digit_count;
+    *back = '\0';
+    for (; value >= 100; value /= 100) {
+        back -= 2;
+        memcpy(back, carma_digit_pairs + 2 * (value % 100), 2);
+    }
+    if (value >= 10) {
+        back -= 2;
+        memcpy(back, carma_digit_pairs + 2 * value, 2);
+    } else {
+        *--back = (char)('0' + value);
+    }
+    return (size_t)(it + digit_count - buffer);
+}
+
+// The comparison x < 1 avoids a warning about x < 0 always being false for unsigned types.
 #define SERIALIZE_INTEGRAL(string_builder, x) do { \
     CARMA_AUTO _si_x = (x); \
-    if (_si_x < 0) { \
-        _si_x = -_si_x; \
-        APPEND((string_builder), '-'); \
-    } \
-    CARMA_AUTO _front = (string_builder).count; \
-    do { \
-        APPEND((string_builder), (char)('0' + _si_x % 10)); \
-        _si_x /= 10; \
-    } while (_si_x > 0); \
-    for (CARMA_AUTO _si_back = (string_builder).count - 1; _front < _si_back; _front++, _si_back--) { \
-        SWAP((string_builder).data[_front], (string_builder).data[_si_back]); \
-    } \
-    APPEND(string_builder, '\0'); \
-    DROP_BACK(string_builder); \
+    RESERVE_EXPONENTIAL_GROWTH((string_builder), (string_builder).count + CARMA_MAX_SERIALIZED_INTEGRAL_SIZE(_si_x)); \
+    (string_builder).count += carma_format_integer(END_POINTER(string_builder), (uint64_t)_si_x, _si_x < 1 && _si_x != 0); \
 } while(0)
 
-static inline size_t carma_count_integer_digits(double x) {
-    size_t digits = 1;
-    for (double t = x; t >= 10.0; t /= 10.0) digits++;
-    return digits;
+// Doubles are formatted with the Grisu2 algorithm by Florian Loitsch,
+// which gives the shortest digits that parse back to the same double in almost all cases,
+// and otherwise a few digits more that still parse back to the same double.
+
+// A number f * 2^e with a 64 bit significand f.
+typedef struct CarmaDiyFp {
+    uint64_t f;
+    int e;
+} CarmaDiyFp;
+
+// Rounds the 128 bit product to 64 bits.
+static inline
+CarmaDiyFp carma_multiply_diyfp(CarmaDiyFp x, CarmaDiyFp y) {
+    uint64_t low;
+    uint64_t high = carma_multiply_u64(x.f, y.f, &low);
+    return (CarmaDiyFp){high + (low >> 63), x.e + y.e + 64};
+}
+
+static inline
+CarmaDiyFp carma_normalize_diyfp(CarmaDiyFp x) {
+    int shift = carma_count_leading_zeros(x.f);
+    return (CarmaDiyFp){x.f << shift, x.e - shift};
+}
+
+// Returns 10^k rounded to 64 bits, from the 128 bit powers of five: 10^k = 5^k * 2^k.
+static inline
+CarmaDiyFp carma_power_of_ten_diyfp(int k) {
+    size_t index = 2 * (size_t)(k - CARMA_SMALLEST_POWER_OF_FIVE);
+    uint64_t f = carma_powers_of_five[index] + (carma_powers_of_five[index + 1] >> 63);
+    // The binary exponent is log2(10^k) = k * 217706 / 2^16.
+    return (CarmaDiyFp){f, ((217706 * k) >> 16) - 63};
+}
+
+// Decrements the last digit while that gives a number that is closer to the exact value w,
+// and still inside the rounding interval.
+static inline
+void carma_round_grisu_digits(char* digits, size_t count, uint64_t distance, uint64_t delta, uint64_t rest, uint64_t ten_k) {
+    while (rest < distance && delta - rest >= ten_k &&
+        (rest + ten_k < distance || distance - rest > rest + ten_k - distance)) {
+        digits[count - 1]--;
+        rest += ten_k;
+    }
+}
+
+// Writes the digits of w, which is between low and high, and returns the digit count.
+// The exponent of low, w and high is in [-60, -32], so that the integral part fits in 32 bits.
+static inline
+size_t carma_generate_grisu_digits(char* digits, int* decimal_exponent, CarmaDiyFp low, CarmaDiyFp w, CarmaDiyFp high) {
+    uint64_t delta = high.f - low.f;
+    uint64_t distance = high.f - w.f;
+    int shift = -high.e;
+    uint64_t one = 1ull << shift;
+    uint32_t integral = (uint32_t)(high.f >> shift);
+    uint64_t fractional = high.f & (one - 1);
+    static const uint32_t powers_of_ten[10] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+    };
+    size_t integral_count = 1;
+    while (integral_count < 10 && integral >= powers_of_ten[integral_count]) {
+        integral_count++;
+    }
+    // Divide by the constant 10 instead of by the variable powers of ten, which is much faster:
+    char integral_digits[10];
+    uint32_t quotient = integral;
+    for (size_t i = integral_count; i > 0; --i) {
+        integral_digits[i - 1] = (char)('0' + quotient % 10);
+        quotient /= 10;
+    }
+    size_t count = 0;
+    uint32_t prefix = 0;
+    for (size_t i = 0; i < integral_count; ++i) {
+        digits[count++] = integral_digits[i];
+        prefix = 10 * prefix + (uint32_t)(integral_digits[i] - '0');
+        size_t remaining = integral_count - i - 1;
+        uint64_t rest = ((uint64_t)(integral - prefix * powers_of_ten[remaining]) << shift) + fractional;
+        if (rest <= delta) {
+            *decimal_exponent += (int)remaining;
+            carma_round_grisu_digits(digits, count, distance, delta, rest, (uint64_t)powers_of_ten[remaining] << shift);
+            return count;
+        }
+    }
+    for (;;) {
+        fractional *= 10;
+        delta *= 10;
+        distance *= 10;
+        digits[count++] = (char)('0' + (fractional >> shift));
+        fractional &= one - 1;
+        (*decimal_exponent)--;
+        if (fractional <= delta) {
+            carma_round_grisu_digits(digits, count, distance, delta, fractional, one);
+            return count;
+        }
+    }
+}
+
+// Writes the shortest digits of a positive finite value, so that value = digits * 10^decimal_exponent.
+// A float has a wider rounding interval than a double, so it gets fewer digits.
+static inline
+size_t carma_grisu2(char* digits, int* decimal_exponent, double value, bool is_float) {
+    uint64_t significand;
+    int biased_exponent;
+    int precision;
+    int bias;
+    if (is_float) {
+        float float_value = (float)value;
+        uint32_t bits;
+        memcpy(&bits, &float_value, sizeof(bits));
+        significand = bits & 0x7FFFFF;
+        biased_exponent = (int)(bits >> 23);
+        precision = 24;
+        bias = 127 + 23;
+    } else {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        significand = bits & 0xFFFFFFFFFFFFFull;
+        biased_exponent = (int)(bits >> 52);
+        precision = 53;
+        bias = 1023 + 52;
+    }
+    CarmaDiyFp v = biased_exponent == 0 ?
+        (CarmaDiyFp){significand, 1 - bias} :
+        (CarmaDiyFp){significand + (1ull << (precision - 1)), biased_exponent - bias};
+    // The rounding interval is half way to the neighbouring numbers,
+    // and the lower neighbour is closer when the significand is a power of two:
+    bool is_lower_closer = significand == 0 && biased_exponent > 1;
+    CarmaDiyFp high = carma_normalize_diyfp((CarmaDiyFp){2 * v.f + 1, v.e - 1});
+    CarmaDiyFp low = is_lower_closer ? (CarmaDiyFp){4 * v.f - 1, v.e - 2} : (CarmaDiyFp){2 * v.f - 1, v.e - 1};
+    low = (CarmaDiyFp){low.f << (low.e - high.e), high.e};
+    CarmaDiyFp w = carma_normalize_diyfp(v);
+
+    // Scale by the smallest 10^k that gives a binary exponent of at least -60.
+    // 78913 / 2^18 is log10(2), and the division rounds towards zero which gives the ceiling for negative numbers:
+    int f = -60 - high.e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0);
+    CarmaDiyFp power_of_ten = carma_power_of_ten_diyfp(k);
+    w = carma_multiply_diyfp(w, power_of_ten);
+    high = carma_multiply_diyfp(high, power_of_ten);
+    low = carma_multiply_diyfp(low, power_of_ten);
+    // Shrink the interval by the rounding error of the multiplications:
+    high.f--;
+    low.f++;
+    *decimal_exponent = -k;
+    return carma_generate_grisu_digits(digits, decimal_exponent, low, w, high);
 }
 
-static inline double carma_normalize_decimal(double x, size_t int_digits) {
-    double scale = 1.0;
-    for (size_t i = 0; i + 1 < int_digits; i++) scale *= 10.0;
-    return x / scale;
+static inline
+char* carma_write_exponent(char* it, bool is_negative, unsigned magnitude) {
+    *it++ = 'e';
+    *it++ = is_negative ? '-' : '+';
+    if (magnitude >= 100) {
+        *it++ = (char)('0' + magnitude / 100);
+        magnitude %= 100;
+        *it++ = (char)('0' + magnitude / 10);
+    } else if (magnitude >= 10) {
+        *it++ = (char)('0' + magnitude / 10);
+    }
+    *it++ = (char)('0' + magnitude % 10);
+    return it;
+}
+
+// Upper bound of the characters written by SERIALIZE_DOUBLE, including sign and null terminator.
+// The longest output is like -0.0000012345678901234567.
+#define CARMA_MAX_SERIALIZED_DOUBLE_SIZE 32
+
+// Writes the value and a null terminator, and returns the count of the characters before the null terminator.
+// Numbers from 1e-6 to 1e21 are written without exponent, like JavaScript does,
+// so integers are written as integers.
+static inline
+size_t carma_format_double(char* buffer, double value, bool is_float) {
+    char* it = buffer;
+    if (value != value) {
+        memcpy(it, "nan", 3);
+        it += 3;
+    } else if (value == 0.0) {
+        *it++ = '0';
+    } else {
+        if (value < 0.0) {
+            *it++ = '-';
+            value = -value;
+        }
+        if (value == 1.0 / 0.0) {
+            memcpy(it, "inf", 3);
+            it += 3;
+        } else {
+            char digits[20];
+            int exponent;
+            size_t count = carma_grisu2(digits, &exponent, value, is_float);
+            // The position of the decimal point relative to the first digit.
+            // The counts of the digits and zeros to write are computed as size_t within the checked ranges,
+            // instead of as differences of signed ints that the compiler would assume do not overflow:
+            int point = (int)count + exponent;
+            if (0 < point && point <= 21) {
+                size_t integral_count = (size_t)point;
+                if (count <= integral_count) {
+                    memcpy(it, digits, count);
+                    it += count;
+                    memset(it, '0', integral_count - count);
+                    it += integral_count - count;
+                } else {
+                    memcpy(it, digits, integral_count);
+                    it += integral_count;
+                    *it++ = '.';
+                    memcpy(it, digits + integral_count, count - integral_count);
+                    it += count - integral_count;
+                }
+            } else if (-6 < point && point <= 0) {
+                size_t zero_count = (size_t)-point;
+                *it++ = '0';
+                *it++ = '.';
+                memset(it, '0', zero_count);
+                it += zero_count;
+                memcpy(it, digits, count);
+                it += count;
+            } else {
+                *it++ = digits[0];
+                if (count > 1) {
+                    *it++ = '.';
+                    memcpy(it, digits + 1, count - 1);
+                    it += count - 1;
+                }
+                // The exponent is point - 1, and its magnitude is computed with unsigned wrap around:
+                it = carma_write_exponent(it, point <= 0, point > 0 ? (unsigned)point - 1u : 1u - (unsigned)point);
+            }
+        }
+    }
+    *it = '\0';
+    return (size_t)(it - buffer);
 }
 
+// Tells if x is a float and not a double or an integer, without _Generic which is not in C++.
+#define CARMA_IS_FLOAT(x) (sizeof(x) == sizeof(float) && (CARMA_TYPE_OF(x))0.5 != 0)
+
 #define SERIALIZE_DOUBLE(string_builder, x) do { \
-    double _x = (double)(x); \
-    if (_x != _x) { \
-        SERIALIZE_CSTRING((string_builder), "nan"); \
-    } else if (_x == 1.0 / 0.0) { \
-        SERIALIZE_CSTRING((string_builder), "inf"); \
-    } else if (_x == -1.0 / 0.0) { \
-        SERIALIZE_CSTRING((string_builder), "-inf"); \
-    } else if ((double)INTMAX_MIN <= _x && _x <= (double)INTMAX_MAX && _x == (double)(intmax_t)_x) { \
-        SERIALIZE_INTEGRAL((string_builder), (intmax_t)_x); \
-    } else { \
-        if (_x < 0) { \
-            APPEND((string_builder), '-'); \
-            _x = -_x; \
-        } \
-        size_t _int_digits = carma_count_integer_digits(_x); \
-        double _d = carma_normalize_decimal(_x, _int_digits); \
-        for (size_t _i = 0; _i < _int_digits + 6; _i++) { \
-            if (_i == _int_digits) APPEND((string_builder), '.'); \
-            int _digit = (int)_d; \
-            APPEND((string_builder), '0' + _digit); \
-            _d = (_d - _digit) * 10.0; \
-        } \
-    } \
-    APPEND(string_builder, '\0'); \
-    DROP_BACK(string_builder); \
+    RESERVE_EXPONENTIAL_GROWTH((string_builder), (string_builder).count + CARMA_MAX_SERIALIZED_DOUBLE_SIZE); \
+    (string_builder).count += carma_format_double(END_POINTER(string_builder), (double)(x), CARMA_IS_FLOAT(x)); \
 } while(0)
 
 #define SERIALIZE_BOOL(string_builder, x) do { \
@@ -234,13 +628,107 @@ static inline double carma_normalize_decimal(double x, size_t int_digits) {
     FOR_FILE(_file, file_path, "r") \
         FOR_LINES(line, capacity, _file)
 
+#ifndef CARMA_FILE_READ_CHUNK_SIZE
+#define CARMA_FILE_READ_CHUNK_SIZE (1 << 16)
+#endif
+
+// Returns the number of bytes left in a file, or -1 if it is not seekable like a pipe.
+static inline
+CarmaFileOffset carma_remaining_file_size(FILE* file) {
+    CarmaFileOffset position = CARMA_FTELL(file);
+    if (position < 0 || CARMA_FSEEK(file, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    CarmaFileOffset end = CARMA_FTELL(file);
+    CARMA_FSEEK(file, position, SEEK_SET);
+    return end < position ? -1 : end - position;
+}
+
+// Appends the rest of the file to a dynamic array of bytes.
+// Seekable files are read with a single reservation of their size, plus one for a null terminator.
+// Other streams, and files too large to reserve up front, grow the dynamic array exponentially, in chunks.
+// Exits if reading fails, rather than returning a truncated file.
+#define READ_STREAM(dynamic_array, file) do { \
+    CHECK_INTERNAL(sizeof(*(dynamic_array).data) == 1, "READ_STREAM expects a dynamic array of bytes"); \
+    CarmaFileOffset _remaining_size = carma_remaining_file_size(file); \
+    if (_remaining_size >= 0 && (uintmax_t)_remaining_size < SIZE_MAX - (dynamic_array).count) { \
+        RESERVE((dynamic_array), (dynamic_array).count + (size_t)_remaining_size + 1); \
+    } \
+    for (;;) { \
+        if (REMAINING_CAPACITY(dynamic_array) == 0) { \
+            RESERVE_EXPONENTIAL_GROWTH((dynamic_array), (dynamic_array).count + CARMA_FILE_READ_CHUNK_SIZE); \
+        } \
+        size_t _read_count = fread(END_POINTER(dynamic_array), 1, REMAINING_CAPACITY(dynamic_array), (file)); \
+        (dynamic_array).count += _read_count; \
+        if (_read_count == 0) { \
+            break; \
+        } \
+    } \
+    CHECK_EXTERNAL(!ferror(file), "READ_STREAM failed to read the file"); \
+} while (0)
+
+// Returns the line after the previous line of the file, or a line with NULL data at the end of the file.
+// The lines are read in blocks into the buffer, which grows to fit the longest line.
+// The returned line points into the buffer, and is valid until the next call.
+static inline
+StringView carma_read_next_line(StringView previous, StringBuilder* buffer, FILE* file) {
+    if (!previous.data) {
+        CLEAR(*buffer);
+    }
+    const char* begin = previous.data ? carma_skip_line(previous, END_POINTER(*buffer)) : buffer->data;
+    size_t searched_count = 0;
+    for (;;) {
+        size_t line_count = (size_t)(END_POINTER(*buffer) - begin);
+        if (line_count > searched_count) {
+            const char* line_feed = (const char*)memchr(begin + searched_count, '\n', line_count - searched_count);
+            if (line_feed) {
+                return carma_line_until(begin, line_feed);
+            }
+        }
+        searched_count = line_count;
+        // Move the unfinished line to the front of the buffer, and read more after it:
+        if (line_count > 0 && begin != buffer->data) {
+            memmove(buffer->data, begin, line_count);
+        }
+        buffer->count = line_count;
+        if (REMAINING_CAPACITY(*buffer) == 0) {
+            RESERVE_EXPONENTIAL_GROWTH(*buffer, buffer->count + CARMA_FILE_READ_CHUNK_SIZE);
+        }
+        begin = buffer->data;
+        size_t read_count = fread(END_POINTER(*buffer), 1, REMAINING_CAPACITY(*buffer), file);
+        buffer->count += read_count;
+        if (read_count == 0) {
+            StringView last_line = {begin, line_count};
+            return line_count ? last_line : (StringView){};
+        }
+    }
+}
+
+// Loops over the lines of a FILE*, for files that cannot be mapped.
+// The buffer is a StringBuilder that is re-used between lines and can be re-used between files.
+#define FOR_EACH_STREAM_LINE(line, buffer, file) \
+    for (\
+    StringView line = carma_read_next_line((StringView){}, &(buffer), (file));\
+    (line).data\
+    ;\
+    line = carma_read_next_line((line), &(buffer), (file))\
+    )
+
+// Appends the bytes of the file to a dynamic array of bytes.
+#define READ_BINARY_FILE(dynamic_array, file_path) do { \
+    FOR_FILE(_file, (file_path), "rb") { \
+        READ_STREAM((dynamic_array), _file); \
+    } \
+} while (0)
+
+// Returns the content of the file, with a null terminator after the end.
 static inline
 StringBuilder read_text_file(const char* file_path) {
     StringBuilder result = {};
     FOR_FILE(file, file_path, "r") {
-        for (int ch; ch = fgetc(file), ch != EOF;) {
-            APPEND(result, (char)ch);
-        }
+        READ_STREAM(result, file);
+        APPEND(result, '\0');
+        DROP_BACK(result);
     }
     return result;
 }
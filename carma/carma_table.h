@@ -7,19 +7,52 @@
 ////////////////////////////////////////////////////////////////////////////////
 // HASH FUNCTIONS
 
+// The hash functions consume 8 bytes at a time,
+// with the rounds and final avalanche of xxHash64.
+
+#define CARMA_HASH_PRIME1 0x9E3779B185EBCA87ull
+#define CARMA_HASH_PRIME2 0xC2B2AE3D27D4EB4Full
+#define CARMA_HASH_PRIME3 0x165667B19E3779F9ull
+#define CARMA_HASH_PRIME4 0x85EBCA77C2B2AE63ull
+#define CARMA_HASH_PRIME5 0x27D4EB2F165667C5ull
+
 static inline
-size_t carma_hash_byte(size_t hash, char data) {
-    return ((hash << 5) + hash) + data;
+uint64_t carma_rotate_left(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
 }
 
 static inline
-size_t carma_hash_bytes(size_t hash, const char* data, size_t count) {
-    for (size_t i = 0; i < count; ++i) {
-        hash = carma_hash_byte(hash, data[i]);
-    }
+uint64_t carma_hash_avalanche(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= CARMA_HASH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= CARMA_HASH_PRIME3;
+    hash ^= hash >> 32;
     return hash;
 }
 
+static inline
+size_t carma_hash_bytes(size_t seed, const char* data, size_t count) {
+    uint64_t hash = (uint64_t)seed + CARMA_HASH_PRIME5 + (uint64_t)count;
+    for (; count >= 8; data += 8, count -= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        word = carma_rotate_left(word * CARMA_HASH_PRIME2, 31) * CARMA_HASH_PRIME1;
+        hash = carma_rotate_left(hash ^ word, 27) * CARMA_HASH_PRIME1 + CARMA_HASH_PRIME4;
+    }
+    if (count >= 4) {
+        uint32_t word;
+        memcpy(&word, data, 4);
+        hash = carma_rotate_left(hash ^ (word * CARMA_HASH_PRIME1), 23) * CARMA_HASH_PRIME2 + CARMA_HASH_PRIME3;
+        data += 4;
+        count -= 4;
+    }
+    for (; count > 0; ++data, --count) {
+        hash = carma_rotate_left(hash ^ ((unsigned char)*data * CARMA_HASH_PRIME5), 11) * CARMA_HASH_PRIME1;
+    }
+    return (size_t)carma_hash_avalanche(hash);
+}
+
 #define CARMA_HASH_INIT 5381
 
 #define CARMA_HASH_KEY(key) \
@@ -28,8 +61,16 @@ size_t carma_hash_bytes(size_t hash, const char* data, size_t count) {
 #define CARMA_HASH_RANGE_KEY(key) \
     carma_hash_bytes(CARMA_HASH_INIT, (const char*)(BEGIN_POINTER(key)), COUNT_BYTES(key))
 
+// The hash of an item that is moved within a table.
+#define CARMA_HASH_ITEM_KEY(item) CARMA_HASH_KEY((item).key)
+#define CARMA_HASH_ITEM_RANGE_KEY(item) CARMA_HASH_RANGE_KEY((item).key)
+#define CARMA_HASH_ITEM_STORED(item) ((item).hash)
+
 ////////////////////////////////////////////////////////////////////////////////
 // FIND DATA IN TABLE
+// The capacity of a table is a power of two,
+// so the probing wraps around by masking instead of dividing.
+// Collisions are resolved with linear probing.
 
 #define FOR_EACH_TABLE(iterator, table) \
     for (CARMA_AUTO iterator = (table).data; iterator != (table).data + (table).capacity; ++iterator) \
@@ -38,10 +79,11 @@ size_t carma_hash_bytes(size_t hash, const char* data, size_t count) {
 #define CARMA_FIND_FREE_INDEX_FOR_KEY(table, k, _it) do { \
     size_t _capacity = (table).capacity; \
     CHECK_INTERNAL(_capacity, "Unexpected zero capacity"); \
-    CARMA_AUTO _base = CARMA_HASH_KEY(k) % _capacity; \
+    size_t _mask = _capacity - 1; \
+    size_t _index = CARMA_HASH_KEY(k) & _mask; \
     bool _found = false; \
-    for (size_t _offset = 0; _offset < _capacity; ++_offset) { \
-        _it = (table).data + (_base + _offset) % _capacity; \
+    for (size_t _offset = 0; _offset < _capacity; ++_offset, _index = (_index + 1) & _mask) { \
+        _it = (table).data + _index; \
         if (!_it->occupied || _it->key == (k)) { \
             _found = true; \
             break; \
@@ -52,10 +94,12 @@ size_t carma_hash_bytes(size_t hash, const char* data, size_t count) {
 
 #define CARMA_FIND_FREE_INDEX_FOR_RANGE_KEY(table, k, _it) do { \
     size_t _capacity = (table).capacity; \
-    CARMA_AUTO _base = CARMA_HASH_RANGE_KEY(k) % _capacity; \
+    CHECK_INTERNAL(_capacity, "Unexpected zero capacity"); \
+    size_t _mask = _capacity - 1; \
+    size_t _index = CARMA_HASH_RANGE_KEY(k) & _mask; \
     bool _found = false; \
-    for (size_t _offset = 0; _offset < _capacity; ++_offset) { \
-        _it = (table).data + (_base + _offset) % _capacity; \
+    for (size_t _offset = 0; _offset < _capacity; ++_offset, _index = (_index + 1) & _mask) { \
+        _it = (table).data + _index; \
         if (!_it->occupied || ARE_EQUAL(_it->key, (k))) { \
             _found = true; \
             break; \
@@ -64,6 +108,16 @@ size_t carma_hash_bytes(size_t hash, const char* data, size_t count) {
     CHECK_INTERNAL(_found, "Error in CARMA_FIND_FREE_INDEX_FOR_RANGE_KEY "); \
 } while (0)
 
+// Finds the first unoccupied item from the given hash.
+// Used when moving items whose keys are known to be unique.
+#define CARMA_FIND_FREE_INDEX_FOR_HASH(table, hash, _it) do { \
+    size_t _mask = (table).capacity - 1; \
+    size_t _index = (hash) & _mask; \
+    for (_it = (table).data + _index; _it->occupied; _it = (table).data + _index) { \
+        _index = (_index + 1) & _mask; \
+    } \
+} while (0)
+
 #define GET_KEY_VALUE(k, _value, table) do { \
     if (IS_EMPTY(table)) \
         break; \
@@ -106,25 +160,12 @@ bool carma_is_power_of_two(size_t n) {
 
 #define FREE_TABLE(table) FREE_DARRAY(table)
 
-#define CARMA_ENSURE_TABLE_CAPACITY_KEY(table) do { \
-    if ((table).count + 1 < 0.7 * (table).capacity) { \
-        break; \
-    } \
-    CARMA_AUTO new_capacity = CARMA_DOUBLED_CAPACITY((table).capacity); \
-    CARMA_AUTO new_table = table; \
-    INIT_TABLE(new_table, new_capacity); \
-    new_table.count = (table).count; \
-    FOR_EACH_TABLE(_old_item, (table)) { \
-        CARMA_AUTO _new_item = new_table.data; \
-        CARMA_FIND_FREE_INDEX_FOR_KEY((new_table), _old_item->key, _new_item); \
-        *_new_item = *_old_item; \
-    } \
-    FREE_TABLE(table); \
-    table = new_table; \
-} while (0)
+// Grows the table when it would become more than 70% full.
+#define CARMA_IS_TABLE_CAPACITY_ENOUGH(table) \
+    (10 * ((table).count + 1) < 7 * (table).capacity)
 
-#define CARMA_ENSURE_TABLE_CAPACITY_RANGE_KEY(table) do { \
-    if ((table).count + 1 < 0.7 * (table).capacity) { \
+#define CARMA_ENSURE_TABLE_CAPACITY(table, HASH_ITEM) do { \
+    if (CARMA_IS_TABLE_CAPACITY_ENOUGH(table)) { \
         break; \
     } \
     CARMA_AUTO new_capacity = CARMA_DOUBLED_CAPACITY((table).capacity); \
@@ -133,13 +174,19 @@ bool carma_is_power_of_two(size_t n) {
     new_table.count = (table).count; \
     FOR_EACH_TABLE(_old_item, (table)) { \
         CARMA_AUTO _new_item = new_table.data; \
-        CARMA_FIND_FREE_INDEX_FOR_RANGE_KEY((new_table), _old_item->key, _new_item); \
+        CARMA_FIND_FREE_INDEX_FOR_HASH((new_table), HASH_ITEM(*_old_item), _new_item); \
         *_new_item = *_old_item; \
     } \
     FREE_TABLE(table); \
     table = new_table; \
 } while (0)
 
+#define CARMA_ENSURE_TABLE_CAPACITY_KEY(table) \
+    CARMA_ENSURE_TABLE_CAPACITY(table, CARMA_HASH_ITEM_KEY)
+
+#define CARMA_ENSURE_TABLE_CAPACITY_RANGE_KEY(table) \
+    CARMA_ENSURE_TABLE_CAPACITY(table, CARMA_HASH_ITEM_RANGE_KEY)
+
 #define SET_KEY_VALUE(k, v, table) do { \
     CARMA_ENSURE_TABLE_CAPACITY_KEY(table); \
     CARMA_AUTO _k = (k); \
@@ -168,4 +215,275 @@ bool carma_is_power_of_two(size_t n) {
     CHECK_INTERNAL((table).count < (table).capacity, "There should always be room left in table"); \
 } while (0)
 
+////////////////////////////////////////////////////////////////////////////////
+// ERASE FROM TABLE
+// Erasing uses backward-shift deletion instead of tombstones.
+// The items after the erased item in its probe chain are moved back,
+// so lookups stay as fast as if the erased key had never been inserted.
+
+#define CARMA_ERASE_TABLE_ITEM(table, item, HASH_ITEM) do { \
+    size_t _mask = (table).capacity - 1; \
+    size_t _hole = (size_t)((item) - (table).data); \
+    size_t _next = (_hole + 1) & _mask; \
+    for (; (table).data[_next].occupied; _next = (_next + 1) & _mask) { \
+        size_t _home = HASH_ITEM((table).data[_next]) & _mask; \
+        if (((_next - _home) & _mask) >= ((_next - _hole) & _mask)) { \
+            (table).data[_hole] = (table).data[_next]; \
+            _hole = _next; \
+        } \
+    } \
+    (table).data[_hole].occupied = false; \
+    (table).count--; \
+} while (0)
+
+#define ERASE_KEY(k, table) do { \
+    if (!(table).capacity) { \
+        break; \
+    } \
+    CARMA_AUTO _k = (k); \
+    CARMA_AUTO _item = (table).data; \
+    CARMA_FIND_FREE_INDEX_FOR_KEY((table), _k, _item); \
+    if (_item->occupied) { \
+        CARMA_ERASE_TABLE_ITEM((table), _item, CARMA_HASH_ITEM_KEY); \
+    } \
+} while (0)
+
+#define ERASE_RANGE_KEY(k, table) do { \
+    if (!(table).capacity) { \
+        break; \
+    } \
+    CARMA_AUTO _k = (k); \
+    CARMA_AUTO _item = (table).data; \
+    CARMA_FIND_FREE_INDEX_FOR_RANGE_KEY((table), _k, _item); \
+    if (_item->occupied) { \
+        CARMA_ERASE_TABLE_ITEM((table), _item, CARMA_HASH_ITEM_RANGE_KEY); \
+    } \
+} while (0)
+
+// An erased item can be replaced by a later item in its probe chain,
+// so the same index is checked again after each erase.
+#define CARMA_ERASE_TABLE_IF(table, predicate, HASH_ITEM) do { \
+    for (size_t _i = 0; _i < (table).capacity;) { \
+        CARMA_AUTO _item = (table).data + _i; \
+        if (_item->occupied && (predicate)(*_item)) { \
+            CARMA_ERASE_TABLE_ITEM((table), _item, HASH_ITEM); \
+        } else { \
+            ++_i; \
+        } \
+    } \
+} while (0)
+
+#define ERASE_TABLE_IF(table, predicate) \
+    CARMA_ERASE_TABLE_IF((table), predicate, CARMA_HASH_ITEM_KEY)
+
+#define ERASE_RANGE_KEY_TABLE_IF(table, predicate) \
+    CARMA_ERASE_TABLE_IF((table), predicate, CARMA_HASH_ITEM_RANGE_KEY)
+
+////////////////////////////////////////////////////////////////////////////////
+// HASHED TABLE
+// A hashed table stores the hash of each key in its items,
+// which are structs with the four members: key, value, hash, occupied.
+// The hash is a size_t and is compared before the keys when probing,
+// so long range keys are only compared when they most likely are equal.
+// Growing and erasing use the stored hashes and never rehash the keys.
+
+#define CARMA_FIND_FREE_INDEX_FOR_RANGE_KEY_HASHED(table, k, k_hash, _it) do { \
+    size_t _capacity = (table).capacity; \
+    CHECK_INTERNAL(_capacity, "Unexpected zero capacity"); \
+    size_t _mask = _capacity - 1; \
+    size_t _index = (k_hash) & _mask; \
+    bool _found = false; \
+    for (size_t _offset = 0; _offset < _capacity; ++_offset, _index = (_index + 1) & _mask) { \
+        _it = (table).data + _index; \
+        if (!_it->occupied || (_it->hash == (k_hash) && ARE_EQUAL(_it->key, (k)))) { \
+            _found = true; \
+            break; \
+        } \
+    } \
+    CHECK_INTERNAL(_found, "Error in CARMA_FIND_FREE_INDEX_FOR_RANGE_KEY_HASHED "); \
+} while (0)
+
+#define GET_RANGE_KEY_VALUE_HASHED(k, _value, table) do { \
+    if (IS_EMPTY(table)) \
+        break; \
+    CARMA_AUTO _k = (k); \
+    size_t _k_hash = CARMA_HASH_RANGE_KEY(_k); \
+    CARMA_AUTO _it = (table).data; \
+    CARMA_FIND_FREE_INDEX_FOR_RANGE_KEY_HASHED((table), _k, _k_hash, _it); \
+    if (_it->occupied) { \
+        (_value) = _it->value; \
+    } \
+} while (0)
+
+#define SET_RANGE_KEY_VALUE_HASHED(k, v, table) do { \
+    CARMA_ENSURE_TABLE_CAPACITY(table, CARMA_HASH_ITEM_STORED); \
+    CARMA_AUTO _k = (k); \
+    size_t _k_hash = CARMA_HASH_RANGE_KEY(_k); \
+    CARMA_AUTO _item = (table).data; \
+    CARMA_FIND_FREE_INDEX_FOR_RANGE_KEY_HASHED((table), _k, _k_hash, _item); \
+    if (!_item->occupied) { \
+        (table).count++; \
+    } \
+    _item->key = _k; \
+    _item->value = (v); \
+    _item->hash = _k_hash; \
+    _item->occupied = (true); \
+    CHECK_INTERNAL((table).count < (table).capacity, "There should always be room left in table"); \
+} while (0)
+
+#define ERASE_RANGE_KEY_HASHED(k, table) do { \
+    if (!(table).capacity) { \
+        break; \
+    } \
+    CARMA_AUTO _k = (k); \
+    size_t _k_hash = CARMA_HASH_RANGE_KEY(_k); \
+    CARMA_AUTO _item = (table).data; \
+    CARMA_FIND_FREE_INDEX_FOR_RANGE_KEY_HASHED((table), _k, _k_hash, _item); \
+    if (_item->occupied) { \
+        CARMA_ERASE_TABLE_ITEM((table), _item, CARMA_HASH_ITEM_STORED); \
+    } \
+} while (0)
+
+#define ERASE_RANGE_KEY_TABLE_IF_HASHED(table, predicate) \
+    CARMA_ERASE_TABLE_IF((table), predicate, CARMA_HASH_ITEM_STORED)
+
 #define CLEAR_TABLE(table) do { FOR_EACH_TABLE(item, (table)) item->occupied = false; } while(0)
+
+////////////////////////////////////////////////////////////////////////////////
+// INCREMENTAL TABLE
+// An incremental table spreads the rehashing of a resize over many operations,
+// instead of moving all items during a single insert.
+// It is a table with three extra members:
+// old_data, old_capacity and rehash_index.
+// While the table is growing, the items live in either the old or the new buffer.
+// Each insert and lookup moves a few buckets from the old buffer to the new one.
+// Old items below rehash_index have been moved, and are only kept to preserve the probe chains.
+// A key is live in only one of the buffers, so the new buffer is probed first,
+// and the old buffer only when the key is not found there.
+
+// A table with n items grows again after about n more inserts,
+// so about 1 / CARMA_INCREMENTAL_REHASH_COUNT of the operations move buckets.
+// The moves write to fresh pages of the new buffer and pay their page faults,
+// so the count is high enough to keep those operations out of the 99.9th percentile.
+#ifndef CARMA_INCREMENTAL_REHASH_COUNT
+#define CARMA_INCREMENTAL_REHASH_COUNT 4096
+#endif
+
+#define CARMA_REHASH_TABLE_INCREMENTAL(table, bucket_count) do { \
+    if (!(table).old_data) { \
+        break; \
+    } \
+    size_t _rehash_end = (table).rehash_index + (bucket_count); \
+    if (_rehash_end > (table).old_capacity) { \
+        _rehash_end = (table).old_capacity; \
+    } \
+    for (; (table).rehash_index < _rehash_end; ++(table).rehash_index) { \
+        CARMA_AUTO _old_item = (table).old_data + (table).rehash_index; \
+        if (_old_item->occupied) { \
+            CARMA_AUTO _new_item = (table).data; \
+            CARMA_FIND_FREE_INDEX_FOR_HASH((table), CARMA_HASH_KEY(_old_item->key), _new_item); \
+            *_new_item = *_old_item; \
+        } \
+    } \
+    if ((table).rehash_index == (table).old_capacity) { \
+        CARMA_FREE((table).old_data, (table).old_capacity); \
+        (table).old_data = NULL; \
+        (table).old_capacity = 0; \
+        (table).rehash_index = 0; \
+    } \
+} while (0)
+
+// Sets _it to the old item with the key, if it has not been moved yet, and otherwise to NULL.
+#define CARMA_FIND_OLD_ITEM_INCREMENTAL(table, k, _it) do { \
+    _it = NULL; \
+    if (!(table).old_data) { \
+        break; \
+    } \
+    size_t _mask = (table).old_capacity - 1; \
+    size_t _index = CARMA_HASH_KEY(k) & _mask; \
+    for (size_t _offset = 0; _offset < (table).old_capacity; ++_offset, _index = (_index + 1) & _mask) { \
+        CARMA_AUTO _candidate = (table).old_data + _index; \
+        if (!_candidate->occupied) { \
+            break; \
+        } \
+        if (_candidate->key == (k)) { \
+            if (_index >= (table).rehash_index) { \
+                _it = _candidate; \
+            } \
+            break; \
+        } \
+    } \
+} while (0)
+
+#define CARMA_ENSURE_TABLE_CAPACITY_INCREMENTAL(table) do { \
+    if (CARMA_IS_TABLE_CAPACITY_ENOUGH(table)) { \
+        break; \
+    } \
+    CARMA_REHASH_TABLE_INCREMENTAL((table), (table).old_capacity); \
+    CARMA_AUTO _new_capacity = CARMA_DOUBLED_CAPACITY((table).capacity); \
+    if ((table).capacity) { \
+        (table).old_data = (table).data; \
+        (table).old_capacity = (table).capacity; \
+        (table).rehash_index = 0; \
+    } \
+    CARMA_CALLOC((table).data, _new_capacity); \
+    (table).capacity = _new_capacity; \
+} while (0)
+
+#define SET_KEY_VALUE_INCREMENTAL(k, v, table) do { \
+    CARMA_REHASH_TABLE_INCREMENTAL((table), CARMA_INCREMENTAL_REHASH_COUNT); \
+    CARMA_ENSURE_TABLE_CAPACITY_INCREMENTAL(table); \
+    CARMA_AUTO _k = (k); \
+    CARMA_AUTO _item = (table).data; \
+    CARMA_FIND_FREE_INDEX_FOR_KEY((table), _k, _item); \
+    if (!_item->occupied) { \
+        CARMA_AUTO _old_item = (table).old_data; \
+        CARMA_FIND_OLD_ITEM_INCREMENTAL((table), _k, _old_item); \
+        if (_old_item) { \
+            _item = _old_item; \
+        } else { \
+            (table).count++; \
+        } \
+    } \
+    _item->key = _k; \
+    _item->value = (v); \
+    _item->occupied = (true); \
+} while (0)
+
+#define GET_KEY_VALUE_INCREMENTAL(k, _value, table) do { \
+    if (IS_EMPTY(table)) \
+        break; \
+    CARMA_REHASH_TABLE_INCREMENTAL((table), CARMA_INCREMENTAL_REHASH_COUNT); \
+    CARMA_AUTO _key = (k); \
+    CARMA_AUTO _it = (table).data; \
+    CARMA_FIND_FREE_INDEX_FOR_KEY((table), _key, _it); \
+    if (!_it->occupied) { \
+        CARMA_FIND_OLD_ITEM_INCREMENTAL((table), _key, _it); \
+    } \
+    if (_it && _it->occupied) { \
+        (_value) = _it->value; \
+    } \
+} while (0)
+
+// Erasing from the old buffer would break its probe chains,
+// so an ongoing rehash is finished before the key is erased.
+#define ERASE_KEY_INCREMENTAL(k, table) do { \
+    CARMA_REHASH_TABLE_INCREMENTAL((table), (table).old_capacity); \
+    ERASE_KEY((k), (table)); \
+} while (0)
+
+#define FOR_EACH_TABLE_INCREMENTAL(iterator, table) \
+    for (CARMA_AUTO iterator = (table).old_data ? (table).old_data + (table).rehash_index : (table).data; \
+        iterator != (table).data + (table).capacity; \
+        iterator = iterator + 1 == (table).old_data + (table).old_capacity ? (table).data : iterator + 1) \
+        if ((iterator)->occupied)
+
+#define FREE_TABLE_INCREMENTAL(table) do { \
+    if ((table).old_data) { \
+        CARMA_FREE((table).old_data, (table).old_capacity); \
+    } \
+    (table).old_data = NULL; \
+    (table).old_capacity = 0; \
+    (table).rehash_index = 0; \
+    FREE_TABLE(table); \
+} while (0)
@@ -5,3 +5,18 @@
 #elif defined(__cplusplus)
     #define CARMA_TYPE_OF(x) decltype(x)
 #endif
+
+// Tells if two expressions have the same type, ignoring qualifiers like const.
+// It is false when the compiler cannot tell, which is always safe for its users.
+// In C++ it is false since copying bytes is not safe for all C++ types.
+#if defined(__cplusplus)
+    #define CARMA_IS_SAME_TYPE(a, b) false
+#elif defined(__GNUC__) || defined(__clang__)
+    #define CARMA_IS_SAME_TYPE(a, b) __builtin_types_compatible_p(CARMA_TYPE_OF(a), CARMA_TYPE_OF(b))
+#else
+    #define CARMA_IS_SAME_TYPE(a, b) 0
+#endif
+
+// Tell if an expression has a floating point or a signed type, without evaluating it.
+#define CARMA_IS_FLOATING_POINT(x) ((CARMA_TYPE_OF(x))0.5 != 0)
+#define CARMA_IS_SIGNED(x) ((CARMA_TYPE_OF(x))-1 < (CARMA_TYPE_OF(x))1)
@@ -2,6 +2,7 @@
 #include <inttypes.h>
 #include <carma/carma.h>
 #include <carma/carma_string.h>
+#include <carma/carma_file.h>
 #include <carma/carma_parse.h>
 
 typedef struct Interval {
@@ -21,17 +22,35 @@ typedef struct Ids {
     size_t capacity;
 } Ids;
 
+#define INTERVAL_FIRST(interval) (interval).first
+#define INTERVAL_LAST(interval) (interval).last
+
 bool isInsideInterval(uint64_t id, Interval interval) {
     return interval.first <= id && id <= interval.last;
 }
 
-bool isInsideAnyInterval(uint64_t id, Intervals intervals) {
-    FOR_EACH(interval, intervals) {
-        if (isInsideInterval(id,*interval)) {
-            return true;
+// Sorts the intervals and merges the ones that overlap,
+// so that both their first and last ids are increasing.
+void mergeIntervals(Intervals* intervals) {
+    SORT_BY_KEY(*intervals, INTERVAL_FIRST);
+    size_t count = 0;
+    FOR_EACH(interval, *intervals) {
+        if (count > 0 && interval->first <= intervals->data[count - 1].last) {
+            auto last = &intervals->data[count - 1].last;
+            *last = CARMA_MAX(*last, interval->last);
+        }
+        else {
+            intervals->data[count++] = *interval;
         }
     }
-    return false;
+    intervals->count = count;
+}
+
+// Assumes that the intervals are merged.
+// The only interval that can contain the id is the first one that ends at or after it.
+bool isInsideAnyInterval(uint64_t id, Intervals intervals) {
+    LOWER_BOUND_BY_KEY(index, intervals, INTERVAL_LAST, id);
+    return index < intervals.count && isInsideInterval(id, intervals.data[index]);
 }
 
 int countFreshIds(Ids ids, Intervals intervals) {
@@ -45,17 +64,16 @@ int countFreshIds(Ids ids, Intervals intervals) {
 }
 
 int main() {
-    auto file_path = "day05.txt";
-    auto capacity = 100000;
+    auto file = MAKE_MAPPED_FILE("day05.txt");
     auto read_interval = true;
     auto intervals = (Intervals){};
     auto ids = (Ids){};
-    READ_LINES(line, capacity, file_path) {
-        if (strlen(line) == 1) {
+    FOR_EACH_LINE(line, file) {
+        if (IS_EMPTY(line)) {
             read_interval = false;
             continue;
         }
-        auto word = STRING_VIEW(line);
+        auto word = line;
         if (read_interval) {
             auto interval = (Interval){};
             interval.first = PARSE_U64(word);
@@ -68,6 +86,8 @@ int main() {
             APPEND(ids, id);
         }
     }
+    FREE_MAPPED_FILE(file);
+    mergeIntervals(&intervals);
     auto count = countFreshIds(ids, intervals);
     printf("Count: %d\n", count);
 }
@@ -0,0 +1,1995 @@
+#include <ctype.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <carma/carma.h>
+#include <carma/carma_arena.h>
+#include <carma/carma_file.h>
+#include <carma/carma_json_index.h>
+#include <carma/carma_json_parse.h>
+#include <carma/carma_json_serialize.h>
+#include <carma/carma_json_stream.h>
+#include <carma/carma_parallel.h>
+#include <carma/carma_parse.h>
+#include <carma/carma_string.h>
+#include <carma/carma_table.h>
+
+// Usage: benchmarks [name] [size]
+// Runs all benchmarks whose name contains the given name.
+// The size overrides the default problem size of the benchmarks.
+// Build in release mode to get meaningful numbers.
+
+typedef struct {
+    StringBuilder* data;
+    size_t count;
+    size_t capacity;
+} StringBuilders;
+
+typedef struct {
+    uint64_t key;
+    uint64_t value;
+    bool occupied;
+} ItemU64U64;
+
+typedef struct {
+    ItemU64U64* data;
+    size_t count;
+    size_t capacity;
+} TableU64U64;
+
+typedef struct {
+    uint64_t* data;
+    size_t count;
+    size_t capacity;
+} U64Array;
+
+typedef struct {
+    StringView key;
+    size_t value;
+    bool occupied;
+} ItemStringSize;
+
+typedef struct {
+    ItemStringSize* data;
+    size_t count;
+    size_t capacity;
+} TableStringSize;
+
+typedef struct {
+    StringView key;
+    size_t value;
+    size_t hash;
+    bool occupied;
+} ItemStringSizeHashed;
+
+typedef struct {
+    ItemStringSizeHashed* data;
+    size_t count;
+    size_t capacity;
+} HashedTableStringSize;
+
+typedef struct {
+    StringView* data;
+    size_t count;
+    size_t capacity;
+} StringViews;
+
+typedef struct {
+    ItemU64U64* data;
+    size_t count;
+    size_t capacity;
+    ItemU64U64* old_data;
+    size_t old_capacity;
+    size_t rehash_index;
+} IncrementalTableU64U64;
+
+typedef struct {
+    double* data;
+    size_t count;
+    size_t capacity;
+} DoubleArray;
+
+typedef struct {
+    uint8_t* data;
+    size_t count;
+    size_t capacity;
+} ByteArray;
+
+size_t global_benchmark_size = 0;
+volatile size_t global_benchmark_sink = 0;
+
+double seconds_now() {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + 1e-9 * (double)time.tv_nsec;
+}
+
+size_t benchmark_size(size_t default_size) {
+    return global_benchmark_size ? global_benchmark_size : default_size;
+}
+
+void print_benchmark(const char* description, double seconds, double items) {
+    printf("%-48s %10.3f ms %14.1f items/s\n", description, 1000.0 * seconds, items / seconds);
+}
+
+int compare_doubles(const void* a, const void* b) {
+    auto x = *(const double*)a;
+    auto y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+double percentile(DoubleArray sorted, double fraction) {
+    return sorted.data[(size_t)(fraction * (double)(sorted.count - 1))];
+}
+
+// Sorts the latencies and prints their percentiles in microseconds.
+void print_latencies(const char* description, DoubleArray latencies) {
+    SORT(latencies, CARMA_LESS);
+    printf("%-48s p50 %8.3f us  p99 %8.3f us  p999 %8.3f us  max %10.3f us\n",
+        description,
+        1e6 * percentile(latencies, 0.5),
+        1e6 * percentile(latencies, 0.99),
+        1e6 * percentile(latencies, 0.999),
+        1e6 * latencies.data[latencies.count - 1]
+    );
+}
+
+uint64_t random_u64(uint64_t* state) {
+    // splitmix64
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Makes a text of random words from a small vocabulary, with a line break every few words.
+StringBuilder make_benchmark_text(size_t byte_count) {
+    const char* vocabulary[] = {
+        "the", "names", "John", "Doe", "for", "males", "Jane", "Roe", "females",
+        "or", "Jonnie", "and", "Janie", "children", "just", "non-gender-specifically",
+        "are", "used", "as", "placeholder", "name", "a", "party", "whose", "true",
+        "identity", "is", "unknown", "must", "be", "withheld", "in", "legal", "action",
+    };
+    size_t vocabulary_count = sizeof(vocabulary) / sizeof(vocabulary[0]);
+    uint64_t state = 1;
+    auto text = (StringBuilder){};
+    RESERVE(text, byte_count + 64);
+    for (size_t i = 0; text.count < byte_count; ++i) {
+        auto word = STRING_VIEW(vocabulary[random_u64(&state) % vocabulary_count]);
+        CONCAT(text, word);
+        APPEND(text, i % 12 == 11 ? '\n' : ' ');
+    }
+    return text;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ARENA
+
+// Each line of the text is handled as a request, that copies its words
+// into short lived string builders that all die together.
+size_t handle_words_request_malloc(StringView line) {
+    auto words = (StringBuilders){};
+    FOR_EACH_WORD(word, line, ' ') {
+        auto copy = (StringBuilder){};
+        CONCAT(copy, word);
+        SERIALIZE_INTEGRAL(copy, word.count);
+        APPEND(words, copy);
+    }
+    auto total = words.count;
+    FOR_EACH(word, words) {
+        FREE_DARRAY(*word);
+    }
+    FREE_DARRAY(words);
+    return total;
+}
+
+size_t handle_words_request_arena(StringView line, CarmaArena* arena) {
+    auto words = (StringBuilders){};
+    FOR_EACH_WORD(word, line, ' ') {
+        auto copy = (StringBuilder){};
+        CONCAT_ARENA(copy, word, *arena);
+        SERIALIZE_INTEGRAL_ARENA(copy, word.count, *arena);
+        APPEND_ARENA(words, copy, *arena);
+    }
+    auto total = words.count;
+    RESET_ARENA(*arena);
+    return total;
+}
+
+void benchmark_arena() {
+    auto text = make_benchmark_text(benchmark_size(64 * 1024 * 1024));
+    auto view = MAKE(StringView, text.data, text.count);
+    size_t words = 0;
+
+    auto start = seconds_now();
+    FOR_EACH_WORD(line, view, '\n') {
+        words += handle_words_request_malloc(line);
+    }
+    print_benchmark("arena: words requests with malloc", seconds_now() - start, (double)words);
+
+    words = 0;
+    auto arena = (CarmaArena){};
+    start = seconds_now();
+    FOR_EACH_WORD(line, view, '\n') {
+        words += handle_words_request_arena(line, &arena);
+    }
+    print_benchmark("arena: words requests with arena", seconds_now() - start, (double)words);
+
+    global_benchmark_sink += words;
+    FREE_ARENA(arena);
+    FREE_DARRAY(text);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TABLE
+
+// The table as it was before the current hash and probing:
+// a DJB2 hash that consumes one byte at a time and a modulo per probe.
+size_t legacy_hash_key(uint64_t key) {
+    const char* data = (const char*)&key;
+    size_t hash = 5381;
+    for (size_t i = 0; i < sizeof(key); ++i) {
+        hash = ((hash << 5) + hash) + (size_t)data[i];
+    }
+    return hash;
+}
+
+ItemU64U64* legacy_find_item(TableU64U64 table, uint64_t key) {
+    size_t index = legacy_hash_key(key) % table.capacity;
+    for (size_t offset = 0; offset < table.capacity; ++offset) {
+        auto item = table.data + (index + offset) % table.capacity;
+        if (!item->occupied || item->key == key) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+void legacy_set_key_value(uint64_t key, uint64_t value, TableU64U64* table) {
+    if ((double)(table->count + 1) >= 0.7 * (double)table->capacity) {
+        auto new_table = (TableU64U64){};
+        INIT_TABLE(new_table, CARMA_DOUBLED_CAPACITY(table->capacity));
+        new_table.count = table->count;
+        FOR_EACH_TABLE(old_item, *table) {
+            *legacy_find_item(new_table, old_item->key) = *old_item;
+        }
+        FREE_TABLE(*table);
+        *table = new_table;
+    }
+    auto item = legacy_find_item(*table, key);
+    table->count += !item->occupied;
+    *item = (ItemU64U64){key, value, true};
+}
+
+uint64_t legacy_get_key_value(uint64_t key, TableU64U64 table) {
+    auto item = legacy_find_item(table, key);
+    return item->occupied ? item->value : 0;
+}
+
+// Sequential keys with a stride, like indices or aligned addresses,
+// are the ones that cluster the most with a weak hash and linear probing.
+U64Array make_table_keys(size_t count, bool random) {
+    auto keys = (U64Array){};
+    uint64_t state = 3;
+    for (size_t i = 0; i < count; ++i) {
+        APPEND(keys, random ? random_u64(&state) : 64 * (uint64_t)i);
+    }
+    return keys;
+}
+
+void shuffle_table_keys(U64Array keys) {
+    uint64_t state = 5;
+    for (size_t i = keys.count; i > 1; --i) {
+        auto j = random_u64(&state) % i;
+        auto key = keys.data[i - 1];
+        keys.data[i - 1] = keys.data[j];
+        keys.data[j] = key;
+    }
+}
+
+void benchmark_table_size(size_t count, bool random) {
+    auto keys = make_table_keys(count, random);
+    auto lookup_keys = make_table_keys(count, random);
+    shuffle_table_keys(lookup_keys);
+    auto rounds = count < 10 * 1000 * 1000 ? 10 * 1000 * 1000 / count : 1;
+    auto lookups = (double)(rounds * count);
+    auto kind = random ? "random" : "strided";
+    char description[64];
+
+    auto legacy = (TableU64U64){};
+    auto start = seconds_now();
+    FOR_EACH(key, keys) {
+        legacy_set_key_value(*key, *key, &legacy);
+    }
+    snprintf(description, sizeof(description), "table: legacy insert %zu %s", count, kind);
+    print_benchmark(description, seconds_now() - start, (double)count);
+
+    uint64_t sum = 0;
+    start = seconds_now();
+    for (size_t round = 0; round < rounds; ++round) {
+        FOR_EACH(key, lookup_keys) {
+            sum += legacy_get_key_value(*key, legacy);
+        }
+    }
+    snprintf(description, sizeof(description), "table: legacy lookup %zu %s", count, kind);
+    print_benchmark(description, seconds_now() - start, lookups);
+
+    auto table = (TableU64U64){};
+    start = seconds_now();
+    FOR_EACH(key, keys) {
+        SET_KEY_VALUE(*key, *key, table);
+    }
+    snprintf(description, sizeof(description), "table: insert %zu %s", count, kind);
+    print_benchmark(description, seconds_now() - start, (double)count);
+
+    start = seconds_now();
+    for (size_t round = 0; round < rounds; ++round) {
+        FOR_EACH(key, lookup_keys) {
+            uint64_t value = 0;
+            GET_KEY_VALUE(*key, value, table);
+            sum -= value;
+        }
+    }
+    snprintf(description, sizeof(description), "table: lookup %zu %s", count, kind);
+    print_benchmark(description, seconds_now() - start, lookups);
+
+    CHECK_INTERNAL(sum == 0, "Tables disagree");
+    FREE_TABLE(legacy);
+    FREE_TABLE(table);
+    FREE_DARRAY(keys);
+    FREE_DARRAY(lookup_keys);
+}
+
+// Pass a size like 50000000 to benchmark a table that is much bigger than the caches.
+void benchmark_table() {
+    size_t default_sizes[] = {1000, 1000 * 1000};
+    auto sizes = (U64Array){};
+    if (global_benchmark_size) {
+        APPEND(sizes, global_benchmark_size);
+    } else {
+        APPEND(sizes, default_sizes[0]);
+        APPEND(sizes, default_sizes[1]);
+    }
+    FOR_EACH(size, sizes) {
+        benchmark_table_size(*size, false);
+        benchmark_table_size(*size, true);
+    }
+    FREE_DARRAY(sizes);
+}
+
+// Keeps a steady state of live keys where each step erases the oldest key
+// and inserts a new one. Backward-shift deletion leaves no tombstones,
+// so the lookup rate should stay flat from the first round to the last.
+void benchmark_table_churn() {
+    auto live_count = benchmark_size(1000 * 1000);
+    auto round_count = 8;
+    auto table = (TableU64U64){};
+    uint64_t next_key = 0;
+    for (; next_key < live_count; ++next_key) {
+        SET_KEY_VALUE(next_key, next_key, table);
+    }
+    uint64_t state = 7;
+    uint64_t sum = 0;
+    char description[64];
+    for (int round = 0; round < round_count; ++round) {
+        auto start = seconds_now();
+        for (size_t i = 0; i < live_count; ++i, ++next_key) {
+            ERASE_KEY(next_key - live_count, table);
+            SET_KEY_VALUE(next_key, next_key, table);
+        }
+        snprintf(description, sizeof(description), "table churn: round %d erase and insert", round);
+        print_benchmark(description, seconds_now() - start, (double)live_count);
+
+        start = seconds_now();
+        for (size_t i = 0; i < live_count; ++i) {
+            uint64_t key = next_key - 1 - random_u64(&state) % live_count;
+            uint64_t value = 0;
+            GET_KEY_VALUE(key, value, table);
+            sum += value;
+        }
+        snprintf(description, sizeof(description), "table churn: round %d lookup", round);
+        print_benchmark(description, seconds_now() - start, (double)live_count);
+    }
+    CHECK_INTERNAL(table.count == live_count, "Unexpected table count after churn");
+    global_benchmark_sink += sum;
+    FREE_TABLE(table);
+}
+
+// Times each insert on its own, to see the stalls of the resizes.
+// The incremental table moves a few buckets per insert instead.
+void benchmark_table_latency() {
+    auto count = benchmark_size(4 * 1000 * 1000);
+    auto latencies = (DoubleArray){};
+    RESERVE(latencies, count);
+    uint64_t state = 11;
+
+    auto table = (TableU64U64){};
+    for (size_t i = 0; i < count; ++i) {
+        auto key = random_u64(&state);
+        auto start = seconds_now();
+        SET_KEY_VALUE(key, i, table);
+        APPEND(latencies, seconds_now() - start);
+    }
+    print_latencies("table latency: insert", latencies);
+    FREE_TABLE(table);
+
+    latencies.count = 0;
+    auto incremental = (IncrementalTableU64U64){};
+    for (size_t i = 0; i < count; ++i) {
+        auto key = random_u64(&state);
+        auto start = seconds_now();
+        SET_KEY_VALUE_INCREMENTAL(key, i, incremental);
+        APPEND(latencies, seconds_now() - start);
+    }
+    print_latencies("table latency: incremental insert", latencies);
+    FREE_TABLE_INCREMENTAL(incremental);
+
+    FREE_DARRAY(latencies);
+}
+
+// Counts words like words.c, for a stream of words drawn from a set of distinct keys.
+// The keys share a long prefix like paths or URLs, and differ only in their last 8 bytes.
+void benchmark_table_hashed_key_size(size_t distinct_count, size_t key_size) {
+    auto text = (StringBuilder){};
+    RESERVE(text, distinct_count * key_size);
+    uint64_t state = 13;
+    for (size_t i = 0; i < distinct_count; ++i) {
+        for (size_t j = 0; j + 8 < key_size; ++j) {
+            APPEND(text, '/');
+        }
+        auto suffix = random_u64(&state);
+        for (size_t j = 0; j < 8; ++j, suffix >>= 8) {
+            APPEND(text, (char)('a' + (suffix & 0xff) % 26));
+        }
+    }
+    auto words = (StringViews){};
+    for (size_t i = 0; i < 4 * distinct_count; ++i) {
+        auto index = random_u64(&state) % distinct_count;
+        APPEND(words, MAKE(StringView, text.data + index * key_size, key_size));
+    }
+    char description[64];
+
+    auto table = (TableStringSize){};
+    auto start = seconds_now();
+    FOR_EACH(word, words) {
+        size_t word_count = 0;
+        GET_RANGE_KEY_VALUE(*word, word_count, table);
+        SET_RANGE_KEY_VALUE(*word, word_count + 1, table);
+    }
+    snprintf(description, sizeof(description), "table hashed: plain count %zu byte keys", key_size);
+    print_benchmark(description, seconds_now() - start, (double)words.count);
+
+    auto hashed = (HashedTableStringSize){};
+    start = seconds_now();
+    FOR_EACH(word, words) {
+        size_t word_count = 0;
+        GET_RANGE_KEY_VALUE_HASHED(*word, word_count, hashed);
+        SET_RANGE_KEY_VALUE_HASHED(*word, word_count + 1, hashed);
+    }
+    snprintf(description, sizeof(description), "table hashed: hashed count %zu byte keys", key_size);
+    print_benchmark(description, seconds_now() - start, (double)words.count);
+
+    CHECK_INTERNAL(table.count == hashed.count, "Tables disagree");
+    global_benchmark_sink += table.count;
+    FREE_TABLE(table);
+    FREE_TABLE(hashed);
+    FREE_DARRAY(words);
+    FREE_DARRAY(text);
+}
+
+void benchmark_table_hashed() {
+    auto distinct_count = benchmark_size(200 * 1000);
+    benchmark_table_hashed_key_size(distinct_count, 8);
+    benchmark_table_hashed_key_size(distinct_count, 32);
+    benchmark_table_hashed_key_size(distinct_count, 256);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// FILE
+
+size_t count_lines(const char* data, size_t count) {
+    size_t lines = 0;
+    auto end = data + count;
+    for (const char* it = data; (it = memchr(it, '\n', (size_t)(end - it))); ++it) {
+        lines++;
+    }
+    return lines;
+}
+
+// Reads a file and counts its lines. The file is in the page cache after it is written,
+// so this measures the cost of getting the bytes into the program, not the disk.
+// Pass a size like 1000000000 to read a 1 GB file.
+void benchmark_file() {
+    auto file_path = "benchmark_file.txt";
+    auto text = make_benchmark_text(benchmark_size(256 * 1024 * 1024));
+    FOR_FILE(file, file_path, "wb") {
+        fwrite(text.data, 1, text.count, file);
+    }
+    auto expected_lines = count_lines(text.data, text.count);
+    auto bytes = (double)text.count;
+    FREE_DARRAY(text);
+
+    auto start = seconds_now();
+    auto read_text = read_text_file(file_path);
+    auto lines = count_lines(read_text.data, read_text.count);
+    print_benchmark("file: read_text_file bytes", seconds_now() - start, bytes);
+    CHECK_INTERNAL(lines == expected_lines, "Unexpected line count");
+    FREE_DARRAY(read_text);
+
+    start = seconds_now();
+    auto read_file = (MappedFile){};
+    FOR_FILE(file, file_path, "rb") {
+        read_file = carma_read_mapped_file(file);
+    }
+    lines = count_lines(read_file.data, read_file.count);
+    print_benchmark("file: carma_read_mapped_file bytes", seconds_now() - start, bytes);
+    CHECK_INTERNAL(lines == expected_lines, "Unexpected line count");
+    FREE_MAPPED_FILE(read_file);
+
+    start = seconds_now();
+    auto mapped_file = MAKE_MAPPED_FILE(file_path);
+    lines = count_lines(mapped_file.data, mapped_file.count);
+    print_benchmark("file: MAKE_MAPPED_FILE bytes", seconds_now() - start, bytes);
+    CHECK_INTERNAL(lines == expected_lines, "Unexpected line count");
+    FREE_MAPPED_FILE(mapped_file);
+
+    remove(file_path);
+}
+
+// Writes a file like the input of advent of code 2025 day 5,
+// with lines of intervals, an empty line and then lines of ids.
+void write_day05_file(const char* file_path, size_t byte_count) {
+    uint64_t state = 17;
+    size_t written = 0;
+    FOR_FILE(file, file_path, "wb") {
+        for (; written < byte_count / 4;) {
+            uint64_t first = random_u64(&state) % 1000000000000000ull;
+            uint64_t last = first + random_u64(&state) % 1000000000000ull;
+            written += (size_t)fprintf(file, "%" PRIu64 "-%" PRIu64 "\n", first, last);
+        }
+        written += (size_t)fprintf(file, "\n");
+        for (; written < byte_count;) {
+            uint64_t id = random_u64(&state) % 1000000000000000ull;
+            written += (size_t)fprintf(file, "%" PRIu64 "\n", id);
+        }
+    }
+}
+
+// Loops over the lines of a file and sums their lengths.
+// Pass a size like 1000000000 to loop over a 1 GB file.
+void benchmark_lines() {
+    auto file_path = "benchmark_lines.txt";
+    auto byte_count = benchmark_size(256 * 1024 * 1024);
+    write_day05_file(file_path, byte_count);
+
+    size_t expected_count = 0;
+    auto start = seconds_now();
+    READ_LINES(line, 100000, file_path) {
+        auto count = strlen(line);
+        expected_count += line[count - 1] == '\n' ? count - 1 : count;
+    }
+    print_benchmark("lines: READ_LINES bytes", seconds_now() - start, (double)byte_count);
+
+    size_t count = 0;
+    auto buffer = (StringBuilder){};
+    start = seconds_now();
+    FOR_FILE(file, file_path, "rb") {
+        FOR_EACH_STREAM_LINE(line, buffer, file) {
+            count += line.count;
+        }
+    }
+    print_benchmark("lines: FOR_EACH_STREAM_LINE bytes", seconds_now() - start, (double)byte_count);
+    CHECK_INTERNAL(count == expected_count, "Unexpected line lengths");
+    FREE_DARRAY(buffer);
+
+    count = 0;
+    start = seconds_now();
+    auto mapped_file = MAKE_MAPPED_FILE(file_path);
+    FOR_EACH_LINE(line, mapped_file) {
+        count += line.count;
+    }
+    FREE_MAPPED_FILE(mapped_file);
+    print_benchmark("lines: MAKE_MAPPED_FILE and FOR_EACH_LINE bytes", seconds_now() - start, (double)byte_count);
+    CHECK_INTERNAL(count == expected_count, "Unexpected line lengths");
+
+    remove(file_path);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// WORDS
+
+// The byte by byte loop that carma_count_steps_until_delimiter used before memchr.
+size_t legacy_count_steps_until_delimiter(const char* begin, const char* end, char delimiter) {
+    size_t steps = 0;
+    for (const char* iterator = begin; iterator != end; ++iterator, ++steps) {
+        if (*iterator == delimiter) {
+            return steps;
+        }
+    }
+    return steps;
+}
+
+// Splits a text like the input of words.c into words, and sums their lengths.
+void benchmark_words() {
+    auto text = make_benchmark_text(benchmark_size(256 * 1024 * 1024));
+    auto view = MAKE(StringView, text.data, text.count);
+    auto bytes = (double)text.count;
+
+    size_t expected_count = 0;
+    auto start = seconds_now();
+    auto end = END_POINTER(view);
+    for (auto it = view.data; it != end;) {
+        auto count = legacy_count_steps_until_delimiter(it, end, '\n');
+        expected_count += count;
+        it += it + count == end ? count : count + 1;
+    }
+    print_benchmark("words: scalar lines bytes", seconds_now() - start, bytes);
+
+    size_t count = 0;
+    start = seconds_now();
+    FOR_EACH_WORD(line, view, '\n') {
+        count += line.count;
+    }
+    print_benchmark("words: FOR_EACH_WORD lines bytes", seconds_now() - start, bytes);
+    CHECK_INTERNAL(count == expected_count, "Unexpected word lengths");
+
+    expected_count = 0;
+    start = seconds_now();
+    FOR_EACH_WORD_PREDICATE(word, view, isspace) {
+        expected_count += word.count;
+    }
+    print_benchmark("words: FOR_EACH_WORD_PREDICATE bytes", seconds_now() - start, bytes);
+
+    count = 0;
+    auto whitespace = MAKE_CHARACTER_SET_PREDICATE(isspace);
+    start = seconds_now();
+    FOR_EACH_WORD_IN_SET(word, view, whitespace) {
+        count += word.count;
+    }
+    print_benchmark("words: FOR_EACH_WORD_IN_SET bytes", seconds_now() - start, bytes);
+    CHECK_INTERNAL(count == expected_count, "Unexpected word lengths");
+
+    FREE_DARRAY(text);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// PARSE DOUBLE
+
+// The try_parse_double before exponents and correct rounding,
+// which multiplied by 0.1 for each decimal.
+ParsedDouble legacy_try_parse_double(StringView* s) {
+    auto sign = +1.0;
+    if (STARTS_WITH_ITEM(*s, '-')) {
+        sign = -1.0;
+        DROP_FRONT(*s);
+    }
+    auto integral = 0.0;
+    auto optional_integral = try_parse_u64(s);
+    if (optional_integral.ok) {
+        integral = (double)optional_integral.value;
+    }
+    auto fractional = 0.0;
+    auto optional_fractional = MAKE(ParsedU64);
+    if (STARTS_WITH_ITEM(*s, '.')) {
+        DROP_FRONT(*s);
+        auto count = s->count;
+        optional_fractional = try_parse_u64(s);
+        if (optional_fractional.ok) {
+            fractional = (double)optional_fractional.value;
+            for (; count > s->count; --count) {
+                fractional *= 0.1;
+            }
+        }
+    }
+    auto result = MAKE(ParsedDouble);
+    if (optional_integral.ok || optional_fractional.ok) {
+        result.value = sign * (integral + fractional);
+        result.ok = true;
+    }
+    return result;
+}
+
+StringBuilder make_double_text(size_t count, const char* format) {
+    auto text = (StringBuilder){};
+    uint64_t state = 19;
+    for (size_t i = 0; i < count; ++i) {
+        auto value = (double)(random_u64(&state) >> 11) * 0x1.0p-53 * 2000.0 - 1000.0;
+        char buffer[64];
+        auto length = snprintf(buffer, sizeof(buffer), format, value);
+        CONCAT(text, MAKE(StringView, buffer, (size_t)length));
+    }
+    return text;
+}
+
+void benchmark_parse_double_format(size_t count, const char* format, const char* description) {
+    auto text = make_double_text(count, format);
+    auto view = MAKE(StringView, text.data, text.count);
+    char full_description[64];
+
+    double sum = 0.0;
+    auto start = seconds_now();
+    for (auto s = view; !IS_EMPTY(s);) {
+        sum += legacy_try_parse_double(&s).value;
+        DROP_FRONT(s);
+    }
+    snprintf(full_description, sizeof(full_description), "parse double: legacy %s", description);
+    print_benchmark(full_description, seconds_now() - start, (double)count);
+
+    start = seconds_now();
+    for (auto s = view; !IS_EMPTY(s);) {
+        sum += try_parse_double(&s).value;
+        DROP_FRONT(s);
+    }
+    snprintf(full_description, sizeof(full_description), "parse double: try_parse_double %s", description);
+    print_benchmark(full_description, seconds_now() - start, (double)count);
+
+    start = seconds_now();
+    for (char* it = text.data; it != END_POINTER(text); ++it) {
+        sum += strtod(it, &it);
+    }
+    snprintf(full_description, sizeof(full_description), "parse double: strtod %s", description);
+    print_benchmark(full_description, seconds_now() - start, (double)count);
+
+    global_benchmark_sink += (size_t)sum;
+    FREE_DARRAY(text);
+}
+
+// Pass a size like 100000000 to parse 100M doubles.
+void benchmark_parse_double() {
+    auto count = benchmark_size(10 * 1000 * 1000);
+    benchmark_parse_double_format(count, "%.17g\n", "17 digits");
+    benchmark_parse_double_format(count, "%.3f\n", "3 decimals");
+    benchmark_parse_double_format(count, "%.6e\n", "exponent");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// PARSE INTEGER
+
+// The try_parse_u64 before parsing eight digits at a time,
+// which did not detect overflow.
+ParsedU64 legacy_try_parse_u64(StringView* s) {
+    auto result = MAKE(ParsedU64);
+    while (!IS_EMPTY(*s) && is_digit(FIRST_ITEM(*s))) {
+        result.value *= 10;
+        result.value += FIRST_ITEM(*s) - '0';
+        DROP_FRONT(*s);
+        result.ok = true;
+    }
+    return result;
+}
+
+StringBuilder make_integer_text(size_t count, uint64_t modulo) {
+    auto text = (StringBuilder){};
+    uint64_t state = 23;
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t value = random_u64(&state) % modulo;
+        char buffer[32];
+        auto length = snprintf(buffer, sizeof(buffer), "%" PRIu64 ",", value);
+        CONCAT(text, MAKE(StringView, buffer, (size_t)length));
+    }
+    return text;
+}
+
+void benchmark_parse_integer_size(size_t count, uint64_t modulo, const char* description) {
+    auto text = make_integer_text(count, modulo);
+    auto view = MAKE(StringView, text.data, text.count);
+    auto digit_count = (double)(text.count - count);
+    char full_description[64];
+
+    uint64_t sum = 0;
+    auto start = seconds_now();
+    for (auto s = view; !IS_EMPTY(s);) {
+        sum += legacy_try_parse_u64(&s).value;
+        DROP_FRONT(s);
+    }
+    snprintf(full_description, sizeof(full_description), "parse integer: legacy %s digits", description);
+    print_benchmark(full_description, seconds_now() - start, digit_count);
+
+    start = seconds_now();
+    for (auto s = view; !IS_EMPTY(s);) {
+        sum += try_parse_u64(&s).value;
+        DROP_FRONT(s);
+    }
+    snprintf(full_description, sizeof(full_description), "parse integer: try_parse_u64 %s digits", description);
+    print_benchmark(full_description, seconds_now() - start, digit_count);
+
+    start = seconds_now();
+    for (char* it = text.data; it != END_POINTER(text); ++it) {
+        sum += strtoull(it, &it, 10);
+    }
+    snprintf(full_description, sizeof(full_description), "parse integer: strtoull %s digits", description);
+    print_benchmark(full_description, seconds_now() - start, digit_count);
+
+    global_benchmark_sink += (size_t)sum;
+    FREE_DARRAY(text);
+}
+
+// Pass a size like 100000000 to parse 100M integers.
+// Reports parsed digits per second.
+void benchmark_parse_integer() {
+    auto count = benchmark_size(10 * 1000 * 1000);
+    benchmark_parse_integer_size(count, 10000ull, "small");
+    benchmark_parse_integer_size(count, 10000000000000000000ull, "large");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SERIALIZE DOUBLE
+
+// The SERIALIZE_DOUBLE before the shortest round trip formatting,
+// which wrote 6 decimals one character at a time.
+#define LEGACY_SERIALIZE_DOUBLE(string_builder, x) do { \
+    double _x = (double)(x); \
+    if (_x != _x) { \
+        SERIALIZE_CSTRING((string_builder), "nan"); \
+    } else if (_x == 1.0 / 0.0) { \
+        SERIALIZE_CSTRING((string_builder), "inf"); \
+    } else if (_x == -1.0 / 0.0) { \
+        SERIALIZE_CSTRING((string_builder), "-inf"); \
+    } else if ((double)INTMAX_MIN <= _x && _x <= (double)INTMAX_MAX && _x == (double)(intmax_t)_x) { \
+        SERIALIZE_INTEGRAL((string_builder), (intmax_t)_x); \
+    } else { \
+        if (_x < 0) { \
+            APPEND((string_builder), '-'); \
+            _x = -_x; \
+        } \
+        size_t _int_digits = 1; \
+        for (double _t = _x; _t >= 10.0; _t /= 10.0) _int_digits++; \
+        double _scale = 1.0; \
+        for (size_t _i = 0; _i + 1 < _int_digits; _i++) _scale *= 10.0; \
+        double _d = _x / _scale; \
+        for (size_t _i = 0; _i < _int_digits + 6; _i++) { \
+            if (_i == _int_digits) APPEND((string_builder), '.'); \
+            int _digit = (int)_d; \
+            APPEND((string_builder), '0' + _digit); \
+            _d = (_d - _digit) * 10.0; \
+        } \
+    } \
+    APPEND(string_builder, '\0'); \
+    DROP_BACK(string_builder); \
+} while(0)
+
+void benchmark_serialize_double_values(DoubleArray values, const char* description) {
+    char full_description[64];
+
+    auto json = (JsonBuilder){};
+    auto start = seconds_now();
+    ADD_JSON_ARRAY(json) {
+        FOR_EACH(value, values) {
+            carma_handle_json_array_delimiter(&json);
+            LEGACY_SERIALIZE_DOUBLE(json.string, *value);
+        }
+    }
+    snprintf(full_description, sizeof(full_description), "serialize double: legacy %s", description);
+    print_benchmark(full_description, seconds_now() - start, (double)values.count);
+    auto legacy_count = json.string.count;
+    FREE_JSON_BUILDER(json);
+
+    json = (JsonBuilder){};
+    start = seconds_now();
+    ADD_JSON_ARRAY(json) {
+        FOR_EACH(value, values) {
+            ADD_JSON_DOUBLE(json, *value);
+        }
+    }
+    snprintf(full_description, sizeof(full_description), "serialize double: ADD_JSON_DOUBLE %s", description);
+    print_benchmark(full_description, seconds_now() - start, (double)values.count);
+    printf("%-48s %10.1f bytes/item %10.1f legacy\n", "serialize double: size",
+        (double)json.string.count / (double)values.count, (double)legacy_count / (double)values.count);
+    FREE_JSON_BUILDER(json);
+
+    json = (JsonBuilder){};
+    start = seconds_now();
+    ADD_JSON_DOUBLE_ARRAY(json, values);
+    snprintf(full_description, sizeof(full_description), "serialize double: ADD_JSON_DOUBLE_ARRAY %s", description);
+    print_benchmark(full_description, seconds_now() - start, (double)values.count);
+    FREE_JSON_BUILDER(json);
+
+    auto text = (StringBuilder){};
+    start = seconds_now();
+    FOR_EACH(value, values) {
+        RESERVE_EXPONENTIAL_GROWTH(text, text.count + 32);
+        text.count += (size_t)snprintf(END_POINTER(text), 32, "%.17g,", *value);
+    }
+    snprintf(full_description, sizeof(full_description), "serialize double: snprintf %%.17g %s", description);
+    print_benchmark(full_description, seconds_now() - start, (double)values.count);
+    FREE_DARRAY(text);
+}
+
+// Pass a size like 100000000 to serialize 100M doubles.
+void benchmark_serialize_double() {
+    auto count = benchmark_size(10 * 1000 * 1000);
+    auto values = (DoubleArray){};
+    uint64_t state = 29;
+    for (size_t i = 0; i < count; ++i) {
+        APPEND(values, (double)(random_u64(&state) >> 11) * 0x1.0p-53 * 2000.0 - 1000.0);
+    }
+    benchmark_serialize_double_values(values, "random");
+    FOR_EACH(value, values) {
+        *value = (double)(int)(*value * 1000.0) / 1000.0;
+    }
+    benchmark_serialize_double_values(values, "3 decimals");
+    FREE_DARRAY(values);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SERIALIZE INTEGER
+
+// The SERIALIZE_INTEGRAL before writing two digits at a time,
+// which appended one digit at a time and then reversed them.
+#define LEGACY_SERIALIZE_INTEGRAL(string_builder, x) do { \
+    CARMA_AUTO _si_x = (x); \
+    if (_si_x < 0) { \
+        _si_x = -_si_x; \
+        APPEND((string_builder), '-'); \
+    } \
+    CARMA_AUTO _front = (string_builder).count; \
+    do { \
+        APPEND((string_builder), (char)('0' + _si_x % 10)); \
+        _si_x /= 10; \
+    } while (_si_x > 0); \
+    for (CARMA_AUTO _si_back = (string_builder).count - 1; _front < _si_back; _front++, _si_back--) { \
+        SWAP((string_builder).data[_front], (string_builder).data[_si_back]); \
+    } \
+    APPEND(string_builder, '\0'); \
+    DROP_BACK(string_builder); \
+} while(0)
+
+typedef struct I64Array {
+    int64_t* data;
+    size_t count;
+    size_t capacity;
+} I64Array;
+
+void benchmark_serialize_integer_values(I64Array values, const char* description) {
+    char full_description[64];
+
+    auto json = (JsonBuilder){};
+    auto start = seconds_now();
+    ADD_JSON_ARRAY(json) {
+        FOR_EACH(value, values) {
+            carma_handle_json_array_delimiter(&json);
+            LEGACY_SERIALIZE_INTEGRAL(json.string, *value);
+        }
+    }
+    snprintf(full_description, sizeof(full_description), "serialize integer: legacy %s", description);
+    print_benchmark(full_description, seconds_now() - start, (double)values.count);
+    FREE_JSON_BUILDER(json);
+
+    json = (JsonBuilder){};
+    start = seconds_now();
+    ADD_JSON_ARRAY(json) {
+        FOR_EACH(value, values) {
+            ADD_JSON_INT(json, *value);
+        }
+    }
+    snprintf(full_description, sizeof(full_description), "serialize integer: ADD_JSON_INT %s", description);
+    print_benchmark(full_description, seconds_now() - start, (double)values.count);
+    FREE_JSON_BUILDER(json);
+
+    json = (JsonBuilder){};
+    start = seconds_now();
+    ADD_JSON_INT_ARRAY(json, values);
+    snprintf(full_description, sizeof(full_description), "serialize integer: ADD_JSON_INT_ARRAY %s", description);
+    print_benchmark(full_description, seconds_now() - start, (double)values.count);
+    FREE_JSON_BUILDER(json);
+
+    auto text = (StringBuilder){};
+    start = seconds_now();
+    FOR_EACH(value, values) {
+        RESERVE_EXPONENTIAL_GROWTH(text, text.count + 32);
+        text.count += (size_t)snprintf(END_POINTER(text), 32, "%" PRId64 ",", *value);
+    }
+    snprintf(full_description, sizeof(full_description), "serialize integer: snprintf %s", description);
+    print_benchmark(full_description, seconds_now() - start, (double)values.count);
+    FREE_DARRAY(text);
+}
+
+// Pass a size like 100000000 to serialize 100M integers.
+void benchmark_serialize_integer() {
+    auto count = benchmark_size(10 * 1000 * 1000);
+    auto values = (I64Array){};
+    uint64_t state = 31;
+    for (size_t i = 0; i < count; ++i) {
+        APPEND(values, (int64_t)(random_u64(&state) % 2000) - 1000);
+    }
+    benchmark_serialize_integer_values(values, "small");
+    FOR_EACH(value, values) {
+        *value = (int64_t)random_u64(&state);
+    }
+    benchmark_serialize_integer_values(values, "large");
+    FREE_DARRAY(values);
+}
+
+// Pass a size like 100000000 to serialize 100M pixels.
+void benchmark_serialize_pixels() {
+    auto pixels = (ByteArray){};
+    RESERVE(pixels, benchmark_size(1920 * 1080 * 3));
+    pixels.count = pixels.capacity;
+    uint64_t state = 31;
+    FOR_EACH(pixel, pixels) {
+        *pixel = (uint8_t)random_u64(&state);
+    }
+    auto json = (JsonBuilder){};
+    auto start = seconds_now();
+    ADD_JSON_ARRAY(json) {
+        FOR_EACH(pixel, pixels) {
+            ADD_JSON_INT(json, *pixel);
+        }
+    }
+    print_benchmark("serialize pixels: ADD_JSON_INT", seconds_now() - start, (double)pixels.count);
+    FREE_JSON_BUILDER(json);
+
+    json = (JsonBuilder){};
+    start = seconds_now();
+    ADD_JSON_INT_ARRAY(json, pixels);
+    print_benchmark("serialize pixels: ADD_JSON_INT_ARRAY", seconds_now() - start, (double)pixels.count);
+    global_benchmark_sink += json.string.count;
+    FREE_JSON_BUILDER(json);
+    FREE_DARRAY(pixels);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SERIALIZE STRING
+
+// The ADD_JSON_CSTRING before escaping, which made invalid json for quotes, backslashes and control characters.
+#define LEGACY_ADD_JSON_CSTRING(json, s) do { \
+    carma_handle_json_array_delimiter(&(json)); \
+    SERIALIZE_CHARACTER((json).string, '"'); \
+    SERIALIZE_CSTRING((json).string, (s)); \
+    SERIALIZE_CHARACTER((json).string, '"'); \
+} while(0)
+
+// Escapes one character at a time, to compare with the escaping that copies runs of characters.
+void add_json_string_per_character(JsonBuilder* json, StringView s) {
+    carma_handle_json_array_delimiter(json);
+    APPEND(json->string, '"');
+    FOR_EACH(c, s) {
+        if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20) {
+            RESERVE_EXPONENTIAL_GROWTH(json->string, json->string.count + 6);
+            json->string.count += carma_write_json_escape(END_POINTER(json->string), *c);
+        } else {
+            APPEND(json->string, *c);
+        }
+    }
+    SERIALIZE_CHARACTER(json->string, '"');
+}
+
+// Makes null terminated log messages of 40 to 200 characters, where every tenth has a quote or a line break.
+StringBuilder make_log_messages(size_t count, StringViews* messages) {
+    auto text = (StringBuilder){};
+    uint64_t state = 53;
+    const char* words[] = {"request", "user", "failed", "took", "ms", "id=42", "GET", "/api/items", "retry", "ok"};
+    for (size_t i = 0; i < count; ++i) {
+        auto length = 40 + random_u64(&state) % 160;
+        auto begin = text.count;
+        while (text.count - begin < length) {
+            auto word = words[random_u64(&state) % 10];
+            SERIALIZE_CSTRING(text, word);
+            APPEND(text, ' ');
+        }
+        if (i % 10 == 0) {
+            SERIALIZE_CSTRING(text, i % 20 == 0 ? "\"quoted\"" : "\nline");
+        }
+        APPEND(text, '\0');
+    }
+    // Point to the messages after the text is done growing:
+    for (size_t begin = 0; begin < text.count;) {
+        auto length = strlen(text.data + begin);
+        APPEND(*messages, MAKE(StringView, text.data + begin, length));
+        begin += length + 1;
+    }
+    return text;
+}
+
+void benchmark_serialize_string() {
+    auto messages = (StringViews){};
+    auto text = make_log_messages(benchmark_size(1000000), &messages);
+    auto megabytes = (double)(text.count - messages.count) / 1e6;
+    printf("serialize string: %zu log messages of %.1f MB\n", messages.count, megabytes);
+
+    auto json = (JsonBuilder){};
+    auto start = seconds_now();
+    ADD_JSON_ARRAY(json) {
+        FOR_EACH(message, messages) {
+            LEGACY_ADD_JSON_CSTRING(json, message->data);
+        }
+    }
+    print_benchmark("serialize string: legacy without escaping", seconds_now() - start, megabytes);
+    FREE_JSON_BUILDER(json);
+
+    json = (JsonBuilder){};
+    start = seconds_now();
+    ADD_JSON_ARRAY(json) {
+        FOR_EACH(message, messages) {
+            add_json_string_per_character(&json, *message);
+        }
+    }
+    print_benchmark("serialize string: escaping per character", seconds_now() - start, megabytes);
+    FREE_JSON_BUILDER(json);
+
+    json = (JsonBuilder){};
+    start = seconds_now();
+    ADD_JSON_ARRAY(json) {
+        FOR_EACH(message, messages) {
+            ADD_JSON_CSTRING(json, message->data);
+        }
+    }
+    print_benchmark("serialize string: ADD_JSON_CSTRING", seconds_now() - start, megabytes);
+    FREE_JSON_BUILDER(json);
+
+    json = (JsonBuilder){};
+    start = seconds_now();
+    ADD_JSON_ARRAY(json) {
+        FOR_EACH(message, messages) {
+            ADD_JSON_STRING_VIEW(json, *message);
+        }
+    }
+    print_benchmark("serialize string: ADD_JSON_STRING_VIEW", seconds_now() - start, megabytes);
+    global_benchmark_sink += json.string.count;
+    FREE_JSON_BUILDER(json);
+
+    FREE_DARRAY(messages);
+    FREE_DARRAY(text);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// JSON INDEX
+
+// Makes a json object with an array of records, followed by some keys at the end.
+StringBuilder make_json_document(size_t min_size) {
+    auto json = (StringBuilder){};
+    uint64_t state = 37;
+    char buffer[256];
+    SERIALIZE_CSTRING(json, "{\"version\": 3, \"records\": [");
+    size_t record_count = 0;
+    for (; json.count < min_size; ++record_count) {
+        auto id = random_u64(&state) % 1000000000;
+        auto length = snprintf(buffer, sizeof(buffer),
+            "%s{\"id\": %" PRIu64 ", \"name\": \"user \\\"%" PRIu64 "\\\"\", \"tags\": [\"a\", \"b\", \"c\"], "
+            "\"position\": {\"x\": %d, \"y\": %d}, \"score\": %d}",
+            record_count == 0 ? "" : ",\n", id, id % 1000, (int)(id % 640), (int)(id % 480), (int)(id % 100));
+        CONCAT(json, MAKE(StringView, buffer, (size_t)length));
+    }
+    auto length = snprintf(buffer, sizeof(buffer), "], \"count\": %zu, \"checksum\": 12345}", record_count);
+    CONCAT(json, MAKE(StringView, buffer, (size_t)length));
+    return json;
+}
+
+// Pass a size like 1000000000 to parse a 1 GB json document.
+void benchmark_json_index() {
+    auto text = make_json_document(benchmark_size(100 * 1000 * 1000));
+    auto json = MAKE(StringView, text.data, text.count);
+    auto megabytes = (double)text.count / 1e6;
+    printf("json index: document of %.1f MB\n", megabytes);
+
+    // Looking up keys after a big array:
+    auto start = seconds_now();
+    uint64_t sum = (uint64_t)PARSE_JSON_KEY_INT(json, "count") + (uint64_t)PARSE_JSON_KEY_INT(json, "checksum");
+    print_benchmark("json index: 2 keys with parse_json_key", seconds_now() - start, megabytes);
+
+    start = seconds_now();
+    auto index = MAKE_JSON_INDEX(json);
+    auto build_seconds = seconds_now() - start;
+    print_benchmark("json index: MAKE_JSON_INDEX", build_seconds, megabytes);
+    printf("%-48s %10zu tokens %10.1f bytes/token\n", "json index: size",
+        index.count, (double)(index.count * sizeof(JsonToken)) / (double)index.count);
+
+    start = seconds_now();
+    sum += (uint64_t)PARSE_JSON_KEY_INT_INDEXED(index, json, "count") + (uint64_t)PARSE_JSON_KEY_INT_INDEXED(index, json, "checksum");
+    print_benchmark("json index: 2 keys with index", seconds_now() - start, megabytes);
+
+    // Reading some keys of every record:
+    start = seconds_now();
+    auto records = PARSE_JSON_KEY(json, "records");
+    FOR_EACH_JSON_ARRAY_ITEM(record, records) {
+        auto position = PARSE_JSON_KEY(record, "position");
+        sum += (uint64_t)PARSE_JSON_KEY_INT(record, "score") + (uint64_t)PARSE_JSON_KEY_INT(position, "x");
+    }
+    print_benchmark("json index: records with parse_json_key", seconds_now() - start, megabytes);
+
+    start = seconds_now();
+    records = PARSE_JSON_KEY_INDEXED(index, json, "records");
+    FOR_EACH_JSON_ARRAY_ITEM_INDEXED(record, index, records) {
+        auto position = PARSE_JSON_KEY_INDEXED(index, record, "position");
+        sum += (uint64_t)PARSE_JSON_KEY_INT_INDEXED(index, record, "score") + (uint64_t)PARSE_JSON_KEY_INT_INDEXED(index, position, "x");
+    }
+    auto query_seconds = seconds_now() - start;
+    print_benchmark("json index: records with index", query_seconds, megabytes);
+    print_benchmark("json index: records with index and building", build_seconds + query_seconds, megabytes);
+
+    global_benchmark_sink += (size_t)sum;
+    FREE_JSON_INDEX(index);
+    FREE_DARRAY(text);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// JSON STREAM
+
+// Pass a size like 1000000000 to stream a 1 GB json file.
+void benchmark_json_stream() {
+    auto text = make_json_document(benchmark_size(100 * 1000 * 1000));
+    auto megabytes = (double)text.count / 1e6;
+    auto file = tmpfile();
+    fwrite(text.data, 1, text.count, file);
+    FREE_DARRAY(text);
+    printf("json stream: file of %.1f MB\n", megabytes);
+
+    rewind(file);
+    auto start = seconds_now();
+    auto read_text = (StringBuilder){};
+    READ_STREAM(read_text, file);
+    auto json = MAKE(StringView, read_text.data, read_text.count);
+    uint64_t sum = 0;
+    auto records = PARSE_JSON_KEY(json, "records");
+    FOR_EACH_JSON_ARRAY_ITEM(record, records) {
+        sum += (uint64_t)PARSE_JSON_KEY_INT(record, "score");
+    }
+    print_benchmark("json stream: READ_STREAM and parse_json_key", seconds_now() - start, megabytes);
+    printf("%-48s %10.1f MB\n", "json stream: memory with READ_STREAM", (double)read_text.capacity / 1e6);
+    FREE_DARRAY(read_text);
+
+    rewind(file);
+    start = seconds_now();
+    auto stream = MAKE_JSON_STREAM();
+    auto is_score = false;
+    FOR_EACH_JSON_FILE_EVENT(event, stream, file) {
+        if (is_score && event.type == JSON_EVENT_SCALAR) {
+            sum += (uint64_t)PARSE_INT(event.value);
+        }
+        is_score = event.type == JSON_EVENT_KEY && ARE_EQUAL(event.value, STRING_LITERAL("score"));
+    }
+    print_benchmark("json stream: FOR_EACH_JSON_FILE_EVENT", seconds_now() - start, megabytes);
+    auto memory = stream.chunk.capacity + stream.token.capacity + stream.stack.capacity;
+    printf("%-48s %10.1f MB\n", "json stream: memory with stream", (double)memory / 1e6);
+
+    global_benchmark_sink += (size_t)sum;
+    FREE_JSON_STREAM(stream);
+    fclose(file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// JSON VALIDATION
+
+// Pass a size like 1000000000 to validate a 1 GB json document.
+void benchmark_json_validation() {
+    auto text = make_json_document(benchmark_size(100 * 1000 * 1000));
+    auto json = MAKE(StringView, text.data, text.count);
+    auto megabytes = (double)text.count / 1e6;
+    printf("json validation: document of %.1f MB\n", megabytes);
+
+    auto start = seconds_now();
+    auto s = json;
+    auto object = PARSE_JSON_OBJECT(s);
+    print_benchmark("json validation: PARSE_JSON_OBJECT", seconds_now() - start, megabytes);
+
+    start = seconds_now();
+    auto validation = VALIDATE_JSON(json);
+    print_benchmark("json validation: VALIDATE_JSON", seconds_now() - start, megabytes);
+
+    start = seconds_now();
+    auto index = MAKE_JSON_INDEX(json);
+    print_benchmark("json validation: MAKE_JSON_INDEX", seconds_now() - start, megabytes);
+
+    global_benchmark_sink += object.count + validation.error_offset + validation.ok + index.count;
+    FREE_JSON_INDEX(index);
+    FREE_DARRAY(text);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// PARSE STRING
+
+// The parse_quoted_string before finding quotes and backslashes 16 bytes at a time.
+StringView legacy_parse_quoted_string(StringView* s) {
+    if (!STARTS_WITH_ITEM(*s, '"')) {
+        return MAKE(StringView);
+    }
+    auto remaining = *s;
+    DROP_FRONT(remaining);
+    StringView value = {remaining.data, 0};
+    while (!IS_EMPTY(remaining)) {
+        if (FIRST_ITEM(remaining) == '"') {
+            DROP_FRONT(remaining);
+            *s = remaining;
+            return value;
+        }
+        else if (FIRST_ITEM(remaining) == '\\') {
+            DROP_FRONT(remaining);
+            value.count++;
+            if (IS_EMPTY(remaining)) {
+                return value;
+            }
+            DROP_FRONT(remaining);
+            value.count++;
+        }
+        else {
+            DROP_FRONT(remaining);
+            value.count++;
+        }
+    }
+    return value;
+}
+
+// Makes quoted strings of 4 to 200 characters, where some have escapes, separated by commas.
+StringBuilder make_string_text(size_t min_size) {
+    auto text = (StringBuilder){};
+    uint64_t state = 41;
+    const char* escapes[] = {"\\n", "\\\"", "\\\\", "\\u00e9", "\\uD83D\\uDE00"};
+    while (text.count < min_size) {
+        APPEND(text, '"');
+        auto length = 4 + random_u64(&state) % 196;
+        for (size_t i = 0; i < length; ++i) {
+            auto r = random_u64(&state);
+            if (r % 64 == 0) {
+                SERIALIZE_CSTRING(text, escapes[(r >> 8) % 5]);
+            } else {
+                APPEND(text, (char)('a' + (r >> 8) % 26));
+            }
+        }
+        APPEND(text, '"');
+        APPEND(text, ',');
+    }
+    return text;
+}
+
+// Pass a size like 1000000000 to parse 1 GB of strings.
+void benchmark_parse_string() {
+    auto text = make_string_text(benchmark_size(50 * 1000 * 1000));
+    auto view = MAKE(StringView, text.data, text.count);
+    auto megabytes = (double)text.count / 1e6;
+    printf("parse string: %.1f MB of strings\n", megabytes);
+
+    size_t sum = 0;
+    auto start = seconds_now();
+    for (auto s = view; !IS_EMPTY(s);) {
+        sum += legacy_parse_quoted_string(&s).count;
+        DROP_FRONT(s);
+    }
+    print_benchmark("parse string: legacy parse_quoted_string", seconds_now() - start, megabytes);
+
+    start = seconds_now();
+    for (auto s = view; !IS_EMPTY(s);) {
+        sum += PARSE_QUOTED_STRING(s).count;
+        DROP_FRONT(s);
+    }
+    print_benchmark("parse string: PARSE_QUOTED_STRING", seconds_now() - start, megabytes);
+
+    start = seconds_now();
+    auto decoded = (StringBuilder){};
+    for (auto s = view; !IS_EMPTY(s);) {
+        CLEAR(decoded);
+        sum += UNESCAPE_JSON_STRING(decoded, PARSE_QUOTED_STRING(s));
+        sum += decoded.count;
+        DROP_FRONT(s);
+    }
+    print_benchmark("parse string: with UNESCAPE_JSON_STRING", seconds_now() - start, megabytes);
+
+    start = seconds_now();
+    for (auto s = view; !IS_EMPTY(s);) {
+        sum += UNESCAPE_JSON_STRING_IN_PLACE(PARSE_QUOTED_STRING(s)).count;
+        DROP_FRONT(s);
+    }
+    print_benchmark("parse string: with UNESCAPE_JSON_STRING_IN_PLACE", seconds_now() - start, megabytes);
+
+    global_benchmark_sink += sum;
+    FREE_DARRAY(decoded);
+    FREE_DARRAY(text);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// PARALLEL
+
+// A few hundred nanoseconds of floating point work per item, like shading a pixel.
+double parallel_work(double x) {
+    for (int i = 0; i < 64; ++i) {
+        x = sqrt(x * x + 1.0);
+    }
+    return x;
+}
+
+void parallel_work_item(void* item, void* context) {
+    (void)context;
+    double* x = item;
+    *x = parallel_work(*x);
+}
+
+void parallel_empty_chunk(void* task, size_t chunk_index, size_t begin, size_t end) {
+    (void)task;
+    (void)chunk_index;
+    (void)begin;
+    (void)end;
+}
+
+void benchmark_parallel_threads(DoubleArray values, size_t thread_count) {
+    char description[64];
+    auto pool = MAKE_THREAD_POOL(thread_count);
+    auto start = seconds_now();
+    PARALLEL_FOR_EACH(pool, values, parallel_work_item, NULL);
+    snprintf(description, sizeof(description), "parallel: PARALLEL_FOR_EACH %zu threads", pool->thread_count);
+    print_benchmark(description, seconds_now() - start, (double)values.count);
+
+    // One empty chunk per thread measures the cost of starting a loop and waiting for the threads.
+    auto loop_count = 10000;
+    start = seconds_now();
+    for (int i = 0; i < loop_count; ++i) {
+        parallel_for_chunks(pool, pool->thread_count, 1, parallel_empty_chunk, NULL);
+    }
+    snprintf(description, sizeof(description), "parallel: empty loop %zu threads", pool->thread_count);
+    print_benchmark(description, seconds_now() - start, (double)loop_count);
+    FREE_THREAD_POOL(pool);
+}
+
+void benchmark_parallel() {
+    auto values = (DoubleArray){};
+    RESERVE(values, benchmark_size(4 * 1000 * 1000));
+    values.count = values.capacity;
+    FOR_INDEX(i, values) {
+        values.data[i] = (double)i;
+    }
+    auto start = seconds_now();
+    FOR_EACH(value, values) {
+        *value = parallel_work(*value);
+    }
+    print_benchmark("parallel: FOR_EACH", seconds_now() - start, (double)values.count);
+    benchmark_parallel_threads(values, 1);
+    benchmark_parallel_threads(values, 2);
+    benchmark_parallel_threads(values, 4);
+    benchmark_parallel_threads(values, 0);
+    global_benchmark_sink += (size_t)values.data[values.count / 2];
+    FREE_DARRAY(values);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// REDUCE
+
+void benchmark_reduce_threads(DoubleArray values, I64Array integers, size_t thread_count) {
+    char description[64];
+    auto pool = MAKE_THREAD_POOL(thread_count);
+    auto start = seconds_now();
+    auto sum = PARALLEL_SUM(pool, values);
+    snprintf(description, sizeof(description), "reduce double: PARALLEL_SUM %zu threads", pool->thread_count);
+    print_benchmark(description, seconds_now() - start, (double)values.count);
+    global_benchmark_sink += (size_t)sum;
+
+    start = seconds_now();
+    auto max = PARALLEL_MAX(pool, values);
+    snprintf(description, sizeof(description), "reduce double: PARALLEL_MAX %zu threads", pool->thread_count);
+    print_benchmark(description, seconds_now() - start, (double)values.count);
+    global_benchmark_sink += (size_t)max;
+
+    start = seconds_now();
+    auto integer_sum = PARALLEL_SUM(pool, integers);
+    snprintf(description, sizeof(description), "reduce int64: PARALLEL_SUM %zu threads", pool->thread_count);
+    print_benchmark(description, seconds_now() - start, (double)integers.count);
+    global_benchmark_sink += (size_t)integer_sum;
+    FREE_THREAD_POOL(pool);
+}
+
+// Pass a size like 100000000 to reduce 100M items.
+void benchmark_reduce() {
+    auto values = (DoubleArray){};
+    auto integers = (I64Array){};
+    RESERVE(values, benchmark_size(20 * 1000 * 1000));
+    RESERVE(integers, values.capacity);
+    values.count = values.capacity;
+    integers.count = integers.capacity;
+    uint64_t state = 17;
+    FOR_INDEX(i, values) {
+        integers.data[i] = (int64_t)(random_u64(&state) % 1000000);
+        values.data[i] = (double)integers.data[i] * 0.001;
+    }
+
+    auto start = seconds_now();
+    auto loop_sum = 0.0;
+    FOR_EACH(value, values) {
+        loop_sum += *value;
+    }
+    print_benchmark("reduce double: FOR_EACH sum", seconds_now() - start, (double)values.count);
+
+    start = seconds_now();
+    REDUCE(sum, values, 0.0, CARMA_ADD);
+    print_benchmark("reduce double: REDUCE sum", seconds_now() - start, (double)values.count);
+
+    start = seconds_now();
+    REDUCE_LANES(lanes_sum, values, 0.0, CARMA_ADD);
+    print_benchmark("reduce double: REDUCE_LANES sum", seconds_now() - start, (double)values.count);
+
+    start = seconds_now();
+    auto max = 0.0;
+    FOR_MAX(it, values) {
+        max = *it;
+    }
+    print_benchmark("reduce double: FOR_MAX", seconds_now() - start, (double)values.count);
+
+    start = seconds_now();
+    REDUCE_LANES(lanes_max, values, values.data[0], CARMA_MAX);
+    print_benchmark("reduce double: REDUCE_LANES max", seconds_now() - start, (double)values.count);
+
+    start = seconds_now();
+    int64_t integer_sum = 0;
+    FOR_EACH(integer, integers) {
+        integer_sum += *integer;
+    }
+    print_benchmark("reduce int64: FOR_EACH sum", seconds_now() - start, (double)integers.count);
+
+    global_benchmark_sink += (size_t)(loop_sum + sum + lanes_sum + max + lanes_max) + (size_t)integer_sum;
+    benchmark_reduce_threads(values, integers, 1);
+    benchmark_reduce_threads(values, integers, 4);
+    benchmark_reduce_threads(values, integers, 0);
+    FREE_DARRAY(values);
+    FREE_DARRAY(integers);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// COPY AND FILL
+
+#define LEGACY_FILL(range, value) FOR_EACH(it, (range)) *it = (value)
+
+#define LEGACY_COPY(source_range, target_range) do { \
+    FOR_EACH2(_source, _target, (source_range), (target_range)) \
+        *_target = *_source; \
+} while (0)
+
+#define LEGACY_COPY_BACKWARD(source_range, target_range) do { \
+    FOR_EACH_BACKWARD2(_source, _target, (source_range), (target_range)) \
+        *_target = *_source; \
+} while (0)
+
+void print_bandwidth(const char* description, double seconds, double byte_count) {
+    printf("%-48s %10.3f ms %10.2f GB/s\n", description, seconds * 1000, byte_count / seconds * 1e-9);
+}
+
+// Copies and fills repeat until about 4 GB have been written, so that small sizes are timed from the cache.
+void benchmark_copy_fill_size(size_t byte_count) {
+    char description[64];
+    auto source = (U64Array){};
+    auto target = (U64Array){};
+    INIT_DARRAY(source, byte_count / sizeof(uint64_t), byte_count / sizeof(uint64_t));
+    INIT_DARRAY(target, source.count, source.count);
+    FOR_INDEX(i, source) {
+        source.data[i] = i;
+    }
+    // Touch the target so that page faults are not timed.
+    memset(target.data, 1, byte_count);
+    auto repeats = (size_t)4e9 / byte_count + 1;
+    auto total = (double)(repeats * byte_count);
+
+    auto start = seconds_now();
+    for (size_t i = 0; i < repeats; ++i) {
+        LEGACY_COPY(source, target);
+        global_benchmark_sink += target.data[i % target.count];
+    }
+    snprintf(description, sizeof(description), "copy: legacy COPY %zu KiB", byte_count / 1024);
+    print_bandwidth(description, seconds_now() - start, total);
+
+    start = seconds_now();
+    for (size_t i = 0; i < repeats; ++i) {
+        COPY(source, target);
+        global_benchmark_sink += target.data[i % target.count];
+    }
+    snprintf(description, sizeof(description), "copy: COPY %zu KiB", byte_count / 1024);
+    print_bandwidth(description, seconds_now() - start, total);
+
+    // Moves all items one step to the end, like INSERT_INDEX at the front.
+    auto tail = SUB_RANGE(target, 1, target.count - 1);
+    auto head = SUB_RANGE(target, 0, target.count - 1);
+    start = seconds_now();
+    for (size_t i = 0; i < repeats; ++i) {
+        LEGACY_COPY_BACKWARD(head, tail);
+        global_benchmark_sink += target.data[i % target.count];
+    }
+    snprintf(description, sizeof(description), "copy: legacy COPY_BACKWARD %zu KiB", byte_count / 1024);
+    print_bandwidth(description, seconds_now() - start, total);
+
+    start = seconds_now();
+    for (size_t i = 0; i < repeats; ++i) {
+        COPY_BACKWARD(head, tail);
+        global_benchmark_sink += target.data[i % target.count];
+    }
+    snprintf(description, sizeof(description), "copy: COPY_BACKWARD %zu KiB", byte_count / 1024);
+    print_bandwidth(description, seconds_now() - start, total);
+
+    start = seconds_now();
+    for (size_t i = 0; i < repeats; ++i) {
+        LEGACY_FILL(target, i);
+        global_benchmark_sink += target.data[i % target.count];
+    }
+    snprintf(description, sizeof(description), "fill: legacy FILL %zu KiB", byte_count / 1024);
+    print_bandwidth(description, seconds_now() - start, total);
+
+    start = seconds_now();
+    for (size_t i = 0; i < repeats; ++i) {
+        FILL(target, i);
+        global_benchmark_sink += target.data[i % target.count];
+    }
+    snprintf(description, sizeof(description), "fill: FILL %zu KiB", byte_count / 1024);
+    print_bandwidth(description, seconds_now() - start, total);
+
+    FREE_DARRAY(source);
+    FREE_DARRAY(target);
+}
+
+void benchmark_erase_many_ordered() {
+    auto values = (U64Array){};
+    auto count = benchmark_size(1000 * 1000);
+    for (size_t i = 0; i < count; ++i) {
+        APPEND(values, i);
+    }
+    auto erase_count = (size_t)0;
+    auto start = seconds_now();
+    while (values.count > 16) {
+        ERASE_MANY_ORDERED(values, 0, 16);
+        erase_count++;
+        if (erase_count == 2000) {
+            break;
+        }
+    }
+    print_benchmark("copy: ERASE_MANY_ORDERED front", seconds_now() - start, (double)erase_count);
+
+    auto insert_values = (U64Array){};
+    for (size_t i = 0; i < 16; ++i) {
+        APPEND(insert_values, i);
+    }
+    start = seconds_now();
+    for (size_t i = 0; i < erase_count; ++i) {
+        INSERT_RANGE(values, 0, insert_values);
+    }
+    print_benchmark("copy: INSERT_RANGE front", seconds_now() - start, (double)erase_count);
+    global_benchmark_sink += values.data[values.count / 2];
+    FREE_DARRAY(insert_values);
+    FREE_DARRAY(values);
+}
+
+void benchmark_copy_fill() {
+    benchmark_copy_fill_size(16 * 1024);
+    benchmark_copy_fill_size(1024 * 1024);
+    benchmark_copy_fill_size(benchmark_size(128 * 1024 * 1024));
+    benchmark_erase_many_ordered();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SORT
+
+typedef struct {
+    uint32_t* data;
+    size_t count;
+    size_t capacity;
+} U32Array;
+
+typedef struct {
+    float x;
+    float y;
+    uint32_t id;
+} SortParticle;
+
+typedef struct {
+    SortParticle* data;
+    size_t count;
+    size_t capacity;
+} SortParticles;
+
+int compare_u32(const void* a, const void* b) {
+    auto x = *(const uint32_t*)a;
+    auto y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+int compare_u64(const void* a, const void* b) {
+    auto x = *(const uint64_t*)a;
+    auto y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+int compare_particles(const void* a, const void* b) {
+    auto x = ((const SortParticle*)a)->x;
+    auto y = ((const SortParticle*)b)->x;
+    return (x > y) - (x < y);
+}
+
+#define PARTICLE_X(particle) (particle).x
+
+DEFINE_PARALLEL_SORT_BY_KEY(parallel_sort_particles, SortParticle, PARTICLE_X)
+
+// Sorts a fresh copy of the input, so that each sort gets the same unsorted items.
+#define BENCHMARK_SORT(description, input, work, ...) do { \
+    COPY((input), (work)); \
+    auto _sort_start = seconds_now(); \
+    __VA_ARGS__; \
+    print_benchmark((description), seconds_now() - _sort_start, (double)(work).count); \
+} while (0)
+
+void benchmark_sort_u32(size_t count, ThreadPool* single_pool, ThreadPool* pool) {
+    auto input = (U32Array){};
+    auto work = (U32Array){};
+    INIT_DARRAY(input, count, count);
+    INIT_DARRAY(work, count, count);
+    uint64_t state = 5;
+    FOR_EACH(item, input) {
+        *item = (uint32_t)random_u64(&state);
+    }
+    BENCHMARK_SORT("sort u32: qsort", input, work, qsort(work.data, work.count, sizeof(uint32_t), compare_u32));
+    BENCHMARK_SORT("sort u32: SORT", input, work, SORT(work, CARMA_LESS));
+    BENCHMARK_SORT("sort u32: RADIX_SORT", input, work, RADIX_SORT(work));
+    BENCHMARK_SORT("sort u32: PARALLEL_SORT 1 thread", input, work, PARALLEL_SORT(single_pool, work));
+    BENCHMARK_SORT("sort u32: PARALLEL_SORT all threads", input, work, PARALLEL_SORT(pool, work));
+    global_benchmark_sink += work.data[count / 2];
+    FREE_DARRAY(input);
+    FREE_DARRAY(work);
+}
+
+void benchmark_sort_u64(size_t count, ThreadPool* single_pool, ThreadPool* pool) {
+    auto input = (U64Array){};
+    auto work = (U64Array){};
+    INIT_DARRAY(input, count, count);
+    INIT_DARRAY(work, count, count);
+    uint64_t state = 6;
+    FOR_EACH(item, input) {
+        *item = random_u64(&state);
+    }
+    BENCHMARK_SORT("sort u64: qsort", input, work, qsort(work.data, work.count, sizeof(uint64_t), compare_u64));
+    BENCHMARK_SORT("sort u64: SORT", input, work, SORT(work, CARMA_LESS));
+    BENCHMARK_SORT("sort u64: RADIX_SORT", input, work, RADIX_SORT(work));
+    BENCHMARK_SORT("sort u64: PARALLEL_SORT 1 thread", input, work, PARALLEL_SORT(single_pool, work));
+    BENCHMARK_SORT("sort u64: PARALLEL_SORT all threads", input, work, PARALLEL_SORT(pool, work));
+    global_benchmark_sink += work.data[count / 2];
+    FREE_DARRAY(input);
+    FREE_DARRAY(work);
+}
+
+void benchmark_sort_double(size_t count, ThreadPool* single_pool, ThreadPool* pool) {
+    auto input = (DoubleArray){};
+    auto work = (DoubleArray){};
+    INIT_DARRAY(input, count, count);
+    INIT_DARRAY(work, count, count);
+    uint64_t state = 7;
+    FOR_EACH(item, input) {
+        *item = ((double)(random_u64(&state) >> 11) * 0x1.0p-53 - 0.5) * 1e6;
+    }
+    BENCHMARK_SORT("sort double: qsort", input, work, qsort(work.data, work.count, sizeof(double), compare_doubles));
+    BENCHMARK_SORT("sort double: SORT", input, work, SORT(work, CARMA_LESS));
+    BENCHMARK_SORT("sort double: RADIX_SORT", input, work, RADIX_SORT(work));
+    BENCHMARK_SORT("sort double: PARALLEL_SORT 1 thread", input, work, PARALLEL_SORT(single_pool, work));
+    BENCHMARK_SORT("sort double: PARALLEL_SORT all threads", input, work, PARALLEL_SORT(pool, work));
+    global_benchmark_sink += (size_t)work.data[count / 2];
+    FREE_DARRAY(input);
+    FREE_DARRAY(work);
+}
+
+// Structs of 12 bytes sorted by a float member.
+void benchmark_sort_particles(size_t count, ThreadPool* single_pool, ThreadPool* pool) {
+    auto input = (SortParticles){};
+    auto work = (SortParticles){};
+    INIT_DARRAY(input, count, count);
+    INIT_DARRAY(work, count, count);
+    uint64_t state = 8;
+    FOR_INDEX(i, input) {
+        input.data[i].x = (float)(random_u64(&state) >> 40) - 8e6f;
+        input.data[i].y = (float)i;
+        input.data[i].id = (uint32_t)i;
+    }
+    BENCHMARK_SORT("sort particles: qsort", input, work,
+        qsort(work.data, work.count, sizeof(SortParticle), compare_particles));
+    BENCHMARK_SORT("sort particles: SORT_BY_KEY", input, work, SORT_BY_KEY(work, PARTICLE_X));
+    BENCHMARK_SORT("sort particles: RADIX_SORT_BY_KEY", input, work, RADIX_SORT_BY_KEY(work, PARTICLE_X));
+    BENCHMARK_SORT("sort particles: parallel 1 thread", input, work,
+        parallel_sort_particles(single_pool, work.data, work.count));
+    BENCHMARK_SORT("sort particles: parallel all threads", input, work,
+        parallel_sort_particles(pool, work.data, work.count));
+    global_benchmark_sink += work.data[count / 2].id;
+    FREE_DARRAY(input);
+    FREE_DARRAY(work);
+}
+
+// Pass a size like 100000000 to sort 100M items of each type.
+void benchmark_sort() {
+    auto count = benchmark_size(1000 * 1000);
+    auto single_pool = MAKE_THREAD_POOL(1);
+    auto pool = MAKE_THREAD_POOL(0);
+    printf("sort: %zu items, %zu threads\n", count, pool->thread_count);
+    benchmark_sort_u32(count, single_pool, pool);
+    benchmark_sort_u64(count, single_pool, pool);
+    benchmark_sort_double(count, single_pool, pool);
+    benchmark_sort_particles(count, single_pool, pool);
+    FREE_THREAD_POOL(single_pool);
+    FREE_THREAD_POOL(pool);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SEARCH
+
+typedef struct {
+    uint64_t first;
+    uint64_t last;
+} BenchmarkInterval;
+
+typedef struct {
+    BenchmarkInterval* data;
+    size_t count;
+    size_t capacity;
+} BenchmarkIntervals;
+
+#define BENCHMARK_INTERVAL_FIRST(interval) (interval).first
+#define BENCHMARK_INTERVAL_LAST(interval) (interval).last
+
+// A binary search that branches on each comparison, like a hand written one.
+#define LEGACY_LOWER_BOUND(result, range, value) \
+    size_t result = 0; \
+    do { \
+        size_t _high = (range).count; \
+        while (result < _high) { \
+            size_t _middle = result + (_high - result) / 2; \
+            if ((range).data[_middle] < (value)) { \
+                result = _middle + 1; \
+            } else { \
+                _high = _middle; \
+            } \
+        } \
+    } while (0)
+
+// The intervals and ids of advent of code 2025 day 5, with many more ids.
+// The linear loop is what day05_part1.c did before it merged the intervals and searched them.
+// Pass a size like 10000000 to look up 10M ids.
+void benchmark_search_day05() {
+    auto intervals = (BenchmarkIntervals){};
+    auto ids = (U64Array){};
+    uint64_t state = 17;
+    for (int i = 0; i < 200; ++i) {
+        uint64_t first = random_u64(&state) % 1000000000000000ull;
+        uint64_t last = first + random_u64(&state) % 10000000000000ull;
+        APPEND(intervals, ((BenchmarkInterval){first, last}));
+    }
+    auto id_count = benchmark_size(4 * 1000 * 1000);
+    RESERVE(ids, id_count);
+    for (size_t i = 0; i < id_count; ++i) {
+        APPEND(ids, random_u64(&state) % 1000000000000000ull);
+    }
+
+    size_t linear_count = 0;
+    auto start = seconds_now();
+    FOR_EACH(id, ids) {
+        FOR_EACH(interval, intervals) {
+            if (interval->first <= *id && *id <= interval->last) {
+                linear_count++;
+                break;
+            }
+        }
+    }
+    print_benchmark("search day05: linear ids", seconds_now() - start, (double)ids.count);
+
+    start = seconds_now();
+    SORT_BY_KEY(intervals, BENCHMARK_INTERVAL_FIRST);
+    size_t merged_count = 0;
+    FOR_EACH(interval, intervals) {
+        if (merged_count > 0 && interval->first <= intervals.data[merged_count - 1].last) {
+            auto last = &intervals.data[merged_count - 1].last;
+            *last = CARMA_MAX(*last, interval->last);
+        } else {
+            intervals.data[merged_count++] = *interval;
+        }
+    }
+    intervals.count = merged_count;
+    size_t search_count = 0;
+    FOR_EACH(id, ids) {
+        LOWER_BOUND_BY_KEY(index, intervals, BENCHMARK_INTERVAL_LAST, *id);
+        search_count += index < intervals.count && intervals.data[index].first <= *id;
+    }
+    print_benchmark("search day05: merge and LOWER_BOUND_BY_KEY ids", seconds_now() - start, (double)ids.count);
+    CHECK_INTERNAL(search_count == linear_count, "Unexpected count %zu != %zu", search_count, linear_count);
+
+    start = seconds_now();
+    auto index = (BenchmarkIntervals){};
+    INIT_EYTZINGER(index, intervals);
+    size_t eytzinger_count = 0;
+    FOR_EACH(id, ids) {
+        EYTZINGER_LOWER_BOUND_BY_KEY(i, index, BENCHMARK_INTERVAL_LAST, *id);
+        eytzinger_count += i < index.count && index.data[i].first <= *id;
+    }
+    print_benchmark("search day05: EYTZINGER_LOWER_BOUND_BY_KEY ids", seconds_now() - start, (double)ids.count);
+    CHECK_INTERNAL(eytzinger_count == linear_count, "Unexpected count %zu != %zu", eytzinger_count, linear_count);
+
+    global_benchmark_sink += linear_count;
+    FREE_RANGE(index);
+    FREE_DARRAY(intervals);
+    FREE_DARRAY(ids);
+}
+
+// Looks up random values in sorted keys that fit in the L1 cache, the L2 and L3 caches, and only in memory.
+void benchmark_search_size(size_t key_count, U64Array values) {
+    char description[64];
+    auto keys = (U64Array){};
+    INIT_DARRAY(keys, key_count, key_count);
+    uint64_t state = 5;
+    FOR_EACH(key, keys) {
+        *key = random_u64(&state);
+    }
+    RADIX_SORT(keys);
+
+    size_t legacy_sum = 0;
+    auto start = seconds_now();
+    FOR_EACH(value, values) {
+        LEGACY_LOWER_BOUND(i, keys, *value);
+        legacy_sum += i;
+    }
+    snprintf(description, sizeof(description), "search %zu keys: binary search", key_count);
+    print_benchmark(description, seconds_now() - start, (double)values.count);
+
+    size_t sum = 0;
+    start = seconds_now();
+    FOR_EACH(value, values) {
+        LOWER_BOUND(i, keys, *value);
+        sum += i;
+    }
+    snprintf(description, sizeof(description), "search %zu keys: LOWER_BOUND", key_count);
+    print_benchmark(description, seconds_now() - start, (double)values.count);
+    CHECK_INTERNAL(sum == legacy_sum, "Unexpected sum");
+
+    auto index = (U64Array){};
+    INIT_EYTZINGER(index, keys);
+    size_t eytzinger_sum = 0;
+    start = seconds_now();
+    FOR_EACH(value, values) {
+        EYTZINGER_LOWER_BOUND(i, index, *value);
+        eytzinger_sum += i < index.count ? index.data[i] % 1024 : 0;
+    }
+    snprintf(description, sizeof(description), "search %zu keys: EYTZINGER_LOWER_BOUND", key_count);
+    print_benchmark(description, seconds_now() - start, (double)values.count);
+
+    global_benchmark_sink += sum + eytzinger_sum;
+    FREE_RANGE(index);
+    FREE_DARRAY(keys);
+}
+
+void benchmark_search() {
+    benchmark_search_day05();
+    auto values = (U64Array){};
+    INIT_DARRAY(values, 4 * 1000 * 1000, 4 * 1000 * 1000);
+    uint64_t state = 6;
+    FOR_EACH(value, values) {
+        *value = random_u64(&state);
+    }
+    benchmark_search_size(1000, values);
+    benchmark_search_size(1000 * 1000, values);
+    benchmark_search_size(64 * 1000 * 1000, values);
+    FREE_DARRAY(values);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// MAIN
+
+#define RUN_BENCHMARK(filter, name) do { \
+    if (strstr(#name, (filter))) { \
+        name(); \
+    } \
+} while (0)
+
+int main(int argc, char** argv) {
+    auto filter = argc > 1 ? argv[1] : "";
+    if (argc > 2) {
+        global_benchmark_size = strtoull(argv[2], NULL, 10);
+    }
+    RUN_BENCHMARK(filter, benchmark_arena);
+    RUN_BENCHMARK(filter, benchmark_table);
+    RUN_BENCHMARK(filter, benchmark_table_churn);
+    RUN_BENCHMARK(filter, benchmark_table_latency);
+    RUN_BENCHMARK(filter, benchmark_table_hashed);
+    RUN_BENCHMARK(filter, benchmark_file);
+    RUN_BENCHMARK(filter, benchmark_lines);
+    RUN_BENCHMARK(filter, benchmark_words);
+    RUN_BENCHMARK(filter, benchmark_parse_double);
+    RUN_BENCHMARK(filter, benchmark_parse_integer);
+    RUN_BENCHMARK(filter, benchmark_serialize_double);
+    RUN_BENCHMARK(filter, benchmark_serialize_integer);
+    RUN_BENCHMARK(filter, benchmark_serialize_pixels);
+    RUN_BENCHMARK(filter, benchmark_serialize_string);
+    RUN_BENCHMARK(filter, benchmark_json_index);
+    RUN_BENCHMARK(filter, benchmark_json_stream);
+    RUN_BENCHMARK(filter, benchmark_json_validation);
+    RUN_BENCHMARK(filter, benchmark_parse_string);
+    RUN_BENCHMARK(filter, benchmark_parallel);
+    RUN_BENCHMARK(filter, benchmark_reduce);
+    RUN_BENCHMARK(filter, benchmark_copy_fill);
+    RUN_BENCHMARK(filter, benchmark_sort);
+    RUN_BENCHMARK(filter, benchmark_search);
+    return 0;
+}
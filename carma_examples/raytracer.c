@@ -1,8 +1,10 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <carma/carma.h>
+#include <carma/carma_parallel.h>
 
 typedef struct {
     double x;
@@ -157,47 +159,79 @@ int colorU8fromF64(double c) {
     return (int)(fmin(255.0 * c, 255.0));
 }
 
-void writePixel(
-    FILE* file,
-    int x,
-    int y,
-    int width,
-    int height,
-    World world
-) {
+typedef struct {
+    unsigned char r;
+    unsigned char g;
+    unsigned char b;
+} Pixel;
+
+typedef struct {
+    Pixel* data;
+    size_t count;
+    size_t width;
+    size_t height;
+} Image;
+
+typedef struct {
+    Image image;
+    World world;
+} RenderContext;
+
+void renderPixel(size_t x, size_t y, void* context) {
+    RenderContext* render = context;
+    auto width = (int)render->image.width;
+    auto height = (int)render->image.height;
     auto start = MAKE(Vec3d, 0, 0, 0);
-    auto xd = (double)(x - width / 2);
-    auto yd = (double)(y - height / 2);
+    auto xd = (double)((int)x - width / 2);
+    auto yd = (double)((int)y - height / 2);
     auto zd = (double)(height / 2);
     auto direction = normalize(MAKE(Vec3d, xd, yd, zd));
-    auto intersection = findIntersection(start, direction, world.spheres);
-    auto color = shade(intersection, world);
-    auto r = colorU8fromF64(color.x);
-    auto g = colorU8fromF64(color.y);
-    auto b = colorU8fromF64(color.z);
-    fprintf(file, "%d %d %d ", r, g, b);
+    auto intersection = findIntersection(start, direction, render->world.spheres);
+    auto color = shade(intersection, render->world);
+    auto pixel = &render->image.data[y * render->image.width + x];
+    pixel->r = (unsigned char)colorU8fromF64(color.x);
+    pixel->g = (unsigned char)colorU8fromF64(color.y);
+    pixel->b = (unsigned char)colorU8fromF64(color.z);
 }
 
-void writeImage(const char* file_path, World world) {
+double secondsNow() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + 1e-9 * (double)time.tv_nsec;
+}
+
+Image renderImage(ThreadPool* pool, World world) {
+    auto render = MAKE(RenderContext, .world=world);
+    INIT_2D_ARRAY(render.image, 800, 600);
+    auto start = secondsNow();
+    PARALLEL_FOR_XY(pool, render.image, renderPixel, &render);
+    printf("Rendered %zux%zu pixels in %.1f ms on %zu threads\n",
+        render.image.width, render.image.height, 1000 * (secondsNow() - start), pool->thread_count);
+    return render.image;
+}
+
+void writeImage(const char* file_path, Image image) {
     auto file = fopen(file_path, "w");
     if (file == NULL) {
         fprintf(stderr, "error opening file\n");
         exit(EXIT_FAILURE);
     }
-    auto WIDTH = 800;
-    auto HEIGHT = 600;
-    fprintf(file, "%s\n%d\n%d\n%d\n", "P3", WIDTH, HEIGHT, 255);
-    for (auto y = 0; y < HEIGHT; ++y) {
-        for (auto x = 0; x < WIDTH; ++x) {
-            writePixel(file, x, y, WIDTH, HEIGHT, world);
-        }
+    fprintf(file, "%s\n%zu\n%zu\n%d\n", "P3", image.width, image.height, 255);
+    FOR_EACH(pixel, image) {
+        fprintf(file, "%d %d %d ", pixel->r, pixel->g, pixel->b);
     }
     fclose(file);
 }
 
-int main() {
-    printf("Saving image\n");
+// Usage: raytracer [thread_count]
+// The default thread count is the number of processors.
+int main(int argc, char** argv) {
+    auto pool = MAKE_THREAD_POOL(argc > 1 ? strtoul(argv[1], NULL, 10) : 0);
     auto world = makeWorld();
-    writeImage("image.ppm", world);
+    auto image = renderImage(pool, world);
+    printf("Saving image\n");
+    writeImage("image.ppm", image);
+    FREE_2D_ARRAY(image);
+    FREE_THREAD_POOL(pool);
     return 0;
 }
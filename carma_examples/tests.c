@@ -1,11 +1,27 @@
+#include <ctype.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 
+// All allocations of the tests go through this allocator, which can be changed at runtime.
+// The tests use malloc directly when it is NULL.
+struct CarmaAllocator* global_allocator = NULL;
+#define CARMA_ALLOCATOR global_allocator
+
+// Small tables finish growing in a single operation with the default count,
+// so the tests use a small one to keep the incremental tables growing across many operations.
+#define CARMA_INCREMENTAL_REHASH_COUNT 8
+
 #include <carma/carma.h>
+#include <carma/carma_arena.h>
+#include <carma/carma_file.h>
 #include <carma/carma_error.h>
 #include <carma/carma_parse.h>
 #include <carma/carma_json_serialize.h>
 #include <carma/carma_json_parse.h>
+#include <carma/carma_json_index.h>
+#include <carma/carma_json_stream.h>
+#include <carma/carma_parallel.h>
 #include <carma/carma_string.h>
 #include <carma/carma_table.h>
 
@@ -19,6 +35,12 @@ typedef struct {
     size_t count;
 } IntRange;
 
+typedef struct StringViews {
+    StringView* data;
+    size_t count;
+    size_t capacity;
+} StringViews;
+
 typedef struct {
     int* data;
     size_t count;
@@ -49,6 +71,52 @@ typedef struct {
     size_t capacity;
 } TableIntArrayInt;
 
+typedef struct {
+    unsigned char* data;
+    size_t count;
+    size_t capacity;
+} ByteArray;
+
+typedef struct {
+    int64_t* data;
+    size_t count;
+    size_t capacity;
+} I64Array;
+
+typedef struct {
+    float* data;
+    size_t count;
+    size_t capacity;
+} FloatArray;
+
+typedef struct {
+    double* data;
+    size_t count;
+    size_t capacity;
+} DoubleArray;
+
+typedef struct {
+    StringView key;
+    int value;
+    size_t hash;
+    bool occupied;
+} ItemStringInt;
+
+typedef struct {
+    ItemStringInt* data;
+    size_t count;
+    size_t capacity;
+} HashedTableStringInt;
+
+typedef struct {
+    ItemIntInt* data;
+    size_t count;
+    size_t capacity;
+    ItemIntInt* old_data;
+    size_t old_capacity;
+    size_t rehash_index;
+} IncrementalTableIntInt;
+
 typedef struct {
     int* data;
     size_t width;
@@ -575,6 +643,89 @@ void test_copy_backward_inplace() {
     FREE_DARRAY(expected);
 }
 
+int next_fill_value(int* counter) {
+    return (*counter)++;
+}
+
+void test_fill_evaluates_value_once() {
+    auto actual = MAKE_DARRAY(IntArray, 1, 2, 3);
+    auto counter = 7;
+    FILL(actual, next_fill_value(&counter));
+    auto expected = MAKE_DARRAY(IntArray, 7, 7, 7);
+    ASSERT_EQUAL_RANGE("test_fill_evaluates_value_once", actual, expected);
+    ASSERT_EQUAL_INT("test_fill_evaluates_value_once counter", counter, 8);
+    FREE_DARRAY(actual);
+    FREE_DARRAY(expected);
+}
+
+void test_stream_fill() {
+    auto bytes = (ByteArray){};
+    INIT_DARRAY(bytes, 203, 203);
+    uint8_t byte = 5;
+    carma_stream_fill(bytes.data + 3, 199, &byte, 1);
+    auto errors = bytes.data[0] + bytes.data[1] + bytes.data[2] + bytes.data[202];
+    for (size_t i = 3; i < 202; ++i) {
+        errors += bytes.data[i] != 5;
+    }
+    ASSERT_EQUAL_INT("test_stream_fill bytes", errors, 0);
+    FREE_DARRAY(bytes);
+
+    auto values = (I64Array){};
+    INIT_DARRAY(values, 101, 101);
+    int64_t value = -123456789012;
+    if (carma_stream_fill(values.data + 1, 99, &value, sizeof(value))) {
+        errors = values.data[0] != 0 || values.data[100] != 0;
+        for (size_t i = 1; i < 100; ++i) {
+            errors += values.data[i] != value;
+        }
+        ASSERT_EQUAL_INT("test_stream_fill int64", errors, 0);
+    }
+    FREE_DARRAY(values);
+}
+
+void test_copy_overlap_forward() {
+    auto actual = MAKE_DARRAY(IntArray, 1, 2, 3, 4, 5);
+    COPY(SUB_RANGE(actual, 0, 3), SUB_RANGE(actual, 1, 3));
+    auto expected = MAKE_DARRAY(IntArray, 1, 1, 2, 3, 5);
+    ASSERT_EQUAL_RANGE("test_copy_overlap_forward", actual, expected);
+    FREE_DARRAY(actual);
+    FREE_DARRAY(expected);
+}
+
+void test_copy_backward_overlap_backward() {
+    auto actual = MAKE_DARRAY(IntArray, 1, 2, 3, 4, 5);
+    COPY_BACKWARD(SUB_RANGE(actual, 2, 3), SUB_RANGE(actual, 0, 3));
+    auto expected = MAKE_DARRAY(IntArray, 3, 4, 5, 4, 5);
+    ASSERT_EQUAL_RANGE("test_copy_backward_overlap_backward", actual, expected);
+    FREE_DARRAY(actual);
+    FREE_DARRAY(expected);
+}
+
+void test_copy_backward_different_counts() {
+    auto source = MAKE_DARRAY(IntArray, 1, 2, 3);
+    auto actual = MAKE_DARRAY(IntArray, 7, 8, 9, 10, 11);
+    COPY_BACKWARD(source, actual);
+    auto expected = MAKE_DARRAY(IntArray, 7, 8, 1, 2, 3);
+    ASSERT_EQUAL_RANGE("test_copy_backward_different_counts", actual, expected);
+    FREE_DARRAY(source);
+    FREE_DARRAY(actual);
+    FREE_DARRAY(expected);
+}
+
+void test_copy_converts_items() {
+    auto source = MAKE_DARRAY(IntArray, 1, 2, 3);
+    auto target = (DoubleArray){};
+    INIT_DARRAY(target, 3, 3);
+    COPY(source, target);
+    ASSERT_EQUAL_DOUBLE("test_copy_converts_items 0", target.data[0], 1.0);
+    ASSERT_EQUAL_DOUBLE("test_copy_converts_items 2", target.data[2], 3.0);
+    FILL(target, 0.0);
+    COPY_BACKWARD(source, target);
+    ASSERT_EQUAL_DOUBLE("test_copy_converts_items backward", target.data[1], 2.0);
+    FREE_DARRAY(source);
+    FREE_DARRAY(target);
+}
+
 void test_replace() {
     auto actual = MAKE_DARRAY(IntArray, 1, 2, 3, 2);
     REPLACE(actual, 2, 4);
@@ -1127,6 +1278,286 @@ void test_concat() {
     FREE_DARRAY(expected1);
 }
 
+void test_append_arena() {
+    auto arena = (CarmaArena){};
+    auto actual = (IntArray){};
+    for (int i = 0; i < 100000; ++i) {
+        APPEND_ARENA(actual, i, arena);
+    }
+    auto sum = 0ll;
+    FOR_EACH(it, actual) {
+        sum += *it;
+    }
+    ASSERT_EQUAL_SIZE("APPEND_ARENA count", actual.count, 100000);
+    ASSERT_BOOL("APPEND_ARENA items", sum == 100000ll * 99999ll / 2);
+    FREE_ARENA(arena);
+    ASSERT_EQUAL_POINTER("FREE_ARENA", arena.chunk, NULL);
+}
+
+void test_concat_arena() {
+    auto arena = (CarmaArena){};
+    IntArray target;
+    INIT_DARRAY_ARENA(target, 0, 0, arena);
+    auto other = (IntArray){};
+    APPEND_ARENA(other, 0, arena);
+    auto source = MAKE_DARRAY(IntArray, 1, 2, 3);
+    CONCAT_ARENA(target, source, arena);
+    CONCAT_ARENA(target, source, arena);
+    auto expected = MAKE_DARRAY(IntArray, 1, 2, 3, 1, 2, 3);
+    ASSERT_EQUAL_RANGE("CONCAT_ARENA", target, expected);
+    ASSERT_EQUAL_SIZE("CONCAT_ARENA", target.capacity, 8);
+    ASSERT_EQUAL_SIZE("CONCAT_ARENA other", other.count, 1);
+    FREE_DARRAY(source);
+    FREE_DARRAY(expected);
+    FREE_ARENA(arena);
+}
+
+void test_rewind_arena() {
+    auto arena = (CarmaArena){};
+    auto before = (IntArray){};
+    APPEND_ARENA(before, 1, arena);
+    auto mark = MARK_ARENA(arena);
+    auto after = (IntArray){};
+    APPEND_ARENA(after, 2, arena);
+    REWIND_ARENA(arena, mark);
+    auto again = (IntArray){};
+    APPEND_ARENA(again, 3, arena);
+    ASSERT_EQUAL_POINTER("REWIND_ARENA reuses memory", again.data, after.data);
+    ASSERT_EQUAL_INT("REWIND_ARENA keeps earlier memory", FIRST_ITEM(before), 1);
+    RESET_ARENA(arena);
+    auto reset = (IntArray){};
+    APPEND_ARENA(reset, 4, arena);
+    ASSERT_EQUAL_POINTER("RESET_ARENA reuses memory", reset.data, before.data);
+    FREE_ARENA(arena);
+}
+
+void test_serialize_arena() {
+    auto arena = (CarmaArena){};
+    auto s = (StringBuilder){};
+    SERIALIZE_CSTRING_ARENA(s, "a", arena);
+    SERIALIZE_CHARACTER_ARENA(s, ' ', arena);
+    SERIALIZE_INTEGRAL_ARENA(s, -12, arena);
+    SERIALIZE_CHARACTER_ARENA(s, ' ', arena);
+    SERIALIZE_DOUBLE_ARENA(s, 1.5, arena);
+    SERIALIZE_CHARACTER_ARENA(s, ' ', arena);
+    SERIALIZE_BOOL_ARENA(s, true, arena);
+    ASSERT_STRING_BUILDER("test_serialize_arena", s, "a -12 1.5 true");
+    ASSERT_EQUAL_STRINGS("AS_CSTRING_ARENA", AS_CSTRING_ARENA(s, arena), "a -12 1.5 true");
+    ASSERT_EQUAL_STRINGS("MAKE_CSTRING_ARENA", MAKE_CSTRING_ARENA(s, arena), "a -12 1.5 true");
+    const char* words[] = {"b", "cd"};
+    auto word = 0;
+    SERIALIZE_CSTRING_ARENA(s, words[word++], arena);
+    ASSERT_STRING_BUILDER("SERIALIZE_CSTRING_ARENA evaluates once", s, "a -12 1.5 trueb");
+    ASSERT_EQUAL_INT("SERIALIZE_CSTRING_ARENA evaluates once count", word, 1);
+    FREE_ARENA(arena);
+}
+
+typedef struct {
+    size_t allocated_bytes;
+    size_t allocation_count;
+    size_t free_count;
+} AllocationCounter;
+
+void* counting_allocate(void* context, size_t byte_count) {
+    AllocationCounter* counter = context;
+    counter->allocated_bytes += byte_count;
+    counter->allocation_count++;
+    return malloc(byte_count);
+}
+
+void* counting_reallocate(void* context, void* buffer, size_t old_byte_count, size_t new_byte_count) {
+    AllocationCounter* counter = context;
+    counter->allocated_bytes += new_byte_count;
+    counter->allocated_bytes -= old_byte_count;
+    counter->allocation_count++;
+    return realloc(buffer, new_byte_count);
+}
+
+void counting_free(void* context, void* buffer, size_t byte_count) {
+    AllocationCounter* counter = context;
+    if (buffer) {
+        counter->allocated_bytes -= byte_count;
+        counter->free_count++;
+    }
+    free(buffer);
+}
+
+void test_allocator() {
+    auto counter = (AllocationCounter){};
+    auto allocator = (CarmaAllocator){counting_allocate, counting_reallocate, counting_free, &counter};
+    global_allocator = &allocator;
+
+    auto numbers = (IntArray){};
+    for (int i = 0; i < 100; ++i) {
+        APPEND(numbers, i);
+    }
+    ASSERT_EQUAL_SIZE("test_allocator append", counter.allocated_bytes, numbers.capacity * sizeof(int));
+    auto image = (Image){};
+    INIT_2D_ARRAY(image, 2, 3);
+    auto s = (StringBuilder){};
+    SERIALIZE_CSTRING(s, "abc");
+    auto cstring = MAKE_CSTRING(s);
+    FREE_CSTRING(cstring);
+    FREE_DARRAY(s);
+    FREE_2D_ARRAY(image);
+    FREE_DARRAY(numbers);
+    ASSERT_EQUAL_SIZE("test_allocator free", counter.allocated_bytes, 0);
+    ASSERT_EQUAL_SIZE("test_allocator free count", counter.free_count, 4);
+
+    global_allocator = NULL;
+}
+
+void test_arena_allocator() {
+    auto arena = (CarmaArena){};
+    auto allocator = MAKE_ARENA_ALLOCATOR(arena);
+    global_allocator = &allocator;
+
+    auto numbers = (IntArray){};
+    for (int i = 0; i < 1000; ++i) {
+        APPEND(numbers, i);
+    }
+    ASSERT_EQUAL_SIZE("test_arena_allocator", arena.chunk->count, numbers.capacity * sizeof(int));
+    FREE_DARRAY(numbers);
+    ASSERT_EQUAL_SIZE("test_arena_allocator free", arena.chunk->count, 0);
+    FREE_ARENA(arena);
+
+    global_allocator = NULL;
+}
+
+void write_test_file(const char* file_path, const char* text) {
+    FOR_FILE(file, file_path, "wb") {
+        fputs(text, file);
+    }
+}
+
+StringBuilder join_lines(StringView text) {
+    auto result = (StringBuilder){};
+    FOR_EACH_LINE(line, text) {
+        CONCAT(result, line);
+        APPEND(result, '|');
+    }
+    SERIALIZE_CHARACTER(result, '.');
+    return result;
+}
+
+void test_for_each_line() {
+    auto joined = join_lines(STRING_LITERAL("a\r\nbb\n\nccc"));
+    ASSERT_EQUAL_STRINGS("test_for_each_line", joined.data, "a|bb||ccc|.");
+    FREE_DARRAY(joined);
+}
+
+void test_for_each_line_trailing_line_break() {
+    auto joined = join_lines(STRING_LITERAL("a\nb\r\n"));
+    ASSERT_EQUAL_STRINGS("test_for_each_line_trailing_line_break", joined.data, "a|b|.");
+    FREE_DARRAY(joined);
+}
+
+void test_for_each_line_empty() {
+    auto joined = join_lines((StringView){});
+    ASSERT_EQUAL_STRINGS("test_for_each_line_empty", joined.data, ".");
+    FREE_DARRAY(joined);
+}
+
+void test_for_each_stream_line() {
+    auto file = tmpfile();
+    fputs("a\r\nbb\n\n", file);
+    for (int i = 0; i < 200000; ++i) {
+        fputc('x', file);
+    }
+    fputs("\nccc", file);
+    rewind(file);
+    auto buffer = (StringBuilder){};
+    auto joined = (StringBuilder){};
+    FOR_EACH_STREAM_LINE(line, buffer, file) {
+        if (line.count > 3) {
+            SERIALIZE_INTEGRAL(joined, (int)line.count);
+        } else {
+            CONCAT(joined, line);
+        }
+        APPEND(joined, '|');
+    }
+    SERIALIZE_CHARACTER(joined, '.');
+    fclose(file);
+    ASSERT_EQUAL_STRINGS("test_for_each_stream_line", joined.data, "a|bb||200000|ccc|.");
+    FREE_DARRAY(joined);
+    FREE_DARRAY(buffer);
+}
+
+void test_read_text_file() {
+    auto file_path = "test_read_text_file.txt";
+    write_test_file(file_path, "hello\nworld");
+    auto text = read_text_file(file_path);
+    ASSERT_BOOL("test_read_text_file", text.count == 11 && strcmp(text.data, "hello\nworld") == 0);
+    FREE_DARRAY(text);
+    remove(file_path);
+}
+
+void test_read_text_file_missing() {
+    auto text = read_text_file("test_read_text_file_missing.txt");
+    ASSERT_BOOL("test_read_text_file_missing", text.data == NULL && text.count == 0);
+}
+
+void test_read_binary_file() {
+    auto file_path = "test_read_binary_file.bin";
+    FOR_FILE(file, file_path, "wb") {
+        unsigned char bytes[] = {0, 1, 255, 10, 13};
+        fwrite(bytes, 1, sizeof(bytes), file);
+    }
+    auto bytes = (ByteArray){};
+    APPEND(bytes, 7);
+    READ_BINARY_FILE(bytes, file_path);
+    auto expected = (unsigned char[]){7, 0, 1, 255, 10, 13};
+    ASSERT_BOOL("test_read_binary_file", bytes.count == 6 && memcmp(bytes.data, expected, 6) == 0);
+    FREE_DARRAY(bytes);
+    remove(file_path);
+}
+
+void test_read_stream() {
+    auto file = tmpfile();
+    for (int i = 0; i < 100000; ++i) {
+        fputc('a' + i % 26, file);
+    }
+    rewind(file);
+    fgetc(file);
+    auto text = (StringBuilder){};
+    READ_STREAM(text, file);
+    fclose(file);
+    ASSERT_BOOL("test_read_stream", text.count == 99999 && text.data[0] == 'b' && text.data[99998] == 'a' + 99999 % 26);
+    FREE_DARRAY(text);
+}
+
+void test_map_file() {
+    auto file_path = "test_map_file.txt";
+    write_test_file(file_path, "hello\nworld");
+    auto file = MAKE_MAPPED_FILE(file_path);
+    auto word_count = 0;
+    FOR_EACH_WORD(word, file, '\n') {
+        word_count++;
+    }
+    auto text = MAKE(StringView, file.data, file.count);
+    ASSERT_BOOL("test_map_file", file.is_mapped && word_count == 2 && ARE_EQUAL(text, STRING_LITERAL("hello\nworld")));
+    FREE_MAPPED_FILE(file);
+    remove(file_path);
+}
+
+void test_map_file_missing() {
+    auto file = MAKE_MAPPED_FILE("test_map_file_missing.txt");
+    ASSERT_BOOL("test_map_file_missing", file.data == NULL && file.count == 0);
+}
+
+void test_read_mapped_file() {
+    auto file_path = "test_read_mapped_file.txt";
+    write_test_file(file_path, "hello\nworld");
+    auto mapped_file = (MappedFile){};
+    FOR_FILE(file, file_path, "rb") {
+        mapped_file = carma_read_mapped_file(file);
+    }
+    auto text = MAKE(StringView, mapped_file.data, mapped_file.count);
+    ASSERT_BOOL("test_read_mapped_file", !mapped_file.is_mapped && ARE_EQUAL(text, STRING_LITERAL("hello\nworld")));
+    FREE_MAPPED_FILE(mapped_file);
+    remove(file_path);
+}
+
 void test_for_x_y() {
     Image actual;
     INIT_2D_ARRAY(actual, 2, 3);
@@ -1245,6 +1676,42 @@ void test_for_each_word_predicate() {
     ASSERT_EQUAL_INT("test_for_each_word_predicate", count, 3);
 }
 
+void test_for_each_word_empty_words() {
+    auto s = STRING_VIEW(",a,,bc,");
+    auto joined = (StringBuilder){};
+    FOR_EACH_WORD(w, s, ',') {
+        CONCAT(joined, w);
+        APPEND(joined, '|');
+    }
+    SERIALIZE_CHARACTER(joined, '.');
+    ASSERT_EQUAL_STRINGS("test_for_each_word_empty_words", joined.data, "|a||bc|.");
+    FREE_DARRAY(joined);
+}
+
+void test_for_each_word_in_set() {
+    auto s = STRING_VIEW("a, bc , def");
+    auto delimiters = MAKE_CHARACTER_SET(", ");
+    size_t count = 0;
+    size_t letter_count = 0;
+    FOR_EACH_WORD_IN_SET(w, s, delimiters) {
+        count++;
+        letter_count += w.count;
+    }
+    ASSERT_BOOL("test_for_each_word_in_set", count == 3 && letter_count == 6);
+}
+
+void test_for_each_word_in_set_predicate() {
+    auto s = STRING_VIEW("a\xe4\tbc \n def");
+    auto delimiters = MAKE_CHARACTER_SET_PREDICATE(isspace);
+    size_t count = 0;
+    size_t letter_count = 0;
+    FOR_EACH_WORD_IN_SET(w, s, delimiters) {
+        count++;
+        letter_count += w.count;
+    }
+    ASSERT_BOOL("test_for_each_word_in_set_predicate", count == 3 && letter_count == 7);
+}
+
 void test_serialize_cstring() {
     auto s = (StringBuilder){};
 
@@ -1380,6 +1847,264 @@ void test_table_available_keys() {
     FREE_DARRAY(keys);
 }
 
+void test_table_many_keys() {
+    auto table = (TableIntInt){};
+    for (int i = 0; i < 10000; ++i) {
+        SET_KEY_VALUE(64 * i, i, table);
+    }
+    auto all_found = table.count == 10000;
+    for (int i = 0; i < 10000; ++i) {
+        auto value = -1;
+        GET_KEY_VALUE(64 * i, value, table);
+        all_found = all_found && value == i;
+    }
+    auto value = -1;
+    GET_KEY_VALUE(64 * 10000, value, table);
+    ASSERT_BOOL("test_table_many_keys", all_found && value == -1);
+    FREE_TABLE(table);
+}
+
+void test_table_many_range_keys() {
+    auto table = (TableIntArrayInt){};
+    auto numbers = (IntArray){};
+    for (int i = 0; i < 1000; ++i) {
+        APPEND(numbers, 7);
+        APPEND(numbers, i);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        auto keys = (IntArray){numbers.data + 2 * i, 2, 2};
+        SET_RANGE_KEY_VALUE(keys, i, table);
+    }
+    auto all_found = table.count == 1000;
+    for (int i = 0; i < 1000; ++i) {
+        auto value = -1;
+        auto keys = (IntArray){numbers.data + 2 * i, 2, 2};
+        GET_RANGE_KEY_VALUE(keys, value, table);
+        all_found = all_found && value == i;
+    }
+    ASSERT_BOOL("test_table_many_range_keys", all_found);
+    FREE_TABLE(table);
+    FREE_DARRAY(numbers);
+}
+
+void test_table_erase_key() {
+    auto table = (TableIntInt){};
+    SET_KEY_VALUE(1, 2, table);
+    SET_KEY_VALUE(3, 4, table);
+    ERASE_KEY(1, table);
+    ERASE_KEY(5, table);
+    auto erased_value = -1;
+    auto kept_value = -1;
+    GET_KEY_VALUE(1, erased_value, table);
+    GET_KEY_VALUE(3, kept_value, table);
+    ASSERT_BOOL("test_table_erase_key", table.count == 1 && erased_value == -1 && kept_value == 4);
+    FREE_TABLE(table);
+}
+
+void test_table_erase_key_empty() {
+    auto table = (TableIntInt){};
+    ERASE_KEY(1, table);
+    ASSERT_EQUAL_SIZE("test_table_erase_key_empty", table.count, 0);
+}
+
+void test_table_erase_many_keys() {
+    auto table = (TableIntInt){};
+    for (int i = 0; i < 1000; ++i) {
+        SET_KEY_VALUE(i, i, table);
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        ERASE_KEY(i, table);
+    }
+    auto all_correct = table.count == 500;
+    for (int i = 0; i < 1000; ++i) {
+        auto value = -1;
+        GET_KEY_VALUE(i, value, table);
+        all_correct = all_correct && value == (i % 2 ? i : -1);
+    }
+    ASSERT_BOOL("test_table_erase_many_keys", all_correct);
+    FREE_TABLE(table);
+}
+
+void test_table_erase_range_key() {
+    auto table = (TableIntArrayInt){};
+    auto numbers = (IntArray){};
+    APPEND(numbers, 1);
+    APPEND(numbers, 2);
+    auto a = (IntArray){numbers.data, 1, 1};
+    auto b = (IntArray){numbers.data + 1, 1, 1};
+    SET_RANGE_KEY_VALUE(a, 3, table);
+    SET_RANGE_KEY_VALUE(b, 4, table);
+    ERASE_RANGE_KEY(a, table);
+    auto erased_value = -1;
+    auto kept_value = -1;
+    GET_RANGE_KEY_VALUE(a, erased_value, table);
+    GET_RANGE_KEY_VALUE(b, kept_value, table);
+    ASSERT_BOOL("test_table_erase_range_key", table.count == 1 && erased_value == -1 && kept_value == 4);
+    FREE_TABLE(table);
+    FREE_DARRAY(numbers);
+}
+
+bool has_odd_value(ItemIntInt item) {
+    return item.value % 2;
+}
+
+void test_erase_table_if() {
+    auto table = (TableIntInt){};
+    for (int i = 0; i < 1000; ++i) {
+        SET_KEY_VALUE(i, i, table);
+    }
+    ERASE_TABLE_IF(table, has_odd_value);
+    auto all_correct = table.count == 500;
+    for (int i = 0; i < 1000; ++i) {
+        auto value = -1;
+        GET_KEY_VALUE(i, value, table);
+        all_correct = all_correct && value == (i % 2 ? -1 : i);
+    }
+    ASSERT_BOOL("test_erase_table_if", all_correct);
+    FREE_TABLE(table);
+}
+
+void test_table_incremental() {
+    auto table = (IncrementalTableIntInt){};
+    auto all_found = true;
+    for (int i = 0; i < 10000; ++i) {
+        SET_KEY_VALUE_INCREMENTAL(i, i, table);
+        auto value = -1;
+        GET_KEY_VALUE_INCREMENTAL(i / 2, value, table);
+        all_found = all_found && value == i / 2;
+    }
+    for (int i = 0; i < 10000; ++i) {
+        auto value = -1;
+        GET_KEY_VALUE_INCREMENTAL(i, value, table);
+        all_found = all_found && value == i;
+    }
+    ASSERT_BOOL("test_table_incremental", all_found && table.count == 10000);
+    FREE_TABLE_INCREMENTAL(table);
+}
+
+void test_table_incremental_overwrite() {
+    auto table = (IncrementalTableIntInt){};
+    auto during_rehash = false;
+    for (int i = 0; i < 100; ++i) {
+        SET_KEY_VALUE_INCREMENTAL(i, i, table);
+        during_rehash = during_rehash || table.old_data;
+    }
+    for (int i = 0; i < 100; ++i) {
+        SET_KEY_VALUE_INCREMENTAL(i, -i, table);
+    }
+    auto sum = 0;
+    auto count = 0;
+    FOR_EACH_TABLE_INCREMENTAL(item, table) {
+        sum += item->value;
+        count++;
+    }
+    ASSERT_BOOL("test_table_incremental_overwrite", during_rehash && count == 100 && sum == -4950);
+    FREE_TABLE_INCREMENTAL(table);
+}
+
+void test_for_each_table_incremental() {
+    auto table = (IncrementalTableIntInt){};
+    auto all_counted = true;
+    for (int i = 0; i < 1000; ++i) {
+        SET_KEY_VALUE_INCREMENTAL(i, 1, table);
+        auto count = 0;
+        FOR_EACH_TABLE_INCREMENTAL(item, table) {
+            count += item->value;
+        }
+        all_counted = all_counted && count == i + 1;
+    }
+    ASSERT_BOOL("test_for_each_table_incremental", all_counted);
+    FREE_TABLE_INCREMENTAL(table);
+}
+
+void test_table_erase_key_incremental() {
+    auto table = (IncrementalTableIntInt){};
+    for (int i = 0; i < 100; ++i) {
+        SET_KEY_VALUE_INCREMENTAL(i, i, table);
+        ERASE_KEY_INCREMENTAL(i / 2, table);
+    }
+    auto count = 0;
+    FOR_EACH_TABLE_INCREMENTAL(item, table) {
+        count++;
+    }
+    auto value = -1;
+    GET_KEY_VALUE_INCREMENTAL(99, value, table);
+    ASSERT_BOOL("test_table_erase_key_incremental", count == 50 && table.count == 50 && value == 99);
+    FREE_TABLE_INCREMENTAL(table);
+}
+
+void test_table_range_key_hashed() {
+    auto table = (HashedTableStringInt){};
+    SET_RANGE_KEY_VALUE_HASHED(STRING_LITERAL("hello"), 1, table);
+    SET_RANGE_KEY_VALUE_HASHED(STRING_LITERAL("world"), 2, table);
+    SET_RANGE_KEY_VALUE_HASHED(STRING_LITERAL("hello"), 3, table);
+    auto hello = 0;
+    auto world = 0;
+    auto missing = 0;
+    GET_RANGE_KEY_VALUE_HASHED(STRING_LITERAL("hello"), hello, table);
+    GET_RANGE_KEY_VALUE_HASHED(STRING_LITERAL("world"), world, table);
+    GET_RANGE_KEY_VALUE_HASHED(STRING_LITERAL("hell"), missing, table);
+    ASSERT_BOOL("test_table_range_key_hashed", table.count == 2 && hello == 3 && world == 2 && missing == 0);
+    FREE_TABLE(table);
+}
+
+void test_table_many_range_keys_hashed() {
+    auto table = (HashedTableStringInt){};
+    auto text = (StringBuilder){};
+    for (int i = 0; i < 1000; ++i) {
+        SERIALIZE_INTEGRAL(text, i);
+    }
+    auto all_found = true;
+    for (int pass = 0; pass < 2; ++pass) {
+        auto offset = 0;
+        for (int i = 0; i < 1000; ++i) {
+            auto digits = i < 10 ? 1 : i < 100 ? 2 : 3;
+            auto key = MAKE(StringView, text.data + offset, digits);
+            offset += digits;
+            if (pass == 0) {
+                SET_RANGE_KEY_VALUE_HASHED(key, i, table);
+            } else {
+                auto value = -1;
+                GET_RANGE_KEY_VALUE_HASHED(key, value, table);
+                all_found = all_found && value == i;
+            }
+        }
+    }
+    ASSERT_BOOL("test_table_many_range_keys_hashed", all_found && table.count == 1000);
+    FREE_TABLE(table);
+    FREE_DARRAY(text);
+}
+
+bool has_long_key(ItemStringInt item) {
+    return item.key.count > 2;
+}
+
+void test_table_erase_range_key_hashed() {
+    auto table = (HashedTableStringInt){};
+    SET_RANGE_KEY_VALUE_HASHED(STRING_LITERAL("a"), 1, table);
+    SET_RANGE_KEY_VALUE_HASHED(STRING_LITERAL("bb"), 2, table);
+    SET_RANGE_KEY_VALUE_HASHED(STRING_LITERAL("ccc"), 3, table);
+    SET_RANGE_KEY_VALUE_HASHED(STRING_LITERAL("dddd"), 4, table);
+    ERASE_RANGE_KEY_HASHED(STRING_LITERAL("a"), table);
+    ERASE_RANGE_KEY_TABLE_IF_HASHED(table, has_long_key);
+    auto a = 0;
+    auto bb = 0;
+    GET_RANGE_KEY_VALUE_HASHED(STRING_LITERAL("a"), a, table);
+    GET_RANGE_KEY_VALUE_HASHED(STRING_LITERAL("bb"), bb, table);
+    ASSERT_BOOL("test_table_erase_range_key_hashed", table.count == 1 && a == 0 && bb == 2);
+    FREE_TABLE(table);
+}
+
+void test_hash_bytes() {
+    auto a = STRING_LITERAL("abcdefghijklmnopq");
+    auto b = STRING_LITERAL("abcdefghijklmnopr");
+    auto hash_a = carma_hash_bytes(CARMA_HASH_INIT, a.data, a.count);
+    auto hash_b = carma_hash_bytes(CARMA_HASH_INIT, b.data, b.count);
+    auto hash_a_again = carma_hash_bytes(CARMA_HASH_INIT, a.data, a.count);
+    auto hash_a_prefix = carma_hash_bytes(CARMA_HASH_INIT, a.data, a.count - 1);
+    ASSERT_BOOL("test_hash_bytes", hash_a == hash_a_again && hash_a != hash_b && hash_a != hash_a_prefix);
+}
+
 void test_serialize_integral() {
     auto s = (StringBuilder){};
     
@@ -1398,6 +2123,45 @@ void test_serialize_integral() {
     FREE_DARRAY(s);
 }
 
+void test_serialize_integral_limits() {
+    auto s = (StringBuilder){};
+    SERIALIZE_INTEGRAL(s, INT64_MIN);
+    SERIALIZE_CHARACTER(s, ' ');
+    SERIALIZE_INTEGRAL(s, INT64_MAX);
+    SERIALIZE_CHARACTER(s, ' ');
+    SERIALIZE_INTEGRAL(s, UINT64_MAX);
+    SERIALIZE_CHARACTER(s, ' ');
+    SERIALIZE_INTEGRAL(s, INT32_MIN);
+    SERIALIZE_CHARACTER(s, ' ');
+    SERIALIZE_INTEGRAL(s, (unsigned char)255);
+    SERIALIZE_CHARACTER(s, ' ');
+    SERIALIZE_INTEGRAL(s, (signed char)-128);
+    SERIALIZE_CHARACTER(s, ' ');
+    SERIALIZE_INTEGRAL(s, (size_t)0);
+    ASSERT_STRING_BUILDER("test_serialize_integral_limits", s,
+        "-9223372036854775808 9223372036854775807 18446744073709551615 -2147483648 255 -128 0");
+    FREE_DARRAY(s);
+}
+
+void test_serialize_integral_digit_counts() {
+    auto s = (StringBuilder){};
+    auto all_correct = true;
+    char expected[32];
+    uint64_t power_of_ten = 1;
+    for (int digits = 1; digits <= 20; ++digits) {
+        uint64_t values[] = {power_of_ten - 1, power_of_ten, power_of_ten + 7};
+        for (size_t i = 0; i < 3; ++i) {
+            CLEAR(s);
+            SERIALIZE_INTEGRAL(s, values[i]);
+            snprintf(expected, sizeof(expected), "%llu", (unsigned long long)values[i]);
+            all_correct = all_correct && s.count == strlen(expected) && strcmp(s.data, expected) == 0;
+        }
+        power_of_ten *= 10;
+    }
+    ASSERT_BOOL("test_serialize_integral_digit_counts", all_correct);
+    FREE_DARRAY(s);
+}
+
 void test_serialize_double() {
     auto s = (StringBuilder){};
     
@@ -1419,11 +2183,62 @@ void test_serialize_double() {
     
     CLEAR(s);
     SERIALIZE_DOUBLE(s, 3.14151965);
-    ASSERT_STRING_BUILDER("test_serialize_double pi", s, "3.141519");
+    ASSERT_STRING_BUILDER("test_serialize_double pi", s, "3.14151965");
 
     FREE_DARRAY(s);
 }
 
+void test_serialize_double_shortest() {
+    auto s = (StringBuilder){};
+    double values[] = {
+        0.1, 0.3, 1.5, -2.25, 123456.789, 1e20, 1e21, 1e-6, 1e-7, 1.5e-7,
+        5e-324, 2.2250738585072014e-308, 1.7976931348623157e308, 9007199254740993.0,
+        1.0 / 0.0, -1.0 / 0.0, 0.0 / 0.0,
+    };
+    const char* expected[] = {
+        "0.1", "0.3", "1.5", "-2.25", "123456.789", "100000000000000000000", "1e+21", "0.000001", "1e-7", "1.5e-7",
+        "5e-324", "2.2250738585072014e-308", "1.7976931348623157e+308", "9007199254740992",
+        "inf", "-inf", "nan",
+    };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        CLEAR(s);
+        SERIALIZE_DOUBLE(s, values[i]);
+        ASSERT_STRING_BUILDER("test_serialize_double_shortest", s, expected[i]);
+    }
+    FREE_DARRAY(s);
+}
+
+void test_serialize_double_float() {
+    auto s = (StringBuilder){};
+    SERIALIZE_DOUBLE(s, 3.14f);
+    SERIALIZE_CHARACTER(s, ' ');
+    SERIALIZE_DOUBLE(s, 0.1f);
+    SERIALIZE_CHARACTER(s, ' ');
+    SERIALIZE_DOUBLE(s, 16777217);
+    ASSERT_STRING_BUILDER("test_serialize_double_float", s, "3.14 0.1 16777217");
+    FREE_DARRAY(s);
+}
+
+void test_serialize_double_round_trip() {
+    auto s = (StringBuilder){};
+    uint64_t state = 3;
+    auto all_correct = true;
+    for (int i = 0; i < 100000; ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        auto bits = state ^ (state >> 29);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (value != value || value - value != 0) {
+            continue;
+        }
+        CLEAR(s);
+        SERIALIZE_DOUBLE(s, value);
+        all_correct = all_correct && strtod(s.data, NULL) == value && s.count < CARMA_MAX_SERIALIZED_DOUBLE_SIZE;
+    }
+    ASSERT_BOOL("test_serialize_double_round_trip", all_correct);
+    FREE_DARRAY(s);
+}
+
 void test_serialize_bool() {
     auto s = (StringBuilder){};
     
@@ -1459,6 +2274,86 @@ void test_parse_int() {
     ASSERT_EQUAL_RANGE("PARSE_INT", string, (STRING_VIEW("")));
 }
 
+void test_try_parse_u64_limits() {
+    auto max = STRING_VIEW("18446744073709551615,");
+    auto too_big = STRING_VIEW("18446744073709551616");
+    auto leading_zeros = STRING_VIEW("000000000000000000000012345678901234567x");
+    auto a = TRY_PARSE_U64(max);
+    auto b = TRY_PARSE_U64(too_big);
+    auto c = TRY_PARSE_U64(leading_zeros);
+    ASSERT_BOOL("test_try_parse_u64_limits", a.ok && a.value == UINT64_MAX && !b.ok && c.ok && c.value == 12345678901234567ull);
+    ASSERT_EQUAL_RANGE("test_try_parse_u64_limits", max, (STRING_VIEW(",")));
+    ASSERT_EQUAL_RANGE("test_try_parse_u64_limits", too_big, (STRING_VIEW("18446744073709551616")));
+    ASSERT_EQUAL_RANGE("test_try_parse_u64_limits", leading_zeros, (STRING_VIEW("x")));
+}
+
+void test_try_parse_u32_limits() {
+    auto max = STRING_VIEW("4294967295");
+    auto too_big = STRING_VIEW("4294967296");
+    auto a = TRY_PARSE_U32(max);
+    auto b = TRY_PARSE_U32(too_big);
+    ASSERT_BOOL("test_try_parse_u32_limits", a.ok && a.value == UINT32_MAX && !b.ok && too_big.count == 10);
+}
+
+void test_try_parse_i32_limits() {
+    auto min = STRING_VIEW("-2147483648");
+    auto max = STRING_VIEW("2147483647");
+    auto too_small = STRING_VIEW("-2147483649");
+    auto too_big = STRING_VIEW("2147483648");
+    auto a = TRY_PARSE_I32(min);
+    auto b = TRY_PARSE_I32(max);
+    auto c = TRY_PARSE_I32(too_small);
+    auto d = TRY_PARSE_I32(too_big);
+    ASSERT_BOOL("test_try_parse_i32_limits", a.ok && a.value == INT32_MIN && b.ok && b.value == INT32_MAX && !c.ok && !d.ok);
+    ASSERT_EQUAL_RANGE("test_try_parse_i32_limits", too_small, (STRING_VIEW("-2147483649")));
+}
+
+void test_try_parse_i64_limits() {
+    auto min = STRING_VIEW("-9223372036854775808");
+    auto max = STRING_VIEW("9223372036854775807");
+    auto too_big = STRING_VIEW("9223372036854775808");
+    auto a = TRY_PARSE_I64(min);
+    auto b = TRY_PARSE_I64(max);
+    auto c = TRY_PARSE_I64(too_big);
+    ASSERT_BOOL("test_try_parse_i64_limits", a.ok && a.value == INT64_MIN && b.ok && b.value == INT64_MAX && !c.ok);
+}
+
+void test_try_parse_int_failure() {
+    auto string = STRING_VIEW("-x");
+    auto result = TRY_PARSE_INT(string);
+    ASSERT_BOOL("test_try_parse_int_failure", !result.ok);
+    ASSERT_EQUAL_RANGE("test_try_parse_int_failure", string, (STRING_VIEW("-x")));
+}
+
+void test_parse_i64_many_lengths() {
+    auto all_correct = true;
+    int64_t expected = 0;
+    char text[32];
+    for (int digits = 1; digits <= 18; ++digits) {
+        expected = 10 * expected + digits % 10;
+        snprintf(text, sizeof(text), "-%lld ", (long long)expected);
+        auto string = STRING_VIEW(text);
+        all_correct = all_correct && PARSE_I64(string) == -expected && string.count == 1;
+    }
+    ASSERT_BOOL("test_parse_i64_many_lengths", all_correct);
+}
+
+void test_parse_u64_many_lengths() {
+    auto all_correct = true;
+    uint64_t expected = 0;
+    char text[32];
+    for (int digits = 1; digits <= 19; ++digits) {
+        expected = 10 * expected + (uint64_t)(digits % 10);
+        snprintf(text, sizeof(text), "%llu", (unsigned long long)expected);
+        auto at_end = STRING_VIEW(text);
+        all_correct = all_correct && PARSE_U64(at_end) == expected && at_end.count == 0;
+        snprintf(text, sizeof(text), "%llu,12345678", (unsigned long long)expected);
+        auto before_more = STRING_VIEW(text);
+        all_correct = all_correct && PARSE_U64(before_more) == expected && before_more.count == 9;
+    }
+    ASSERT_BOOL("test_parse_u64_many_lengths", all_correct);
+}
+
 void test_parse_int_as_string() {
     auto string = STRING_VIEW("+15 , 17");
     auto value = parse_int_as_string(&string);
@@ -1473,6 +2368,74 @@ void test_try_parse_double() {
     ASSERT_EQUAL_RANGE("TRY_PARSE_DOUBLE", string, (STRING_VIEW("")));
 }
 
+void test_try_parse_double_exponent() {
+    auto string = STRING_VIEW("-1.25e-3,2E+2,7e");
+    auto a = TRY_PARSE_DOUBLE(string);
+    DROP_FRONT(string);
+    auto b = TRY_PARSE_DOUBLE(string);
+    DROP_FRONT(string);
+    auto c = TRY_PARSE_DOUBLE(string);
+    ASSERT_BOOL("test_try_parse_double_exponent", a.ok && a.value == -1.25e-3 && b.ok && b.value == 200.0 && c.ok && c.value == 7.0);
+    ASSERT_EQUAL_RANGE("test_try_parse_double_exponent", string, (STRING_VIEW("e")));
+}
+
+void test_try_parse_double_failure() {
+    auto string = STRING_VIEW("-.e5");
+    auto result = TRY_PARSE_DOUBLE(string);
+    ASSERT_BOOL("test_try_parse_double_failure", !result.ok);
+    ASSERT_EQUAL_RANGE("test_try_parse_double_failure", string, (STRING_VIEW("-.e5")));
+}
+
+bool is_parsed_like_strtod(const char* text) {
+    auto string = STRING_VIEW(text);
+    auto result = TRY_PARSE_DOUBLE(string);
+    char* end = NULL;
+    auto expected = strtod(text, &end);
+    return result.ok && memcmp(&result.value, &expected, sizeof(double)) == 0 && string.data == end;
+}
+
+void test_try_parse_double_hard_cases() {
+    const char* texts[] = {
+        "0", "-0", "0.0", "1", "0.1", "0.3", "123456789012345678", "9007199254740993",
+        "1.7976931348623157e308", "1.7976931348623159e308", "2e308",
+        "2.2250738585072011e-308", "2.2250738585072014e-308", "4.9406564584124654e-324",
+        "2.4703282292062327e-324", "2.4703282292062328e-324", "1e-400",
+        "9007199254740992.000000000000000000000001", "9007199254740993.000000000000000000000000",
+        "9007199254740993.000000000000000000000001", "0.000000000000000000000000000000000001e36",
+        "7.2057594037927933e16", "1e23", "8.98846567431158e307", "4.35679e-10",
+        "179769313486231580793728971405303415079934132710037826936173778980444968292764750946649017977587207096330286416692887910946555547851940402630657488671505820681908902000708383676273854845817711531764475730270069855571366959622842914819860834936475292719074168444365510704342711559699508093042880177904174497791.9999999999999999999999999999999999999999999999999999999999999999999999",
+    };
+    auto all_correct = true;
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+        if (!is_parsed_like_strtod(texts[i])) {
+            printf("%s\n", texts[i]);
+            all_correct = false;
+        }
+    }
+    ASSERT_BOOL("test_try_parse_double_hard_cases", all_correct);
+}
+
+// Formats random doubles and checks that they are parsed to the same bits as strtod.
+void test_try_parse_double_round_trip() {
+    const char* formats[] = {"%.17g", "%.16g", "%.15g", "%.6g", "%.3e", "%.25f"};
+    uint64_t state = 1;
+    auto all_correct = true;
+    char text[512];
+    for (int i = 0; i < 100000; ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        auto bits = state ^ (state >> 29);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (value != value || value - value != 0) {
+            continue;
+        }
+        auto format = formats[i % (sizeof(formats) / sizeof(formats[0]))];
+        snprintf(text, sizeof(text), format, value);
+        all_correct = all_correct && is_parsed_like_strtod(text);
+    }
+    ASSERT_BOOL("test_try_parse_double_round_trip", all_correct);
+}
+
 void test_parse_line() {
     auto string = STRING_VIEW("ab\ncd");
     auto value = PARSE_LINE(string);
@@ -1493,6 +2456,77 @@ void test_parse_quoted_string() {
     ASSERT_EQUAL_RANGE("PARSE_QUOTED_STRING", string, (STRING_VIEW(", 1, 2")));
 }
 
+void test_parse_quoted_string_long() {
+    // The quotes and backslashes are found 16 bytes at a time, so put them at every position.
+    auto all_equal = true;
+    char text[80];
+    for (size_t i = 1; i < 60; ++i) {
+        memset(text, 'a', sizeof(text));
+        text[0] = '"';
+        text[i] = '\\';
+        text[i + 1] = '"';
+        text[62] = '"';
+        text[63] = ',';
+        auto string = MAKE(StringView, text, 64);
+        auto value = PARSE_QUOTED_STRING(string);
+        all_equal = all_equal && value.data == text + 1 && value.count == 61 && string.count == 1;
+    }
+    ASSERT_BOOL("test_parse_quoted_string_long", all_equal);
+}
+
+void test_parse_quoted_string_unterminated() {
+    auto unterminated = STRING_VIEW("\"abc");
+    auto dangling = STRING_VIEW("\"abc\\");
+    auto a = PARSE_QUOTED_STRING(unterminated);
+    auto b = PARSE_QUOTED_STRING(dangling);
+    ASSERT_BOOL("test_parse_quoted_string_unterminated",
+        ARE_EQUAL(a, STRING_LITERAL("abc")) && unterminated.count == 4 &&
+        ARE_EQUAL(b, STRING_LITERAL("abc\\")) && dangling.count == 5);
+}
+
+void test_unescape_json_string() {
+    auto escaped = STRING_VIEW("a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t \\u00e9 \\u20AC \\uD83D\\uDE00 \\u0041");
+    auto actual = (StringBuilder){};
+    auto ok = UNESCAPE_JSON_STRING(actual, escaped);
+    APPEND(actual, '\0');
+    ASSERT_BOOL("test_unescape_json_string", ok);
+    ASSERT_EQUAL_STRINGS("test_unescape_json_string", actual.data,
+        "a\"b\\c/d\b\f\n\r\t \xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80 A");
+    FREE_DARRAY(actual);
+}
+
+void test_unescape_json_string_surrogates() {
+    auto actual = (StringBuilder){};
+    auto ok = UNESCAPE_JSON_STRING(actual, STRING_VIEW("\\uD83D|\\uDE00|\\uD83D\\u0041"));
+    APPEND(actual, '\0');
+    ASSERT_BOOL("test_unescape_json_string_surrogates", ok);
+    ASSERT_EQUAL_STRINGS("test_unescape_json_string_surrogates", actual.data,
+        "\xef\xbf\xbd|\xef\xbf\xbd|\xef\xbf\xbd" "A");
+    FREE_DARRAY(actual);
+}
+
+void test_unescape_json_string_invalid() {
+    const char* texts[] = {"\\", "a\\x", "\\u12", "\\u12G4", "\\U0041"};
+    auto actual = (StringBuilder){};
+    SERIALIZE_CSTRING(actual, "kept");
+    auto all_failed = true;
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+        all_failed = all_failed && !UNESCAPE_JSON_STRING(actual, STRING_VIEW(texts[i]));
+    }
+    auto empty_ok = UNESCAPE_JSON_STRING(actual, STRING_VIEW(""));
+    ASSERT_BOOL("test_unescape_json_string_invalid", all_failed && empty_ok && ARE_EQUAL(actual, STRING_LITERAL("kept")));
+    FREE_DARRAY(actual);
+}
+
+void test_unescape_json_string_in_place() {
+    char text[] = "{\"key\": \"tab\\there \\u00e9\"}";
+    auto json = STRING_VIEW(text);
+    auto value = PARSE_JSON_KEY(json, "key");
+    auto decoded = UNESCAPE_JSON_STRING_IN_PLACE(value);
+    ASSERT_BOOL("test_unescape_json_string_in_place",
+        decoded.data == value.data && ARE_EQUAL(decoded, STRING_LITERAL("tab\there \xc3\xa9")));
+}
+
 void test_parse_json_array() {
     auto string = STRING_VIEW("[ 1, 2 ,3 ], 4");
     auto value = PARSE_JSON_ARRAY(string);
@@ -1585,6 +2619,384 @@ void test_parse_json_key_int() {
     ASSERT_EQUAL_INT("test_parse_json_key_int", c, 3);
 }
 
+void test_parse_json_key_scalars() {
+    auto json = STRING_VIEW("{\"a\": true, \"b\": false, \"c\": null, \"d\": -1.5e3, \"e\": \"\", \"f\": 0}");
+    auto all_equal =
+        ARE_EQUAL(PARSE_JSON_KEY(json, "a"), STRING_LITERAL("true")) &&
+        ARE_EQUAL(PARSE_JSON_KEY(json, "b"), STRING_LITERAL("false")) &&
+        ARE_EQUAL(PARSE_JSON_KEY(json, "c"), STRING_LITERAL("null")) &&
+        PARSE_JSON_KEY_DOUBLE(json, "d") == -1500.0 &&
+        PARSE_JSON_KEY_INT(json, "f") == 0;
+    auto empty = PARSE_JSON_KEY(json, "e");
+    auto missing = PARSE_JSON_KEY(json, "g");
+    ASSERT_BOOL("test_parse_json_key_scalars",
+        all_equal && empty.data != NULL && empty.count == 0 && missing.data == NULL);
+}
+
+void test_for_each_json_array_item_scalars() {
+    auto json = STRING_VIEW("[true, null, 1.5, \"\", -0E+1, []]");
+    auto items = (StringViews){};
+    FOR_EACH_JSON_ARRAY_ITEM(item, json) {
+        APPEND(items, item);
+    }
+    ASSERT_BOOL("test_for_each_json_array_item_scalars", items.count == 6 &&
+        ARE_EQUAL(items.data[2], STRING_LITERAL("1.5")) &&
+        IS_EMPTY(items.data[3]) &&
+        ARE_EQUAL(items.data[4], STRING_LITERAL("-0E+1")));
+    FREE_DARRAY(items);
+}
+
+void test_parse_json_scalar_failure() {
+    const char* texts[] = {"", "+1", "-", "1.", "1.e2", "1e", "1e+", ".5", "tru", "nul", "True", "-a"};
+    auto all_failed = true;
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+        auto s = STRING_VIEW(texts[i]);
+        auto scalar = PARSE_JSON_SCALAR(s);
+        all_failed = all_failed && scalar.data == NULL && s.data == texts[i];
+    }
+    ASSERT_BOOL("test_parse_json_scalar_failure", all_failed);
+}
+
+typedef struct JsonConformanceCase {
+    const char* json;
+    bool ok;
+    size_t error_offset;
+} JsonConformanceCase;
+
+void test_validate_json() {
+    // Cases in the style of JSONTestSuite, where the error offset is the first byte that breaks the grammar.
+    JsonConformanceCase cases[] = {
+        {"[]", true, 2},
+        {" {} ", true, 4},
+        {"0", true, 1},
+        {"-0.0e-0", true, 7},
+        {"[1E22, 1e+2, -123.456e-789, 0.5]", true, 32},
+        {"[true, false, null]", true, 19},
+        {"\"\"", true, 2},
+        {"\"\\\" \\\\ \\/ \\b \\f \\n \\r \\t \\u00e9 \\uD834\\uDD1E\"", true, 45},
+        {"\"\xc3\xa9\"", true, 4},
+        {"{\"a\": {\"b\": [[], {}, [{}]]}, \"\": 1}", true, 35},
+        {"", false, 0},
+        {" ", false, 1},
+        {"[", false, 1},
+        {"[1,]", false, 3},
+        {"[,1]", false, 1},
+        {"[1 2]", false, 3},
+        {"[1}", false, 2},
+        {"{\"a\" 1}", false, 5},
+        {"{\"a\": 1,}", false, 8},
+        {"{1: 1}", false, 1},
+        {"{\"a\":}", false, 5},
+        {"[01]", false, 2},
+        {"[+1]", false, 1},
+        {"[.5]", false, 1},
+        {"[1.]", false, 3},
+        {"[1e]", false, 3},
+        {"[-]", false, 2},
+        {"[0x1]", false, 2},
+        {"[tru]", false, 4},
+        {"[nulll]", false, 5},
+        {"[True]", false, 1},
+        {"[NaN]", false, 1},
+        {"[Infinity]", false, 1},
+        {"\"abc", false, 4},
+        {"\"\\x\"", false, 2},
+        {"\"\\u12G4\"", false, 5},
+        {"\"\t\"", false, 1},
+        {"\"a\nb\"", false, 2},
+        {"['a']", false, 1},
+        {"[1] [2]", false, 4},
+        {"1 x", false, 2},
+        {"\v1", false, 0},
+    };
+    auto all_equal = true;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        auto validation = VALIDATE_JSON(STRING_VIEW(cases[i].json));
+        if (validation.ok != cases[i].ok || validation.error_offset != cases[i].error_offset) {
+            printf("%s: ok %d offset %zu\n", cases[i].json, validation.ok, validation.error_offset);
+            all_equal = false;
+        }
+    }
+    ASSERT_BOOL("test_validate_json", all_equal);
+}
+
+void test_validate_json_long_strings() {
+    // Long strings are scanned 16 bytes at a time, so check control characters and escapes at every position.
+    auto all_equal = true;
+    char text[64];
+    for (size_t i = 1; i < 40; ++i) {
+        memset(text, 'a', sizeof(text));
+        text[0] = '"';
+        text[41] = '"';
+        text[42] = '\0';
+        all_equal = all_equal && VALIDATE_JSON(STRING_VIEW(text)).ok;
+        text[i] = '\x1F';
+        auto control = VALIDATE_JSON(STRING_VIEW(text));
+        all_equal = all_equal && !control.ok && control.error_offset == i;
+        text[i] = '\\';
+        text[i + 1] = 'n';
+        all_equal = all_equal && VALIDATE_JSON(STRING_VIEW(text)).ok;
+        text[i + 1] = 'q';
+        auto escape = VALIDATE_JSON(STRING_VIEW(text));
+        all_equal = all_equal && !escape.ok && escape.error_offset == i + 1;
+    }
+    ASSERT_BOOL("test_validate_json_long_strings", all_equal);
+}
+
+void test_make_json_index() {
+    auto json = STRING_VIEW(" {\"a\": [1, [2, 3], \"[x\\\"]\"], \"b\": {\"c\": 4}} trailing");
+    auto index = MAKE_JSON_INDEX(json);
+    // {, a, [, 1, [, 2, 3, "[x\"]", b, {, c, 4
+    ASSERT_EQUAL_SIZE("test_make_json_index count", index.count, 12);
+    ASSERT_EQUAL_SIZE("test_make_json_index root next", index.data[0].next, 12);
+    ASSERT_EQUAL_SIZE("test_make_json_index array next", index.data[2].next, 8);
+    ASSERT_EQUAL_SIZE("test_make_json_index nested array next", index.data[4].next, 7);
+    ASSERT_EQUAL_RANGE("test_make_json_index root", JSON_TOKEN_VALUE(index, 0), (STRING_VIEW("{\"a\": [1, [2, 3], \"[x\\\"]\"], \"b\": {\"c\": 4}}")));
+    ASSERT_EQUAL_RANGE("test_make_json_index string", JSON_TOKEN_VALUE(index, 7), (STRING_VIEW("[x\\\"]")));
+    FREE_JSON_INDEX(index);
+}
+
+void test_make_json_index_broken() {
+    const char* broken[] = {"", "[1, 2", "[1 2]", "{\"a\" 1}", "{\"a\": 1]", "[1,]", "{,}", "[\"abc]", "{1: 2}", "]", "[\v]", "[1,\f2]"};
+    auto all_empty = true;
+    for (size_t i = 0; i < sizeof(broken) / sizeof(broken[0]); ++i) {
+        auto index = MAKE_JSON_INDEX(STRING_VIEW(broken[i]));
+        all_empty = all_empty && index.count == 0 && index.data == NULL;
+    }
+    ASSERT_BOOL("test_make_json_index_broken", all_empty);
+}
+
+void test_parse_json_key_indexed() {
+    auto json = STRING_VIEW("{ \"a\" : [1, {\"b\": 9}] , \"b\": 2 , \"c\": {\"d\": \"e\"} }");
+    auto index = MAKE_JSON_INDEX(json);
+    auto b = PARSE_JSON_KEY_INDEXED(index, json, "b");
+    auto c = PARSE_JSON_KEY_INDEXED(index, json, "c");
+    auto d = PARSE_JSON_KEY_INDEXED(index, c, "d");
+    auto missing = PARSE_JSON_KEY_INDEXED(index, json, "x");
+    auto not_object = PARSE_JSON_KEY_INDEXED(index, b, "b");
+    ASSERT_EQUAL_RANGE("test_parse_json_key_indexed b", b, (STRING_VIEW("2")));
+    ASSERT_EQUAL_RANGE("test_parse_json_key_indexed c", c, (STRING_VIEW("{\"d\": \"e\"}")));
+    ASSERT_EQUAL_RANGE("test_parse_json_key_indexed d", d, (STRING_VIEW("e")));
+    ASSERT_BOOL("test_parse_json_key_indexed missing", IS_EMPTY(missing) && IS_EMPTY(not_object));
+    ASSERT_EQUAL_INT("test_parse_json_key_int_indexed", PARSE_JSON_KEY_INT_INDEXED(index, json, "b"), 2);
+    FREE_JSON_INDEX(index);
+}
+
+void test_for_each_json_array_item_indexed() {
+    auto json = STRING_VIEW("[ 1, [2, 3], {\"a\": 4}, 5 ]");
+    auto index = MAKE_JSON_INDEX(json);
+    auto items = (StringViews){};
+    FOR_EACH_JSON_ARRAY_ITEM_INDEXED(item, index, json) {
+        APPEND(items, item);
+    }
+    ASSERT_EQUAL_SIZE("test_for_each_json_array_item_indexed", items.count, 4);
+    ASSERT_EQUAL_RANGE("test_for_each_json_array_item_indexed", items.data[1], (STRING_VIEW("[2, 3]")));
+    ASSERT_EQUAL_RANGE("test_for_each_json_array_item_indexed", items.data[3], (STRING_VIEW("5")));
+    auto sum = 0;
+    FOR_EACH_JSON_ARRAY_ITEM_INDEXED(item, index, items.data[1]) {
+        sum += PARSE_INT(item);
+    }
+    ASSERT_EQUAL_INT("test_for_each_json_array_item_indexed nested", sum, 5);
+    FREE_DARRAY(items);
+    FREE_JSON_INDEX(index);
+}
+
+void test_for_each_json_object_item_indexed() {
+    auto json = STRING_VIEW("{ \"a\" : 1 , \"b\": [2, 3], \"c\": 4 }");
+    auto index = MAKE_JSON_INDEX(json);
+    auto keys = (StringBuilder){};
+    auto values = (StringViews){};
+    FOR_EACH_JSON_OBJECT_ITEM_INDEXED(k, v, index, json) {
+        CONCAT(keys, k);
+        APPEND(values, v);
+    }
+    ASSERT_EQUAL_RANGE("test_for_each_json_object_item_indexed keys", keys, (STRING_VIEW("abc")));
+    ASSERT_EQUAL_SIZE("test_for_each_json_object_item_indexed values", values.count, 3);
+    ASSERT_EQUAL_RANGE("test_for_each_json_object_item_indexed values", values.data[1], (STRING_VIEW("[2, 3]")));
+    FREE_DARRAY(keys);
+    FREE_DARRAY(values);
+    FREE_JSON_INDEX(index);
+}
+
+void test_for_each_json_item_indexed_nested() {
+    auto json = STRING_VIEW("[[1, 2], [3], {\"a\": [4, 5], \"b\": {\"c\": 6}}]");
+    auto index = MAKE_JSON_INDEX(json);
+    auto keys = (StringBuilder){};
+    auto sum = 0;
+    FOR_EACH_JSON_ARRAY_ITEM_INDEXED(row, index, json) {
+        FOR_EACH_JSON_ARRAY_ITEM_INDEXED(x, index, row) {
+            sum += PARSE_INT(x);
+        }
+        FOR_EACH_JSON_OBJECT_ITEM_INDEXED(key, value, index, row) {
+            CONCAT(keys, key);
+            FOR_EACH_JSON_ARRAY_ITEM_INDEXED(y, index, value) {
+                sum += 10 * PARSE_INT(y);
+            }
+            FOR_EACH_JSON_OBJECT_ITEM_INDEXED(inner_key, inner_value, index, value) {
+                CONCAT(keys, inner_key);
+                sum += 100 * PARSE_INT(inner_value);
+            }
+        }
+    }
+    ASSERT_EQUAL_INT("test_for_each_json_item_indexed_nested", sum, 1 + 2 + 3 + 40 + 50 + 600);
+    ASSERT_EQUAL_RANGE("test_for_each_json_item_indexed_nested keys", keys, (STRING_VIEW("abc")));
+    FREE_DARRAY(keys);
+    FREE_JSON_INDEX(index);
+}
+
+void test_json_index_like_parser() {
+    auto json = STRING_VIEW("{\"x\": 1, \"list\": [10, \"s\\\\\", [], {}, {\"y\": [20]}], \"z\": \"w\"}");
+    auto index = MAKE_JSON_INDEX(json);
+    auto list = PARSE_JSON_KEY(json, "list");
+    auto list_indexed = PARSE_JSON_KEY_INDEXED(index, json, "list");
+    auto items = (StringViews){};
+    auto items_indexed = (StringViews){};
+    FOR_EACH_JSON_ARRAY_ITEM(item, list) {
+        APPEND(items, item);
+    }
+    FOR_EACH_JSON_ARRAY_ITEM_INDEXED(item, index, list_indexed) {
+        APPEND(items_indexed, item);
+    }
+    auto all_equal = items.count == 5 && items.count == items_indexed.count;
+    for (size_t i = 0; all_equal && i < items.count; ++i) {
+        all_equal = items.data[i].data == items_indexed.data[i].data && items.data[i].count == items_indexed.data[i].count;
+    }
+    ASSERT_BOOL("test_json_index_like_parser", all_equal);
+    FREE_DARRAY(items);
+    FREE_DARRAY(items_indexed);
+    FREE_JSON_INDEX(index);
+}
+
+void describe_json_event(StringBuilder* description, JsonEvent event) {
+    switch (event.type) {
+        case JSON_EVENT_BEGIN_OBJECT: APPEND(*description, '{'); break;
+        case JSON_EVENT_END_OBJECT: APPEND(*description, '}'); break;
+        case JSON_EVENT_BEGIN_ARRAY: APPEND(*description, '['); break;
+        case JSON_EVENT_END_ARRAY: APPEND(*description, ']'); break;
+        case JSON_EVENT_KEY: APPEND(*description, 'k'); CONCAT(*description, event.value); break;
+        case JSON_EVENT_STRING: APPEND(*description, 's'); CONCAT(*description, event.value); break;
+        case JSON_EVENT_SCALAR: APPEND(*description, 'v'); CONCAT(*description, event.value); break;
+        case JSON_EVENT_END_DOCUMENT: APPEND(*description, '.'); break;
+        case JSON_EVENT_ERROR: APPEND(*description, '!'); break;
+        case JSON_EVENT_NONE: break;
+    }
+    APPEND(*description, ' ');
+}
+
+// Feeds the json in chunks of the given size and describes the events.
+StringBuilder describe_json_stream(JsonStream stream, StringView json, size_t chunk_size) {
+    auto description = (StringBuilder){};
+    for (size_t i = 0; i < json.count; i += chunk_size) {
+        auto count = json.count - i < chunk_size ? json.count - i : chunk_size;
+        FEED_JSON_STREAM(stream, MAKE(StringView, json.data + i, count));
+        FOR_EACH_JSON_EVENT(event, stream) {
+            describe_json_event(&description, event);
+        }
+    }
+    FINISH_JSON_STREAM(stream);
+    FOR_EACH_JSON_EVENT(event, stream) {
+        describe_json_event(&description, event);
+    }
+    APPEND(description, '\0');
+    FREE_JSON_STREAM(stream);
+    return description;
+}
+
+void test_json_stream() {
+    auto json = STRING_VIEW("{\"a\": [1, -2.5, true], \"b\\\"c\": \"d\\\\\", \"e\": {}, \"f\": []} ");
+    auto expected = "{ ka [ v1 v-2.5 vtrue ] kb\\\"c sd\\\\ ke { } kf [ ] } . ";
+    auto all_equal = true;
+    for (size_t chunk_size = 1; chunk_size <= json.count; ++chunk_size) {
+        auto actual = describe_json_stream(MAKE_JSON_STREAM(), json, chunk_size);
+        if (strcmp(actual.data, expected) != 0) {
+            printf("chunk size %zu: %s\n", chunk_size, actual.data);
+            all_equal = false;
+        }
+        FREE_DARRAY(actual);
+    }
+    ASSERT_BOOL("test_json_stream", all_equal);
+}
+
+void test_json_stream_scalar_root() {
+    auto actual = describe_json_stream(MAKE_JSON_STREAM(), STRING_VIEW("123"), 2);
+    ASSERT_EQUAL_STRINGS("test_json_stream_scalar_root", actual.data, "v123 . ");
+    FREE_DARRAY(actual);
+}
+
+void test_json_stream_errors() {
+    const char* jsons[] = {"", "{\"a\" 1}", "[1 2]", "[1,]", "{\"a\": 1]", "[1] 2", "[\"a", "{\"a\": [1}", "]"};
+    auto all_failed = true;
+    for (size_t i = 0; i < sizeof(jsons) / sizeof(jsons[0]); ++i) {
+        for (size_t chunk_size = 1; chunk_size <= 4; ++chunk_size) {
+            auto actual = describe_json_stream(MAKE_JSON_STREAM(), STRING_VIEW(jsons[i]), chunk_size);
+            all_failed = all_failed && actual.count >= 3 && actual.data[actual.count - 3] == '!';
+            FREE_DARRAY(actual);
+        }
+    }
+    ASSERT_BOOL("test_json_stream_errors", all_failed);
+}
+
+void test_json_stream_error_offset() {
+    auto stream = MAKE_JSON_STREAM();
+    FEED_JSON_STREAM(stream, STRING_VIEW("[1, 2"));
+    FOR_EACH_JSON_EVENT(event, stream) {
+    }
+    FEED_JSON_STREAM(stream, STRING_VIEW(", 3 4]"));
+    auto last_event = MAKE(JsonEvent);
+    FOR_EACH_JSON_EVENT(event, stream) {
+        last_event = event;
+    }
+    ASSERT_BOOL("test_json_stream_error_offset", last_event.type == JSON_EVENT_ERROR && JSON_STREAM_OFFSET(stream) == 9);
+    FREE_JSON_STREAM(stream);
+}
+
+void test_ndjson_stream() {
+    auto json = STRING_VIEW("{\"a\": 1}\n\n[2]\r\n3\n\"4\"\n");
+    auto expected = "{ ka v1 } . [ v2 ] . v3 . s4 . ";
+    auto all_equal = true;
+    for (size_t chunk_size = 1; chunk_size <= json.count; ++chunk_size) {
+        auto actual = describe_json_stream(MAKE_NDJSON_STREAM(), json, chunk_size);
+        all_equal = all_equal && strcmp(actual.data, expected) == 0;
+        FREE_DARRAY(actual);
+    }
+    auto same_line = describe_json_stream(MAKE_NDJSON_STREAM(), STRING_VIEW("[1] [2]\n"), 3);
+    ASSERT_BOOL("test_ndjson_stream", all_equal && strcmp(same_line.data, "[ v1 ] . ! ") == 0);
+    FREE_DARRAY(same_line);
+}
+
+void test_ndjson_file_stream() {
+    // The file is much bigger than the memory that the stream uses, which stays the same for any file size.
+    auto file = tmpfile();
+    auto record_count = 100000;
+    for (int i = 0; i < record_count; ++i) {
+        fprintf(file, "{\"id\": %d, \"name\": \"record \\\"%d\\\"\", \"values\": [%d.5, null]}\n", i, i, i);
+    }
+    auto file_size = ftell(file);
+    rewind(file);
+    auto stream = MAKE_NDJSON_STREAM();
+    stream.chunk_size = 64;
+    auto document_count = 0;
+    auto id_sum = 0ll;
+    auto is_id = false;
+    auto has_error = false;
+    size_t max_token_capacity = 0;
+    FOR_EACH_JSON_FILE_EVENT(event, stream, file) {
+        if (event.type == JSON_EVENT_SCALAR && is_id) {
+            id_sum += PARSE_INT(event.value);
+        }
+        is_id = event.type == JSON_EVENT_KEY && ARE_EQUAL(event.value, STRING_LITERAL("id"));
+        document_count += event.type == JSON_EVENT_END_DOCUMENT;
+        has_error = has_error || event.type == JSON_EVENT_ERROR;
+        max_token_capacity = stream.token.capacity > max_token_capacity ? stream.token.capacity : max_token_capacity;
+    }
+    fclose(file);
+    auto expected_sum = (long long)record_count * (record_count - 1) / 2;
+    auto memory = stream.chunk.capacity + max_token_capacity + stream.stack.capacity;
+    ASSERT_BOOL("test_ndjson_file_stream",
+        !has_error && document_count == record_count && id_sum == expected_sum && memory <= 256 && file_size > 5000000);
+    FREE_JSON_STREAM(stream);
+}
+
 void test_add_json_int() {
     auto actual = (JsonBuilder){};
     ADD_JSON_INT(actual, 1);
@@ -1674,6 +3086,798 @@ void test_add_json_object_multiple() {
     FREE_JSON_BUILDER(actual);
 }
 
+void test_add_json_cstring_escapes() {
+    auto actual = (JsonBuilder){};
+    ADD_JSON_ARRAY(actual) {
+        ADD_JSON_CSTRING(actual, "a\"b\\c\b\f\n\r\t\x01\x1f/\x7f\xc3\xa9");
+    }
+    auto expected = STRING_VIEW("[\"a\\\"b\\\\c\\b\\f\\n\\r\\t\\u0001\\u001f/\x7f\xc3\xa9\"]");
+    ASSERT_EQUAL_CARMA_STRINGS("test_add_json_cstring_escapes", actual.string, expected);
+    ASSERT_BOOL("test_add_json_cstring_escapes null terminated", actual.string.data[actual.string.count] == '\0');
+    FREE_JSON_BUILDER(actual);
+}
+
+void test_add_json_null_terminated() {
+    auto array = (JsonBuilder){};
+    auto object = (JsonBuilder){};
+    RESERVE(array.string, 64);
+    RESERVE(object.string, 64);
+    memset(array.string.data, 'x', array.string.capacity);
+    memset(object.string.data, 'x', object.string.capacity);
+    ADD_JSON_ARRAY(array) {
+        ADD_JSON_INT(array, 1);
+        ADD_JSON_INT(array, 2);
+    }
+    ADD_JSON_OBJECT(object) {
+        ADD_JSON_KEY(object, "a");
+        ADD_JSON_BOOL(object, true);
+    }
+    ASSERT_EQUAL_CARMA_STRINGS("test_add_json_null_terminated array", array.string, (STRING_VIEW("[1,2]")));
+    ASSERT_EQUAL_CARMA_STRINGS("test_add_json_null_terminated object", object.string, (STRING_VIEW("{\"a\":true}")));
+    ASSERT_BOOL("test_add_json_null_terminated array", array.string.data[array.string.count] == '\0');
+    ASSERT_BOOL("test_add_json_null_terminated object", object.string.data[object.string.count] == '\0');
+    FREE_JSON_BUILDER(array);
+    FREE_JSON_BUILDER(object);
+}
+
+void test_add_json_string_view() {
+    auto text = STRING_VIEW("key\"value\"rest");
+    auto actual = (JsonBuilder){};
+    ADD_JSON_OBJECT(actual) {
+        ADD_JSON_KEY_STRING_VIEW(actual, MAKE(StringView, text.data, 4));
+        ADD_JSON_STRING_VIEW(actual, MAKE(StringView, text.data + 4, 6));
+        ADD_JSON_KEY_STRING_VIEW(actual, MAKE(StringView));
+        ADD_JSON_STRING_VIEW(actual, MAKE(StringView));
+    }
+    auto expected = STRING_VIEW("{\"key\\\"\":\"value\\\"\",\"\":\"\"}");
+    ASSERT_EQUAL_CARMA_STRINGS("test_add_json_string_view", actual.string, expected);
+    FREE_JSON_BUILDER(actual);
+}
+
+void test_add_json_string_round_trip() {
+    // Strings of every byte, with the bytes that need escapes at every position of the 16 byte blocks.
+    auto all_equal = true;
+    uint64_t state = 5;
+    char text[100];
+    for (int i = 0; i < 1000; ++i) {
+        auto count = (size_t)(i % 100);
+        for (size_t j = 0; j < count; ++j) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            auto r = state >> 33;
+            text[j] = r % 4 == 0 ? (char)((r >> 8) % 32) : r % 4 == 1 ? "\"\\"[(r >> 8) % 2] : (char)(1 + (r >> 8) % 255);
+        }
+        auto original = MAKE(StringView, text, count);
+        auto json = (JsonBuilder){};
+        ADD_JSON_OBJECT(json) {
+            ADD_JSON_KEY_STRING_VIEW(json, original);
+            ADD_JSON_STRING_VIEW(json, original);
+        }
+        auto json_view = MAKE(StringView, json.string.data, json.string.count);
+        auto decoded_key = (StringBuilder){};
+        auto decoded_value = (StringBuilder){};
+        FOR_EACH_JSON_OBJECT_ITEM(key, value, json_view) {
+            all_equal = all_equal && UNESCAPE_JSON_STRING(decoded_key, key) && UNESCAPE_JSON_STRING(decoded_value, value);
+        }
+        all_equal = all_equal && ARE_EQUAL(decoded_key, original) && ARE_EQUAL(decoded_value, original);
+        all_equal = all_equal && VALIDATE_JSON(MAKE(StringView, json.string.data, json.string.count)).ok;
+        FREE_DARRAY(decoded_key);
+        FREE_DARRAY(decoded_value);
+        FREE_JSON_BUILDER(json);
+    }
+    ASSERT_BOOL("test_add_json_string_round_trip", all_equal);
+}
+
+void test_add_json_int_array() {
+    int64_t values[] = {0, -1, 42, INT64_MIN, INT64_MAX};
+    uint8_t pixels[] = {0, 128, 255};
+    struct {int64_t* data; size_t count;} value_range = {values, 5};
+    struct {uint8_t* data; size_t count;} pixel_range = {pixels, 3};
+    struct {int* data; size_t count;} empty_range = {NULL, 0};
+    auto actual = (JsonBuilder){};
+    ADD_JSON_ARRAY(actual) {
+        ADD_JSON_INT_ARRAY(actual, value_range);
+        ADD_JSON_INT_ARRAY(actual, pixel_range);
+        ADD_JSON_INT_ARRAY(actual, empty_range);
+    }
+    auto expected = STRING_VIEW("[[0,-1,42,-9223372036854775808,9223372036854775807],[0,128,255],[]]");
+    ASSERT_EQUAL_CARMA_STRINGS("test_add_json_int_array", actual.string, expected);
+    ASSERT_BOOL("test_add_json_int_array null terminated", actual.string.data[actual.string.count] == '\0');
+    FREE_JSON_BUILDER(actual);
+}
+
+void test_add_json_double_array() {
+    double doubles[] = {0.1, -2.5, 1e300};
+    float floats[] = {0.1f, 3.14f};
+    struct {double* data; size_t count;} double_range = {doubles, 3};
+    struct {float* data; size_t count;} float_range = {floats, 2};
+    auto actual = (JsonBuilder){};
+    ADD_JSON_OBJECT(actual) {
+        ADD_JSON_KEY(actual, "doubles");
+        ADD_JSON_DOUBLE_ARRAY(actual, double_range);
+        ADD_JSON_KEY(actual, "floats");
+        ADD_JSON_DOUBLE_ARRAY(actual, float_range);
+    }
+    auto expected = STRING_VIEW("{\"doubles\":[0.1,-2.5,1e+300],\"floats\":[0.1,3.14]}");
+    ASSERT_EQUAL_CARMA_STRINGS("test_add_json_double_array", actual.string, expected);
+    ASSERT_BOOL("test_add_json_double_array null terminated", actual.string.data[actual.string.count] == '\0');
+    FREE_JSON_BUILDER(actual);
+}
+
+void test_add_json_bool_array() {
+    bool bools[] = {true, false, true};
+    struct {bool* data; size_t count;} bool_range = {bools, 3};
+    auto actual = (JsonBuilder){};
+    ADD_JSON_BOOL_ARRAY(actual, bool_range);
+    auto expected = STRING_VIEW("[true,false,true]");
+    ASSERT_EQUAL_CARMA_STRINGS("test_add_json_bool_array", actual.string, expected);
+    ASSERT_BOOL("test_add_json_bool_array null terminated", actual.string.data[actual.string.count] == '\0');
+    FREE_JSON_BUILDER(actual);
+}
+
+void test_add_json_int_array_like_add_json_int() {
+    auto values = (IntArray){};
+    for (int i = -500; i < 500; i += 7) {
+        APPEND(values, i * i * i);
+    }
+    auto expected = (JsonBuilder){};
+    ADD_JSON_ARRAY(expected) {
+        FOR_EACH(value, values) {
+            ADD_JSON_INT(expected, *value);
+        }
+    }
+    auto actual = (JsonBuilder){};
+    ADD_JSON_INT_ARRAY(actual, values);
+    ASSERT_EQUAL_CARMA_STRINGS("test_add_json_int_array_like_add_json_int", actual.string, expected.string);
+    FREE_JSON_BUILDER(expected);
+    FREE_JSON_BUILDER(actual);
+    FREE_DARRAY(values);
+}
+
+void double_int(void* item, void* context) {
+    (void)context;
+    int* value = item;
+    *value *= 2;
+}
+
+void test_parallel_for_each() {
+    auto pool = MAKE_THREAD_POOL(4);
+    auto values = (IntArray){};
+    for (int i = 0; i < 10000; ++i) {
+        APPEND(values, i);
+    }
+    PARALLEL_FOR_EACH(pool, values, double_int, NULL);
+    auto errors = 0;
+    FOR_INDEX(i, values) {
+        errors += values.data[i] != 2 * (int)i;
+    }
+    ASSERT_EQUAL_INT("test_parallel_for_each", errors, 0);
+    FREE_DARRAY(values);
+    FREE_THREAD_POOL(pool);
+}
+
+void write_index(size_t index, void* context) {
+    IntArray* values = context;
+    values->data[index] = (int)index;
+}
+
+void test_parallel_for_index() {
+    auto pool = MAKE_THREAD_POOL(3);
+    auto values = (IntArray){};
+    INIT_DARRAY(values, 1001, 1001);
+    PARALLEL_FOR_INDEX_GRAIN(pool, values, 10, write_index, &values);
+    auto errors = 0;
+    FOR_INDEX(i, values) {
+        errors += values.data[i] != (int)i;
+    }
+    ASSERT_EQUAL_INT("test_parallel_for_index", errors, 0);
+    FREE_DARRAY(values);
+    FREE_THREAD_POOL(pool);
+}
+
+void write_position(size_t x, size_t y, void* context) {
+    Image* image = context;
+    image->data[y * image->width + x] += (int)(x + 1000 * y);
+}
+
+void test_parallel_for_xy() {
+    auto pool = MAKE_THREAD_POOL(4);
+    auto image = (Image){};
+    INIT_2D_ARRAY(image, 37, 23);
+    PARALLEL_FOR_XY(pool, image, write_position, &image);
+    auto errors = 0;
+    FOR_Y(y, image) {
+        FOR_X(x, image) {
+            errors += image.data[y * image.width + x] != (int)(x + 1000 * y);
+        }
+    }
+    ASSERT_EQUAL_INT("test_parallel_for_xy", errors, 0);
+    FREE_2D_ARRAY(image);
+    FREE_THREAD_POOL(pool);
+}
+
+void record_chunk(void* task, size_t chunk_index, size_t begin, size_t end) {
+    IntArray* chunks = task;
+    for (size_t i = begin; i < end; ++i) {
+        chunks->data[i] += (int)chunk_index + 1;
+    }
+}
+
+void test_parallel_for_chunks_deterministic() {
+    auto pool = MAKE_THREAD_POOL(5);
+    auto chunks = (IntArray){};
+    INIT_DARRAY(chunks, 1000, 1000);
+    parallel_for_chunks(pool, chunks.count, 7, record_chunk, &chunks);
+    auto errors = 0;
+    FOR_INDEX(i, chunks) {
+        errors += chunks.data[i] != (int)(i / 7) + 1;
+    }
+    ASSERT_EQUAL_INT("test_parallel_for_chunks_deterministic parallel", errors, 0);
+    FILL(chunks, 0);
+    parallel_for_chunks(NULL, chunks.count, 7, record_chunk, &chunks);
+    errors = 0;
+    FOR_INDEX(i, chunks) {
+        errors += chunks.data[i] != (int)(i / 7) + 1;
+    }
+    ASSERT_EQUAL_INT("test_parallel_for_chunks_deterministic sequential", errors, 0);
+    FREE_DARRAY(chunks);
+    FREE_THREAD_POOL(pool);
+}
+
+void test_parallel_for_each_empty() {
+    auto pool = MAKE_THREAD_POOL(2);
+    auto values = (IntArray){};
+    PARALLEL_FOR_EACH(pool, values, double_int, NULL);
+    ASSERT_EQUAL_SIZE("test_parallel_for_each_empty", values.count, 0);
+    FREE_THREAD_POOL(pool);
+}
+
+void test_parallel_for_each_reuse_pool() {
+    auto pool = MAKE_THREAD_POOL(4);
+    auto values = (IntArray){};
+    for (int i = 0; i < 100; ++i) {
+        APPEND(values, 1);
+    }
+    for (int i = 0; i < 20; ++i) {
+        PARALLEL_FOR_EACH_GRAIN(pool, values, 1, double_int, NULL);
+    }
+    auto errors = 0;
+    FOR_EACH(value, values) {
+        errors += *value != 1 << 20;
+    }
+    ASSERT_EQUAL_INT("test_parallel_for_each_reuse_pool", errors, 0);
+    FREE_DARRAY(values);
+    FREE_THREAD_POOL(pool);
+}
+
+typedef struct {
+    ThreadPool* pool;
+    Image image;
+} NestedParallelContext;
+
+void write_nested_row(size_t y, void* context) {
+    NestedParallelContext* nested = context;
+    auto row = (IntArray){.data=nested->image.data + y * nested->image.width, .count=nested->image.width};
+    PARALLEL_FOR_EACH(nested->pool, row, double_int, NULL);
+}
+
+void test_parallel_for_index_nested() {
+    auto nested = (NestedParallelContext){.pool=MAKE_THREAD_POOL(4)};
+    INIT_2D_ARRAY(nested.image, 100, 8);
+    FILL(nested.image, 1);
+    PARALLEL_FOR_INDEX_GRAIN(nested.pool, MAKE(IntRange, .count=nested.image.height), 1, write_nested_row, &nested);
+    auto errors = 0;
+    FOR_EACH(value, nested.image) {
+        errors += *value != 2;
+    }
+    ASSERT_EQUAL_INT("test_parallel_for_index_nested", errors, 0);
+    FREE_2D_ARRAY(nested.image);
+    FREE_THREAD_POOL(nested.pool);
+}
+
+int append_digit(int number, int digit) {
+    return 10 * number + digit;
+}
+
+void test_reduce() {
+    auto values = (IntArray){};
+    for (int i = 1; i <= 5; ++i) {
+        APPEND(values, i);
+    }
+    REDUCE(sum, values, 0, CARMA_ADD);
+    ASSERT_EQUAL_INT("test_reduce sum", sum, 15);
+    REDUCE(digits, values, 9, append_digit);
+    ASSERT_EQUAL_INT("test_reduce order", digits, 912345);
+    REDUCE(max, values, 0, CARMA_MAX);
+    ASSERT_EQUAL_INT("test_reduce max", max, 5);
+    REDUCE(empty, (IntRange){}, 7, CARMA_ADD);
+    ASSERT_EQUAL_INT("test_reduce empty", empty, 7);
+    FREE_DARRAY(values);
+}
+
+void test_reduce_lanes() {
+    auto values = (IntArray){};
+    for (int i = 1; i <= 1001; ++i) {
+        APPEND(values, i);
+    }
+    REDUCE_LANES(sum, values, 0, CARMA_ADD);
+    ASSERT_EQUAL_INT("test_reduce_lanes sum", sum, 1001 * 1002 / 2);
+    REDUCE_LANES(min, values, INT_MAX, CARMA_MIN);
+    ASSERT_EQUAL_INT("test_reduce_lanes min", min, 1);
+    REDUCE_LANES(max, values, INT_MIN, CARMA_MAX);
+    ASSERT_EQUAL_INT("test_reduce_lanes max", max, 1001);
+    values.count = 3;
+    REDUCE_LANES(short_sum, values, 0, CARMA_ADD);
+    ASSERT_EQUAL_INT("test_reduce_lanes short", short_sum, 6);
+    REDUCE_LANES(empty, (IntRange){}, 0, CARMA_ADD);
+    ASSERT_EQUAL_INT("test_reduce_lanes empty", empty, 0);
+    FREE_DARRAY(values);
+}
+
+void test_parallel_sum() {
+    auto pool = MAKE_THREAD_POOL(4);
+    auto values = (IntArray){};
+    for (int i = 0; i < 100000; ++i) {
+        APPEND(values, i % 1000 - 300);
+    }
+    REDUCE(expected, values, 0, CARMA_ADD);
+    ASSERT_EQUAL_INT("test_parallel_sum", PARALLEL_SUM(pool, values), expected);
+    ASSERT_EQUAL_INT("test_parallel_sum grain", PARALLEL_SUM_GRAIN(pool, values, 3), expected);
+    ASSERT_EQUAL_INT("test_parallel_sum empty", PARALLEL_SUM(pool, (IntRange){}), 0);
+    FREE_DARRAY(values);
+    FREE_THREAD_POOL(pool);
+}
+
+void test_parallel_sum_double_deterministic() {
+    auto values = (DoubleArray){};
+    uint64_t state = 12345;
+    for (int i = 0; i < 100003; ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        APPEND(values, (double)(state >> 11) * 0x1.0p-53 * (i % 7 == 0 ? 1e9 : 1.0));
+    }
+    auto expected = PARALLEL_SUM(NULL, values);
+    auto expected_blocks = PARALLEL_SUM_GRAIN(NULL, values, 1);
+    size_t thread_counts[] = {1, 2, 3, 8};
+    auto errors = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        auto pool = MAKE_THREAD_POOL(thread_counts[i]);
+        for (int run = 0; run < 3; ++run) {
+            auto actual = PARALLEL_SUM(pool, values);
+            errors += memcmp(&actual, &expected, sizeof(double)) != 0;
+            auto actual_blocks = PARALLEL_SUM_GRAIN(pool, values, 1);
+            errors += memcmp(&actual_blocks, &expected_blocks, sizeof(double)) != 0;
+        }
+        FREE_THREAD_POOL(pool);
+    }
+    ASSERT_EQUAL_INT("test_parallel_sum_double_deterministic", errors, 0);
+    REDUCE(sequential, values, 0.0, CARMA_ADD);
+    ASSERT_LESS_SIZE("test_parallel_sum_double_deterministic close", (size_t)fabs(expected - sequential), 1);
+    ASSERT_LESS_SIZE("test_parallel_sum_double_deterministic blocks", (size_t)fabs(expected_blocks - sequential), 1);
+    FREE_DARRAY(values);
+}
+
+void test_parallel_min_max() {
+    auto pool = MAKE_THREAD_POOL(3);
+    auto values = (I64Array){};
+    for (int64_t i = 0; i < 10000; ++i) {
+        APPEND(values, (i * 7919) % 10007 - 5000);
+    }
+    values.data[4321] = INT64_MIN;
+    values.data[1234] = INT64_MAX;
+    ASSERT_EQUAL_INT("test_parallel_min_max min", PARALLEL_MIN(pool, values) == INT64_MIN, true);
+    ASSERT_EQUAL_INT("test_parallel_min_max max", PARALLEL_MAX(pool, values) == INT64_MAX, true);
+    FREE_DARRAY(values);
+
+    auto floats = (FloatArray){};
+    for (int i = 0; i < 777; ++i) {
+        APPEND(floats, (float)(i % 100) - 0.5f);
+    }
+    ASSERT_EQUAL_DOUBLE("test_parallel_min_max float min", PARALLEL_MIN_GRAIN(pool, floats, 10), -0.5);
+    ASSERT_EQUAL_DOUBLE("test_parallel_min_max float max", PARALLEL_MAX_GRAIN(pool, floats, 10), 98.5);
+    FREE_DARRAY(floats);
+
+    auto bytes = (ByteArray){};
+    for (int i = 0; i < 300; ++i) {
+        APPEND(bytes, (uint8_t)(i + 10));
+    }
+    ASSERT_EQUAL_INT("test_parallel_min_max bytes min", PARALLEL_MIN(pool, bytes), 0);
+    ASSERT_EQUAL_INT("test_parallel_min_max bytes max", PARALLEL_MAX(pool, bytes), 255);
+    FREE_DARRAY(bytes);
+    FREE_THREAD_POOL(pool);
+}
+
+void xor_int(void* accumulator, const void* item) {
+    *(int*)accumulator ^= *(const int*)item;
+}
+
+void test_parallel_reduce() {
+    auto pool = MAKE_THREAD_POOL(4);
+    auto values = (IntArray){};
+    auto expected = 0;
+    for (int i = 0; i < 5000; ++i) {
+        APPEND(values, i * 2654435761u >> 3);
+        expected ^= values.data[i];
+    }
+    ASSERT_EQUAL_INT("test_parallel_reduce", PARALLEL_REDUCE(pool, values, 0, xor_int), expected);
+    ASSERT_EQUAL_INT("test_parallel_reduce grain", PARALLEL_REDUCE_GRAIN(pool, values, 1, 0, xor_int), expected);
+    for (int i = 5000; i < 50000; ++i) {
+        APPEND(values, i * 2654435761u >> 3);
+        expected ^= values.data[i];
+    }
+    ASSERT_EQUAL_INT("test_parallel_reduce blocks", PARALLEL_REDUCE_GRAIN(pool, values, 1, 0, xor_int), expected);
+    ASSERT_EQUAL_INT("test_parallel_reduce uneven blocks", PARALLEL_REDUCE_GRAIN(pool, values, 7, 0, xor_int), expected);
+    ASSERT_EQUAL_INT("test_parallel_reduce empty", PARALLEL_REDUCE(pool, (IntRange){}, 5, xor_int), 5);
+    FREE_DARRAY(values);
+    FREE_THREAD_POOL(pool);
+}
+
+uint64_t sort_test_random(uint64_t* state) {
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return *state >> 33;
+}
+
+bool is_sorted_int(IntArray values) {
+    for (size_t i = 1; i < values.count; ++i) {
+        if (values.data[i] < values.data[i - 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_sort() {
+    size_t counts[] = {0, 1, 2, 3, 16, 17, 100, 1000, 10007};
+    auto errors = 0;
+    for (size_t c = 0; c < 9; ++c) {
+        // Random, increasing, decreasing, few distinct and organ pipe items.
+        for (int pattern = 0; pattern < 5; ++pattern) {
+            auto values = (IntArray){};
+            uint64_t state = counts[c];
+            int64_t sum = 0;
+            for (size_t i = 0; i < counts[c]; ++i) {
+                int n = (int)i;
+                int item = pattern == 0 ? (int)(sort_test_random(&state) % 2000000) - 1000000 :
+                    pattern == 1 ? n : pattern == 2 ? -n : pattern == 3 ? n % 3 :
+                    n < (int)counts[c] / 2 ? n : (int)counts[c] - n;
+                APPEND(values, item);
+                sum += item;
+            }
+            SORT(values, CARMA_LESS);
+            REDUCE(sorted_sum, values, (int64_t)0, CARMA_ADD);
+            errors += !is_sorted_int(values) || sorted_sum != sum;
+            FREE_DARRAY(values);
+        }
+    }
+    ASSERT_EQUAL_INT("test_sort", errors, 0);
+}
+
+void test_sort_greater() {
+    auto actual = MAKE_DARRAY(IntArray, 3, 1, 4, 1, 5, 9, 2, 6);
+    auto expected = MAKE_DARRAY(IntArray, 9, 6, 5, 4, 3, 2, 1, 1);
+    SORT(actual, CARMA_GREATER);
+    ASSERT_EQUAL_RANGE("test_sort_greater", actual, expected);
+    FREE_DARRAY(actual);
+    FREE_DARRAY(expected);
+}
+
+typedef struct {
+    double x;
+    int id;
+} SortPoint;
+
+typedef struct {
+    SortPoint* data;
+    size_t count;
+    size_t capacity;
+} SortPoints;
+
+#define SORT_POINT_X(point) (point).x
+
+bool sort_point_id_greater(SortPoint a, SortPoint b) {
+    return a.id > b.id;
+}
+
+void test_sort_by_key() {
+    auto points = (SortPoints){};
+    for (int i = 0; i < 100; ++i) {
+        APPEND(points, ((SortPoint){(double)((i * 37) % 100) - 50.0, i}));
+    }
+    SORT_BY_KEY(points, SORT_POINT_X);
+    auto errors = 0;
+    FOR_INDEX(i, points) {
+        errors += points.data[i].x != (double)i - 50.0;
+        errors += (points.data[i].id * 37) % 100 != (int)i;
+    }
+    ASSERT_EQUAL_INT("test_sort_by_key", errors, 0);
+    SORT(points, sort_point_id_greater);
+    errors = 0;
+    FOR_INDEX(i, points) {
+        errors += points.data[i].id != 99 - (int)i;
+    }
+    ASSERT_EQUAL_INT("test_sort_by_key function", errors, 0);
+    FREE_DARRAY(points);
+}
+
+// McIlroy's adversary for quicksort, that decides the order of the items while they are compared,
+// so that each pivot is as bad as possible. Without the heapsort fallback this takes quadratic time.
+typedef struct {
+    int* values;
+    int gas;
+    int solid_count;
+    int candidate;
+    size_t compare_count;
+} SortAdversary;
+
+SortAdversary sort_adversary;
+
+bool sort_adversary_less(int a, int b) {
+    SortAdversary* s = &sort_adversary;
+    s->compare_count++;
+    if (s->values[a] == s->gas && s->values[b] == s->gas) {
+        s->values[a == s->candidate ? a : b] = s->solid_count++;
+    }
+    if (s->values[a] == s->gas) {
+        s->candidate = a;
+    } else if (s->values[b] == s->gas) {
+        s->candidate = b;
+    }
+    return s->values[a] < s->values[b];
+}
+
+void test_sort_adversary() {
+    auto count = 20000;
+    auto items = (IntArray){};
+    auto values = (IntArray){};
+    for (int i = 0; i < count; ++i) {
+        APPEND(items, i);
+        APPEND(values, count);
+    }
+    sort_adversary = (SortAdversary){values.data, count, 0, 0, 0};
+    SORT(items, sort_adversary_less);
+    auto errors = 0;
+    for (int i = 1; i < count; ++i) {
+        errors += values.data[items.data[i]] < values.data[items.data[i - 1]];
+    }
+    ASSERT_EQUAL_INT("test_sort_adversary sorted", errors, 0);
+    // count * log2(count) is about 290000.
+    ASSERT_LESS_SIZE("test_sort_adversary compares", sort_adversary.compare_count, 10 * 290000);
+    FREE_DARRAY(items);
+    FREE_DARRAY(values);
+}
+
+void test_radix_sort() {
+    auto integers = (I64Array){};
+    auto expected_integers = (I64Array){};
+    auto floats = (FloatArray){};
+    auto expected_floats = (FloatArray){};
+    auto bytes = (ByteArray){};
+    auto expected_bytes = (ByteArray){};
+    uint64_t state = 99;
+    for (int i = 0; i < 5000; ++i) {
+        int64_t integer = (int64_t)(sort_test_random(&state) << 31 ^ sort_test_random(&state));
+        integer = i % 3 == 0 ? -integer : i % 3 == 1 ? integer % 1000 - 500 : integer;
+        APPEND(integers, integer);
+        APPEND(expected_integers, integer);
+        float x = i % 5 == 0 ? -0.0f : ((float)sort_test_random(&state) - 1e9f) * (i % 2 ? 1e-6f : 1e3f);
+        APPEND(floats, x);
+        APPEND(expected_floats, x);
+        APPEND(bytes, (unsigned char)integer);
+        APPEND(expected_bytes, (unsigned char)integer);
+    }
+    APPEND(integers, INT64_MIN);
+    APPEND(expected_integers, INT64_MIN);
+    APPEND(integers, INT64_MAX);
+    APPEND(expected_integers, INT64_MAX);
+    RADIX_SORT(integers);
+    SORT(expected_integers, CARMA_LESS);
+    ASSERT_EQUAL_INT("test_radix_sort int64", ARE_EQUAL(integers, expected_integers), true);
+    RADIX_SORT(floats);
+    SORT(expected_floats, CARMA_LESS);
+    auto errors = 0;
+    FOR_INDEX(i, floats) {
+        errors += floats.data[i] != expected_floats.data[i];
+    }
+    ASSERT_EQUAL_INT("test_radix_sort float", errors, 0);
+    RADIX_SORT(bytes);
+    SORT(expected_bytes, CARMA_LESS);
+    ASSERT_EQUAL_RANGE("test_radix_sort bytes", bytes, expected_bytes);
+    auto empty = (IntRange){};
+    RADIX_SORT(empty);
+    ASSERT_EQUAL_SIZE("test_radix_sort empty", empty.count, 0);
+    FREE_DARRAY(integers);
+    FREE_DARRAY(expected_integers);
+    FREE_DARRAY(floats);
+    FREE_DARRAY(expected_floats);
+    FREE_DARRAY(bytes);
+    FREE_DARRAY(expected_bytes);
+}
+
+void test_radix_sort_negative_zero() {
+    auto values = MAKE_DARRAY(DoubleArray, 0.0, -1.5, -0.0, 2.0, -1e300, 1e-300);
+    RADIX_SORT(values);
+    ASSERT_EQUAL_DOUBLE("test_radix_sort_negative_zero 0", values.data[0], -1e300);
+    ASSERT_EQUAL_DOUBLE("test_radix_sort_negative_zero 1", values.data[1], -1.5);
+    ASSERT_EQUAL_INT("test_radix_sort_negative_zero sign", signbit(values.data[2]) != 0, 1);
+    ASSERT_EQUAL_INT("test_radix_sort_negative_zero positive", signbit(values.data[3]) != 0, 0);
+    ASSERT_EQUAL_DOUBLE("test_radix_sort_negative_zero 4", values.data[4], 1e-300);
+    ASSERT_EQUAL_DOUBLE("test_radix_sort_negative_zero 5", values.data[5], 2.0);
+    FREE_DARRAY(values);
+}
+
+#define SORT_POINT_ID_MOD(point) ((point).id % 10 - 5)
+
+void test_radix_sort_by_key_stable() {
+    auto points = (SortPoints){};
+    for (int i = 0; i < 1000; ++i) {
+        APPEND(points, ((SortPoint){(double)i, (i * 7) % 1000}));
+    }
+    RADIX_SORT_BY_KEY(points, SORT_POINT_ID_MOD);
+    auto errors = 0;
+    for (size_t i = 1; i < points.count; ++i) {
+        auto a = points.data[i - 1];
+        auto b = points.data[i];
+        errors += SORT_POINT_ID_MOD(b) < SORT_POINT_ID_MOD(a);
+        errors += SORT_POINT_ID_MOD(b) == SORT_POINT_ID_MOD(a) && b.x < a.x;
+    }
+    ASSERT_EQUAL_INT("test_radix_sort_by_key_stable", errors, 0);
+    FREE_DARRAY(points);
+}
+
+void test_parallel_sort() {
+    auto pool = MAKE_THREAD_POOL(4);
+    auto errors = 0;
+    size_t counts[] = {0, 1, 100, 1001, 30011};
+    size_t grains[] = {1, 7, 100, 4096, 0};
+    for (size_t c = 0; c < 5; ++c) {
+        for (size_t g = 0; g < 5; ++g) {
+            auto values = (I64Array){};
+            auto expected = (I64Array){};
+            uint64_t state = counts[c] + grains[g];
+            for (size_t i = 0; i < counts[c]; ++i) {
+                int64_t item = (int64_t)sort_test_random(&state) % 1000 - 500;
+                APPEND(values, item);
+                APPEND(expected, item);
+            }
+            PARALLEL_SORT_GRAIN(g % 2 ? NULL : pool, values, grains[g]);
+            SORT(expected, CARMA_LESS);
+            errors += !ARE_EQUAL(values, expected);
+            FREE_DARRAY(values);
+            FREE_DARRAY(expected);
+        }
+    }
+    ASSERT_EQUAL_INT("test_parallel_sort", errors, 0);
+    FREE_THREAD_POOL(pool);
+}
+
+DEFINE_PARALLEL_SORT_BY_KEY(parallel_sort_points_by_x, SortPoint, SORT_POINT_X)
+DEFINE_PARALLEL_SORT(parallel_sort_points_by_id, SortPoint, sort_point_id_greater)
+
+void test_parallel_sort_by_key() {
+    auto pool = MAKE_THREAD_POOL(3);
+    auto points = (SortPoints){};
+    auto count = 50000;
+    for (int i = 0; i < count; ++i) {
+        APPEND(points, ((SortPoint){(double)((i * 7919) % count), i}));
+    }
+    parallel_sort_points_by_x(pool, points.data, points.count);
+    auto errors = 0;
+    FOR_INDEX(i, points) {
+        errors += points.data[i].x != (double)i;
+    }
+    ASSERT_EQUAL_INT("test_parallel_sort_by_key", errors, 0);
+    parallel_sort_points_by_id(pool, points.data, points.count);
+    errors = 0;
+    FOR_INDEX(i, points) {
+        errors += points.data[i].id != count - 1 - (int)i;
+    }
+    ASSERT_EQUAL_INT("test_parallel_sort_by_key less", errors, 0);
+    FREE_DARRAY(points);
+    FREE_THREAD_POOL(pool);
+}
+
+void test_lower_upper_bound() {
+    auto values = MAKE_DARRAY(IntArray, 1, 3, 3, 3, 5, 8, 8, 13);
+    LOWER_BOUND(lower_3, values, 3);
+    UPPER_BOUND(upper_3, values, 3);
+    LOWER_BOUND(lower_4, values, 4);
+    UPPER_BOUND(upper_4, values, 4);
+    LOWER_BOUND(lower_0, values, 0);
+    LOWER_BOUND(lower_20, values, 20);
+    UPPER_BOUND(upper_13, values, 13);
+    ASSERT_EQUAL_SIZE("test_lower_upper_bound lower 3", lower_3, 1);
+    ASSERT_EQUAL_SIZE("test_lower_upper_bound upper 3", upper_3, 4);
+    ASSERT_EQUAL_SIZE("test_lower_upper_bound lower 4", lower_4, 4);
+    ASSERT_EQUAL_SIZE("test_lower_upper_bound upper 4", upper_4, 4);
+    ASSERT_EQUAL_SIZE("test_lower_upper_bound lower 0", lower_0, 0);
+    ASSERT_EQUAL_SIZE("test_lower_upper_bound lower 20", lower_20, 8);
+    ASSERT_EQUAL_SIZE("test_lower_upper_bound upper 13", upper_13, 8);
+    auto empty = (IntRange){};
+    LOWER_BOUND(lower_empty, empty, 3);
+    ASSERT_EQUAL_SIZE("test_lower_upper_bound empty", lower_empty, 0);
+    FREE_DARRAY(values);
+}
+
+void test_lower_bound_all_counts() {
+    auto errors = 0;
+    for (int count = 0; count < 40; ++count) {
+        auto values = (IntArray){};
+        for (int i = 0; i < count; ++i) {
+            APPEND(values, 2 * i);
+        }
+        for (int value = -1; value <= 2 * count; ++value) {
+            LOWER_BOUND(lower, values, value);
+            UPPER_BOUND(upper, values, value);
+            errors += lower != (size_t)(value + 1) / 2;
+            errors += upper != carma_min_count((size_t)(value + 2) / 2, values.count);
+        }
+        FREE_DARRAY(values);
+    }
+    ASSERT_EQUAL_INT("test_lower_bound_all_counts", errors, 0);
+}
+
+void test_equal_range_binary_search() {
+    auto values = MAKE_DARRAY(DoubleArray, 0.5, 1.0, 2.0, 2.0, 2.0, 7.5);
+    EQUAL_RANGE(first, last, values, 2.0);
+    ASSERT_EQUAL_SIZE("test_equal_range first", first, 2);
+    ASSERT_EQUAL_SIZE("test_equal_range last", last, 5);
+    BINARY_SEARCH(has_7_5, values, 7.5);
+    BINARY_SEARCH(has_3, values, 3.0);
+    BINARY_SEARCH(has_8, values, 8.0);
+    ASSERT_EQUAL_INT("test_binary_search found", has_7_5, true);
+    ASSERT_EQUAL_INT("test_binary_search missing", has_3, false);
+    ASSERT_EQUAL_INT("test_binary_search after end", has_8, false);
+    FREE_DARRAY(values);
+}
+
+void test_lower_bound_by_key() {
+    auto points = (SortPoints){};
+    for (int i = 0; i < 10; ++i) {
+        APPEND(points, ((SortPoint){0.5 * i, i}));
+    }
+    LOWER_BOUND_BY_KEY(lower, points, SORT_POINT_X, 2.0);
+    UPPER_BOUND_BY_KEY(upper, points, SORT_POINT_X, 2.0);
+    ASSERT_EQUAL_SIZE("test_lower_bound_by_key lower", lower, 4);
+    ASSERT_EQUAL_SIZE("test_lower_bound_by_key upper", upper, 5);
+    FREE_DARRAY(points);
+}
+
+void test_eytzinger() {
+    auto errors = 0;
+    for (int count = 0; count < 70; ++count) {
+        auto sorted = (IntArray){};
+        for (int i = 0; i < count; ++i) {
+            APPEND(sorted, 3 * i);
+        }
+        auto index = (IntRange){};
+        INIT_EYTZINGER(index, sorted);
+        errors += index.count != sorted.count;
+        for (int value = -2; value <= 3 * count; ++value) {
+            LOWER_BOUND(expected, sorted, value);
+            EYTZINGER_LOWER_BOUND(actual, index, value);
+            errors += actual == index.count ? expected != sorted.count : index.data[actual] != sorted.data[expected];
+        }
+        FREE_RANGE(index);
+        FREE_DARRAY(sorted);
+    }
+    ASSERT_EQUAL_INT("test_eytzinger", errors, 0);
+}
+
+void test_eytzinger_by_key() {
+    auto points = (SortPoints){};
+    for (int i = 0; i < 100; ++i) {
+        APPEND(points, ((SortPoint){(double)(i / 2), i}));
+    }
+    auto index = (SortPoints){};
+    INIT_EYTZINGER(index, points);
+    EYTZINGER_LOWER_BOUND_BY_KEY(found, index, SORT_POINT_X, 10.5);
+    EYTZINGER_LOWER_BOUND_BY_KEY(first_equal, index, SORT_POINT_X, 20.0);
+    EYTZINGER_LOWER_BOUND_BY_KEY(missing, index, SORT_POINT_X, 100.0);
+    ASSERT_EQUAL_INT("test_eytzinger_by_key found", index.data[found].id, 22);
+    ASSERT_EQUAL_INT("test_eytzinger_by_key first equal", index.data[first_equal].id, 40);
+    ASSERT_EQUAL_SIZE("test_eytzinger_by_key missing", missing, index.count);
+    FREE_RANGE(index);
+    FREE_DARRAY(points);
+}
+
 int main() {
     test_2d_array();
     test_3d_array();
@@ -1718,6 +3922,12 @@ int main() {
 
     test_copy_inplace();
     test_copy_backward_inplace();
+    test_fill_evaluates_value_once();
+    test_stream_fill();
+    test_copy_overlap_forward();
+    test_copy_backward_overlap_backward();
+    test_copy_backward_different_counts();
+    test_copy_converts_items();
 
     test_replace();
 
@@ -1771,6 +3981,25 @@ int main() {
     test_prepend();
     test_concat();
 
+    test_append_arena();
+    test_concat_arena();
+    test_rewind_arena();
+    test_serialize_arena();
+    test_for_each_line();
+    test_for_each_line_trailing_line_break();
+    test_for_each_line_empty();
+    test_for_each_stream_line();
+    test_read_text_file();
+    test_read_text_file_missing();
+    test_read_binary_file();
+    test_read_stream();
+    test_map_file();
+    test_map_file_missing();
+    test_read_mapped_file();
+
+    test_allocator();
+    test_arena_allocator();
+
     test_insert_index0();
     test_insert_index1a();
     test_insert_index1b();
@@ -1791,6 +4020,9 @@ int main() {
 
     test_for_each_word();
     test_for_each_word_predicate();
+    test_for_each_word_empty_words();
+    test_for_each_word_in_set();
+    test_for_each_word_in_set_predicate();
     test_string_view();
     test_serialize_cstring();
     test_format_string();
@@ -1806,19 +4038,56 @@ int main() {
     
     test_table_available_key();
     test_table_available_keys();
+    test_table_many_keys();
+    test_table_many_range_keys();
+    test_table_erase_key();
+    test_table_erase_key_empty();
+    test_table_erase_many_keys();
+    test_table_erase_range_key();
+    test_erase_table_if();
+    test_table_incremental();
+    test_table_incremental_overwrite();
+    test_for_each_table_incremental();
+    test_table_erase_key_incremental();
+    test_table_range_key_hashed();
+    test_table_many_range_keys_hashed();
+    test_table_erase_range_key_hashed();
+    test_hash_bytes();
 
     test_serialize_integral();
+    test_serialize_integral_limits();
+    test_serialize_integral_digit_counts();
     test_serialize_double();
+    test_serialize_double_shortest();
+    test_serialize_double_float();
+    test_serialize_double_round_trip();
     test_serialize_bool();
     
     test_try_parse_u64();
     test_try_parse_int();
     test_parse_int();
     test_parse_int_as_string();
+    test_try_parse_u64_limits();
+    test_try_parse_u32_limits();
+    test_try_parse_i32_limits();
+    test_try_parse_i64_limits();
+    test_try_parse_int_failure();
+    test_parse_i64_many_lengths();
+    test_parse_u64_many_lengths();
     test_try_parse_double();
+    test_try_parse_double_exponent();
+    test_try_parse_double_failure();
+    test_try_parse_double_hard_cases();
+    test_try_parse_double_round_trip();
     test_parse_line();
     test_parse_whitespace();
     test_parse_quoted_string();
+    test_parse_quoted_string_long();
+    test_parse_quoted_string_unterminated();
+    test_unescape_json_string();
+    test_unescape_json_string_surrogates();
+    test_unescape_json_string_invalid();
+    test_unescape_json_string_in_place();
 
     test_parse_json_array();
     test_parse_json_object();
@@ -1828,6 +4097,24 @@ int main() {
     test_for_each_json_object_item();
     test_parse_json_key();
     test_parse_json_key_int();
+    test_parse_json_key_scalars();
+    test_for_each_json_array_item_scalars();
+    test_parse_json_scalar_failure();
+    test_validate_json();
+    test_validate_json_long_strings();
+    test_make_json_index();
+    test_make_json_index_broken();
+    test_parse_json_key_indexed();
+    test_for_each_json_array_item_indexed();
+    test_for_each_json_object_item_indexed();
+    test_for_each_json_item_indexed_nested();
+    test_json_index_like_parser();
+    test_json_stream();
+    test_json_stream_scalar_root();
+    test_json_stream_errors();
+    test_json_stream_error_offset();
+    test_ndjson_stream();
+    test_ndjson_file_stream();
 
     test_add_json_int();
     test_add_json_bool_true();
@@ -1840,6 +4127,42 @@ int main() {
     test_add_json_object_empty();
     test_add_json_object_single();
     test_add_json_object_multiple();
+    test_add_json_cstring_escapes();
+    test_add_json_null_terminated();
+    test_add_json_string_view();
+    test_add_json_string_round_trip();
+    test_add_json_int_array();
+    test_add_json_double_array();
+    test_add_json_bool_array();
+    test_add_json_int_array_like_add_json_int();
+    test_parallel_for_each();
+    test_parallel_for_index();
+    test_parallel_for_xy();
+    test_parallel_for_chunks_deterministic();
+    test_parallel_for_each_empty();
+    test_parallel_for_each_reuse_pool();
+    test_parallel_for_index_nested();
+    test_reduce();
+    test_reduce_lanes();
+    test_parallel_sum();
+    test_parallel_sum_double_deterministic();
+    test_parallel_min_max();
+    test_parallel_reduce();
+    test_sort();
+    test_sort_greater();
+    test_sort_by_key();
+    test_sort_adversary();
+    test_radix_sort();
+    test_radix_sort_negative_zero();
+    test_radix_sort_by_key_stable();
+    test_parallel_sort();
+    test_parallel_sort_by_key();
+    test_lower_upper_bound();
+    test_lower_bound_all_counts();
+    test_equal_range_binary_search();
+    test_lower_bound_by_key();
+    test_eytzinger();
+    test_eytzinger_by_key();
 
     CHECK_INTERNAL(true, "Some internal error");
     CHECK_EXTERNAL(true, "Some external error");
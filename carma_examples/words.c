@@ -7,6 +7,7 @@
 typedef struct {
     StringView key;
     size_t value;
+    size_t hash;
     bool occupied;
 } Item;
 
@@ -18,11 +19,12 @@ typedef struct {
 
 Table count_words(StringView text) {
     auto table = MAKE(Table);
-    FOR_EACH_WORD_PREDICATE(word, text, isspace) {
+    auto whitespace = MAKE_CHARACTER_SET_PREDICATE(isspace);
+    FOR_EACH_WORD_IN_SET(word, text, whitespace) {
         auto word_count = 0;
-        GET_RANGE_KEY_VALUE(word, word_count, table);
+        GET_RANGE_KEY_VALUE_HASHED(word, word_count, table);
         word_count++;
-        SET_RANGE_KEY_VALUE(word, word_count, table);
+        SET_RANGE_KEY_VALUE_HASHED(word, word_count, table);
     }
     return table;
 }